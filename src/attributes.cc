@@ -5,11 +5,17 @@
 #include "attributes.h"
 #include "filehelpers.h"
 #include "parseJson.h"
+#include "indexFormats.h"
+#include <iterator>
 
 namespace rqcd_file_index {
 Attribute attributeFromStrings(std::string const & name, std::string const & valstr, 
         std::string const & typestr) {
   const Type typespec = typeFromString(typestr);
+  // bools are stored as integers in the database:
+  if( typespec == Type::BOOLEAN ) return Attribute(name, Value(valstr == "1" || valstr == "true"));
+  // strings like "4" are no numbers:
+  if( typespec == Type::STRING ) return Attribute(name, Value(valstr));
   auto resval = valueFromString(valstr);
   assert(resval.getType() == typespec);
   return Attribute(name, resval);
@@ -34,16 +40,9 @@ std::list<File> getUniqueFiles(Index const & idx) {
   return res;
 }
 void printIndex(Index const & idx, std::ostream& os) {
-  for ( auto const & dataset : idx ) {
-    os << "dataset \"" << dataset.datasetname << "\" (from file \""
-      << dataset.file.filename << "\" and row " << dataset.location.row << ")" <<
-      " has the following attributes:" << std::endl;
-    for ( auto attr : dataset.attributes ) {
-      os << "  - " << attr.getName() 
-        << " (" << typeToString(attr.getType()) << ") = "
-        << attr.getValue() << std::endl;
-    }
-  }
+  TextIndexWriter writer(os);
+  writer.write(idx);
+  writer.flush();
 }
 std::string getFullpath( Index const & idxstack ) {
   std::string fullpath("");
@@ -58,31 +57,25 @@ void mergeIndex( Index & res, Index const & idxToMerge ) {
   for ( auto const & from : idxToMerge )
     res.push_back(from);
 }
-std::vector<Attribute> tableFieldsToAttributes(Value const & table) {
-  std::vector<Attribute> res;
-  for( auto const & key : table["fields"].keys() ) {
-    res.push_back(Attribute(key, Value(table["fields"][key])));
-  }
-  return res;
-}
-Index splitDsetSpecWithTable( DatasetSpec const & dset, Value const & table ) {
+Index splitDsetSpecWithTable( DatasetSpec const & dset, Table const & table ) {
   /*
    * splits a dataset specifier that is described by a table into several
    * DatasetSpecs, each holding the attributes from the table and the correct
    * location within the dataset.
    */
   Index res;
-  for( auto const & req : table.getMap() ) {
-    auto attrs = tableFieldsToAttributes(req.second);
-    DatasetSpec newdset(dset);
-    for( auto && attr : attrs )
-      newdset.attributes.push_back(std::move(attr));
-    newdset.location.row = (int)(req.second["row"].getNumeric());
-    res.push_back(std::move(newdset));
+  res.reserve(table.nrows);
+  for( std::size_t row = 0; row < table.nrows; ++row ) {
+    res.push_back(dset);
+    DatasetSpec & newdset = res.back();
+    newdset.attributes.reserve(dset.attributes.size() + table.columns.size());
+    for( auto const & column : table.columns )
+      newdset.attributes.push_back(Attribute(column.name, column.valueAt(row)));
+    newdset.location.row = (int)row;
   }
   return res;
 }
-Index expandIndex(Index const & idx, std::map<std::string, Value> const & tables) {
+Index expandIndex(Index const & idx, std::map<std::string, Table> const & tables) {
   Index res;
   for( auto const & elem : idx ) {
     // for each DatasetSpec in the Index, check if there is a table describing
@@ -90,7 +83,8 @@ Index expandIndex(Index const & idx, std::map<std::string, Value> const & tables
     std::string tablename = elem.datasetname.substr(0, elem.datasetname.rfind("/"));
     if( tables.count( tablename ) > 0) {
       // dset has table:
-      mergeIndex( res, splitDsetSpecWithTable(elem, tables.at(tablename)) );
+      auto split = splitDsetSpecWithTable(elem, tables.at(tablename));
+      res.insert(res.end(), std::make_move_iterator(split.begin()), std::make_move_iterator(split.end()));
     } else {
       // doesn't have table, add to result index:
       res.push_back(elem);
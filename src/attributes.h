@@ -13,7 +13,10 @@
 #include <ostream>
 #include <cassert>
 #include <sstream>
+#include <utility>
 #include "value.h"
+#include "table.h"
+#include "expression.h"
 
 namespace rqcd_file_index {
 class Attribute {
@@ -21,8 +24,8 @@ class Attribute {
     Attribute(std::string const & name, Value const & val_) : 
       attrname(name), val(val_) { }
     Type getType() const { return val.getType(); }
-    Value getValue() const { return val; };
-    std::string getName() const { return attrname; };
+    Value const & getValue() const { return val; };
+    std::string const & getName() const { return attrname; };
     friend std::ostream& operator<<(std::ostream& os, Attribute const & attr) {
       os << "\"" << attr.getName() << "\": " << attr.getValue();
       return os;
@@ -50,6 +53,17 @@ class AttributeCondition {
     virtual std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const {
       return keyentryname + std::string(" = '") + name + std::string("'");
     }
+    //conditions on numbers can be evaluated on columns of doubles: a numeric
+    //attribute matches if its value lies in any of the closed intervals.
+    virtual bool getNumericIntervals(std::vector<std::pair<double, double>> & /*intervals*/) const {
+      return false;
+    }
+    //true if the sql description selects exactly the matching values (and not
+    //a superset of them), such that it can be negated in the database.
+    virtual bool isSqlExact() const { return false; }
+    //conditions on the smallest or largest value among all candidates return
+    //the sql aggregate ("min" or "max"), the other conditions nullptr.
+    virtual char const * getSqlAggregate() const { return nullptr; }
 };
 
 class AttributeRequest {
@@ -57,11 +71,15 @@ class AttributeRequest {
     AttributeRequest(std::string const & name, AttributeCondition const & in) :
       reqname(name), cond(std::move(in.clone())) {}
     bool matches(Attribute const & attr) const { return cond->matches(attr, reqname); }
-    std::string getName() const { return reqname; }
+    std::string const & getName() const { return reqname; }
     std::string getSqlKeyDescription(std::string const & keyentryname) const { 
       return cond->getSqlKeyDescription(keyentryname, reqname); }
     std::string getSqlValueDescription(std::string const & valentryname) const { 
       return cond->getSqlValueDescription(valentryname); }
+    bool getNumericIntervals(std::vector<std::pair<double, double>> & intervals) const {
+      return cond->getNumericIntervals(intervals); }
+    bool isSqlExact() const { return cond->isSqlExact(); }
+    char const * getSqlAggregate() const { return cond->getSqlAggregate(); }
   private:
     std::string reqname;
     std::unique_ptr<AttributeCondition> cond;
@@ -117,10 +135,11 @@ struct DatasetSpec {
   DatasetChunkSpec location; // location within the dataset
   friend std::ostream& operator<<(std::ostream& os, DatasetSpec const & dset) {
     os << "{\"attributes\": {";
-    for( auto it = dset.attributes.cbegin(); it != --(dset.attributes.cend()); ++it)
-      os << *it << ", ";
-    if( not dset.attributes.empty() )
+    if( not dset.attributes.empty() ) {
+      for( auto it = dset.attributes.cbegin(); it != --(dset.attributes.cend()); ++it)
+        os << *it << ", ";
       os << dset.attributes.back();
+    }
     os << "}, \"datasetname\": \"" << dset.datasetname << "\", \"file\": " 
        << dset.file << ", \"location\": " << dset.location << "}";
     return os;
@@ -148,13 +167,33 @@ enum class SearchMode {
   CONCATENATE
 };
 SearchMode searchModeFromString(std::string str);
+/*
+ * attribute requests combined by an operator: all or any of the operands are
+ * fulfilled, or (NOT) not all of them. the operands are attribute requests
+ * and further expressions.
+ */
+struct AttributeExpression {
+  enum class Operator {
+    ALL_OF,
+    ANY_OF,
+    NOT
+  };
+  explicit AttributeExpression(Operator op_) : op(op_) {}
+  Operator op;
+  std::vector<AttributeRequest> requests;
+  std::vector<AttributeExpression> expressions;
+};
 struct Request {
   std::vector<AttributeRequest> attrrequests;
+  // further conditions on the attributes, all of them need to be fulfilled:
+  std::vector<AttributeExpression> attrexpressions;
   std::vector<Hdf5DatasetRequest> dsetrequests;
   std::vector<FileRequest>      filerequests;
-  //TODO later:
-  //std::vector<LuaRequest>       luarequests;
+  // evaluated last, on the datasets that fulfill all other conditions:
+  std::vector<Expression>       expressions;
   SearchMode smode = SearchMode::FIRST;
+  // the number of matching datasets that are needed (0: all of them):
+  std::size_t limit = 0;
 };
 
 std::list<File> getUniqueFiles(Index const & idx);
@@ -166,8 +205,7 @@ Value valueFromString(std::string const & str);
 void mergeIndex( Index & res, Index const & idxToMerge );
 std::string getFullpath( Index const & idxstack );
 void printIndex(Index const & idx, std::ostream& os);
-std::vector<Attribute> tableFieldsToAttributes(Value const & table);
-Index splitDsetSpecWithTable( DatasetSpec const & dset, Value const & table );
-Index expandIndex(Index const & idx, std::map<std::string, Value> const & tables);
+Index splitDsetSpecWithTable( DatasetSpec const & dset, Table const & table );
+Index expandIndex(Index const & idx, std::map<std::string, Table> const & tables);
 }
 #endif
@@ -0,0 +1,236 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <cstddef>
+#include <algorithm>
+#include <thread>
+#include "hdf5.h"
+#include "conversionKernels.h"
+#include "indexHdf5.h"
+#include "postselection.h"
+#include "indexFormats.h"
+#include <sstream>
+
+/*
+ * micro benchmarks for the hot loops. usage: ./benchmarks [repetitions]
+ */
+int nrep = 20;
+
+double timeit(std::function<void()> const & fn) {
+  // best of nrep runs, in milliseconds:
+  double best = 1e300;
+  for( int i = 0; i < nrep; ++i ) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if( ms < best ) best = ms;
+  }
+  return best;
+}
+void report(std::string const & name, double ms, std::size_t nvalues) {
+  std::cout << "  " << std::left << std::setw(40) << name << std::right 
+            << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms "
+            << std::setw(10) << std::setprecision(1) << nvalues / ms / 1e3 << " Mvalues/s" << std::endl;
+}
+template <typename T>
+void benchmarkConversion(std::string const & name, hid_t h5type, std::size_t n) {
+  std::vector<T> in(n);
+  for( std::size_t i = 0; i < n; ++i ) in[i] = (T)(i % 1000);
+  std::vector<double> out(n);
+  report(name + ": kernel", timeit([&]() {
+      rqcd_hdf5_reader_generic::convertToDouble(in.data(), out.data(), n); }), n);
+  // what H5Dread would do with H5T_NATIVE_DOUBLE as memory type:
+  std::vector<char> buf(n * sizeof(double));
+  report(name + ": H5Tconvert", timeit([&]() {
+      std::memcpy(buf.data(), in.data(), n * sizeof(T));
+      H5Tconvert(h5type, H5T_NATIVE_DOUBLE, n, buf.data(), NULL, H5P_DEFAULT); }), n);
+}
+
+void benchmarkComplexConversion(std::size_t n) {
+  // {re, im} compounds of floats are converted as interleaved floats, hdf5
+  // would have to convert compound to compound:
+  std::vector<float> in(n);
+  for( std::size_t i = 0; i < n; ++i ) in[i] = (float)(i % 1000);
+  std::vector<double> out(n);
+  report("complex float32 {re, im}: kernel", timeit([&]() {
+      rqcd_hdf5_reader_generic::convertToDouble(in.data(), out.data(), n); }), n);
+  hid_t ftype = H5Tcreate(H5T_COMPOUND, 2*sizeof(float));
+  H5Tinsert(ftype, "re", 0, H5T_NATIVE_FLOAT);
+  H5Tinsert(ftype, "im", sizeof(float), H5T_NATIVE_FLOAT);
+  hid_t dtype = H5Tcreate(H5T_COMPOUND, 2*sizeof(double));
+  H5Tinsert(dtype, "re", 0, H5T_NATIVE_DOUBLE);
+  H5Tinsert(dtype, "im", sizeof(double), H5T_NATIVE_DOUBLE);
+  std::vector<char> buf(n * sizeof(double)), bkg(n * sizeof(double));
+  report("complex float32 {re, im}: H5Tconvert", timeit([&]() {
+      std::memcpy(buf.data(), in.data(), n * sizeof(float));
+      H5Tconvert(ftype, dtype, n/2, buf.data(), bkg.data(), H5P_DEFAULT); }), n);
+  H5Tclose(ftype);
+  H5Tclose(dtype);
+}
+
+void benchmarkTable(std::size_t nrows) {
+  // table with an int, a double and an int[3] field in an in-memory file:
+  struct Row { int hpe; double kappa; int mom[3]; };
+  std::vector<Row> rows(nrows);
+  for( std::size_t i = 0; i < nrows; ++i )
+    rows[i] = Row{(int)i, 0.5*i, {(int)i%3, (int)i%5, (int)i%7}};
+  hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_core(fapl, 1 << 20, 0);
+  hid_t file = H5Fcreate("table_benchmark.h5", H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+  hsize_t three = 3;
+  hid_t momtype = H5Tarray_create2(H5T_NATIVE_INT, 1, &three);
+  hid_t rowtype = H5Tcreate(H5T_COMPOUND, sizeof(Row));
+  H5Tinsert(rowtype, "hpe", offsetof(Row, hpe), H5T_NATIVE_INT);
+  H5Tinsert(rowtype, "kappa", offsetof(Row, kappa), H5T_NATIVE_DOUBLE);
+  H5Tinsert(rowtype, "mom", offsetof(Row, mom), momtype);
+  hsize_t dims = nrows;
+  hid_t space = H5Screate_simple(1, &dims, NULL);
+  hid_t dset = H5Dcreate2(file, "table", rowtype, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(dset, rowtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows.data());
+  rqcd_file_index::DatasetSpec dset0({rqcd_file_index::Attribute("kind", "table")}, "/data",
+      rqcd_file_index::File("table_benchmark.h5", 0), rqcd_file_index::DatasetChunkSpec(-1));
+  std::size_t nsplit = 0;
+  report("read table", timeit([&]() {
+      rqcd_file_index::readTable(file, "table"); }), nrows);
+  report("read table and split dataset", timeit([&]() {
+      nsplit = rqcd_file_index::splitDsetSpecWithTable(dset0, rqcd_file_index::readTable(file, "table")).size(); }), nrows);
+  if( nsplit != nrows ) std::cout << "  (split into " << nsplit << " datasets?)" << std::endl;
+  H5Dclose(dset);
+  H5Sclose(space);
+  H5Tclose(rowtype);
+  H5Tclose(momtype);
+  H5Fclose(file);
+  H5Pclose(fapl);
+}
+
+void benchmarkSelectionKernels(std::size_t n) {
+  using namespace rqcd_file_index;
+  std::vector<double> values(n);
+  for( std::size_t i = 0; i < n; ++i ) values[i] = 0.001 * (i % 1000);
+  std::vector<std::uint64_t> mask((n + 63) / 64);
+  std::vector<std::pair<SimdLevel, std::string>> levels{
+    {SimdLevel::SCALAR, "scalar"}, {SimdLevel::SSE2, "sse2"}, {SimdLevel::AVX2, "avx2"}};
+  for( auto const & level : levels ) {
+    if( level.first > detectSimdLevel() ) break;
+    report("interval selection: " + level.second, timeit([&]() {
+        selectInterval(values.data(), n, 0.2, 0.7, mask.data(), level.first); }), n);
+  }
+}
+
+void benchmarkPostselection(std::size_t ndsets) {
+  using namespace rqcd_file_index;
+  // datasets with twelve attributes, three of which are requested:
+  std::vector<std::string> names{"conf", "hpe", "interpolator", "gamma", "source", "sink",
+      "tsrc", "nsrc", "ensemble", "stream"};
+  Index idx;
+  for( std::size_t i = 0; i < ndsets; ++i ) {
+    std::vector<Attribute> attrs;
+    for( int a = 0; a < 10; ++a )
+      attrs.push_back(Attribute(names[a], (int)(i % (a + 2))));
+    attrs.push_back(Attribute("smearing", i % 2 ? "wuppertal" : "local"));
+    attrs.push_back(Attribute("kappa", 0.1 + 0.01*(i % 7)));
+    idx.push_back(DatasetSpec(attrs, "/data", File("file.h5", 0), DatasetChunkSpec(-1)));
+  }
+  Request req;
+  req.attrrequests.push_back(AttributeRequest("gamma", AttributeConditions::Equals(1)));
+  req.attrrequests.push_back(AttributeRequest("smearing", AttributeConditions::Equals("wuppertal")));
+  req.attrrequests.push_back(AttributeRequest("kappa", AttributeConditions::Range(0.12, 0.14)));
+  std::size_t nmatch = 0, nplan = 0;
+  // every request against every attribute, as without a plan:
+  report("postselection: all pairs", timeit([&]() {
+      nmatch = std::count_if(idx.begin(), idx.end(), [&](DatasetSpec const & dset) {
+        for( auto const & attrreq : req.attrrequests ) {
+          bool fulfilled = false;
+          for( auto const & attr : dset.attributes ) fulfilled |= attrreq.matches(attr);
+          if( not fulfilled ) return false;
+        }
+        return true; }); }), ndsets);
+  PostselectionPlan plan(req);
+  report("postselection: compiled plan", timeit([&]() {
+      nplan = std::count_if(idx.begin(), idx.end(), [&](DatasetSpec const & dset) {
+        return plan.matches(dset); }); }), ndsets);
+  if( nplan != nmatch ) std::cout << "  (plan selects " << nplan << " instead of " << nmatch << " datasets?)" << std::endl;
+  // the same conditions as an expression, and an expression with arithmetic:
+  Request exprreq;
+  exprreq.expressions.push_back(Expression("gamma == 1 and smearing == 'wuppertal' and kappa >= 0.12 and kappa <= 0.14"));
+  PostselectionPlan exprplan(exprreq);
+  report("postselection: expression", timeit([&]() {
+      nplan = std::count_if(idx.begin(), idx.end(), [&](DatasetSpec const & dset) {
+        return exprplan.matches(dset); }); }), ndsets);
+  if( nplan != nmatch ) std::cout << "  (expression selects " << nplan << " instead of " << nmatch << " datasets?)" << std::endl;
+  Request arithreq;
+  arithreq.expressions.push_back(Expression("sqrt(conf^2 + hpe^2 + interpolator^2) < 3 * abs(kappa - 0.1) + 2"));
+  PostselectionPlan arithplan(arithreq);
+  report("postselection: arithmetic expression", timeit([&]() {
+      nplan = std::count_if(idx.begin(), idx.end(), [&](DatasetSpec const & dset) {
+        return arithplan.matches(dset); }); }), ndsets);
+  // conditions that every dataset passes, such that the index stays the same:
+  Request all;
+  all.attrrequests.push_back(AttributeRequest("gamma", AttributeConditions::Or({4, 3, 2, 1, 0})));
+  all.attrrequests.push_back(AttributeRequest("kappa", AttributeConditions::Range(0., 1.)));
+  all.attrrequests.push_back(AttributeRequest("conf", AttributeConditions::Min(0)));
+  all.attrrequests.push_back(AttributeRequest("hpe", AttributeConditions::Max(10)));
+  PostselectionPlan allplan(all);
+  report("postselection: keep all, one by one", timeit([&]() {
+      nmatch = std::count_if(idx.begin(), idx.end(), [&](DatasetSpec const & dset) {
+        return allplan.matches(dset); }); }), ndsets);
+  report("postselection: keep all, on columns", timeit([&]() {
+      filterIndexByPostselectionRules(idx, all); }), ndsets);
+  report("postselection: keep all, on columns, " + std::to_string(std::thread::hardware_concurrency()) + " threads",
+      timeit([&]() { filterIndexByPostselectionRulesParallel(idx, all); }), ndsets);
+  if( idx.size() != nmatch ) std::cout << "  (kept " << idx.size() << " instead of " << nmatch << " datasets?)" << std::endl;
+}
+
+void benchmarkOutput(std::size_t ndsets) {
+  using namespace rqcd_file_index;
+  Index idx;
+  for( std::size_t i = 0; i < ndsets; ++i )
+    idx.push_back(DatasetSpec({Attribute("conf", (int)i), Attribute("kappa", 0.1 + 0.01*(i % 7)), 
+          Attribute("smearing", i % 2 ? "wuppertal" : "local")}, "/data", File("file.h5", 0), DatasetChunkSpec((int)i)));
+  for( auto format : {"text", "jsonl", "binary"} ) {
+    report(std::string("output: ") + format, timeit([&]() {
+        std::stringstream out;
+        auto writer = makeIndexWriter(format, out);
+        writer->write(idx);
+        writer->flush(); }), ndsets);
+  }
+  // the text as written line by line, flushing every line:
+  report("output: text, flushing every line", timeit([&]() {
+      std::stringstream out;
+      for( auto const & dset : idx ) {
+        out << "dataset \"" << dset.datasetname << "\" (from file \"" << dset.file.filename 
+          << "\" and row " << dset.location.row << ") has the following attributes:" << std::endl;
+        for( auto const & attr : dset.attributes )
+          out << "  - " << attr.getName() << " (" << typeToString(attr.getType()) << ") = " 
+            << attr.getValue() << std::endl;
+      } }), ndsets);
+}
+
+int main(int argc, char** argv) {
+  if( argc == 2 ) nrep = std::stoi(argv[1]);
+  const std::size_t n = 1 << 22;
+
+  std::cout << "conversion of " << n << " values to double:" << std::endl;
+  benchmarkConversion<float>("float32", H5T_NATIVE_FLOAT, n);
+  benchmarkConversion<std::int32_t>("int32", H5T_NATIVE_INT32, n);
+  benchmarkConversion<std::int64_t>("int64", H5T_NATIVE_INT64, n);
+  benchmarkComplexConversion(n);
+  std::cout << "table with 100000 rows:" << std::endl;
+  benchmarkTable(100000);
+  std::cout << "selection of " << n << " values:" << std::endl;
+  benchmarkSelectionKernels(n);
+  std::cout << "postselection of 10000 datasets:" << std::endl;
+  benchmarkPostselection(10000);
+  std::cout << "output of 100000 datasets:" << std::endl;
+  benchmarkOutput(100000);
+  return 0;
+}
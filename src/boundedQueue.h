@@ -0,0 +1,64 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+namespace rqcd_file_index {
+/*
+ * fifo between two threads with a fixed maximum size: push blocks while the
+ * queue is full, pop blocks while it is empty.
+ *
+ * closing the queue can be done from both sides: the producer closes after the
+ * last element (the consumer still gets all remaining elements), the consumer
+ * closes to signal that it does not want any more elements (push then fails
+ * and the producer can stop early).
+ */
+template <typename T>
+class BoundedQueue {
+  public:
+    explicit BoundedQueue(std::size_t maxsize_) : maxsize(maxsize_), closed(false) {
+      if( maxsize == 0 ) 
+        throw std::runtime_error("BoundedQueue: size must be at least one.");
+    }
+    BoundedQueue(BoundedQueue const &) = delete;
+    BoundedQueue & operator=(BoundedQueue const &) = delete;
+    // returns false if the queue has been closed (the element is dropped).
+    bool push(T && elem) {
+      std::unique_lock<std::mutex> lock(mtx);
+      notFull.wait(lock, [this]{ return closed or queue.size() < maxsize; });
+      if( closed ) return false;
+      queue.push_back(std::move(elem));
+      notEmpty.notify_one();
+      return true;
+    }
+    // returns false if the queue is closed and all elements have been taken.
+    bool pop(T & elem) {
+      std::unique_lock<std::mutex> lock(mtx);
+      notEmpty.wait(lock, [this]{ return closed or not queue.empty(); });
+      if( queue.empty() ) return false;
+      elem = std::move(queue.front());
+      queue.pop_front();
+      notFull.notify_one();
+      return true;
+    }
+    void close() {
+      std::lock_guard<std::mutex> lock(mtx);
+      closed = true;
+      notFull.notify_all();
+      notEmpty.notify_all();
+    }
+  private:
+    std::size_t maxsize;
+    bool closed;
+    std::deque<T> queue;
+    std::mutex mtx;
+    std::condition_variable notFull, notEmpty;
+};
+}
+#endif
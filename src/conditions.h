@@ -7,12 +7,19 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <regex>
 #include <cassert>
+#include <limits>
 #include "attributes.h"
 
 namespace rqcd_file_index {
 namespace AttributeConditions {
+// attribute names are unique, but the type is checked as well: matches()
+// rejects attributes of another type.
+inline std::string sqlKeyOfType(std::string const & keyentryname, std::string const & name, Type const & type) {
+  return keyentryname + " = '" + name + "' and type = '" + typeToString(type) + "'";
+}
 class Equals : public AttributeCondition { 
   public:
     explicit Equals(Value val_) : val(val_) {}
@@ -22,12 +29,23 @@ class Equals : public AttributeCondition {
       return std::unique_ptr<Equals>(new Equals(val)); }
     std::string getSqlValueDescription(std::string const & valentryname) const override { 
       std::stringstream sstr;
+      // numbers are stored exactly in the database:
+      sstr << std::setprecision(17);
       if( val.getType() == Type::STRING or val.getType() == Type::ARRAY )
         sstr << valentryname << " = '" << val << "' ";
       else
         sstr << valentryname << " = " << val << " ";
       return sstr.str();
     }
+    bool getNumericIntervals(std::vector<std::pair<double, double>> & intervals) const override {
+      if( val.getType() != Type::NUMERIC ) return false;
+      intervals.push_back({val.getNumeric(), val.getNumeric()});
+      return true;
+    }
+    bool isSqlExact() const override {
+      return val.getType() == Type::NUMERIC or val.getType() == Type::STRING; }
+    std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const override {
+      return sqlKeyOfType(keyentryname, name, val.getType()); }
   private:
     Value val;
 };
@@ -43,12 +61,17 @@ class NotEquals : public AttributeCondition {
       return std::unique_ptr<NotEquals>(new NotEquals(val)); }
     std::string getSqlValueDescription(std::string const & valentryname) const override { 
       std::stringstream sstr;
+      sstr << std::setprecision(17);
       if( val.getType() == Type::STRING or val.getType() == Type::ARRAY )
         sstr << valentryname << " != '" << val << "' ";
       else
         sstr << valentryname << " != " << val << " ";
       return sstr.str();
     }
+    bool isSqlExact() const override {
+      return val.getType() == Type::NUMERIC or val.getType() == Type::STRING; }
+    std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const override {
+      return sqlKeyOfType(keyentryname, name, val.getType()); }
   private:
     Value val;
 };
@@ -64,6 +87,7 @@ class Range: public AttributeCondition {
       return std::unique_ptr<Range>(new Range(min, max)); }
     std::string getSqlValueDescription(std::string const & valentryname) const override { 
       std::stringstream sstr;
+      sstr << std::setprecision(17);
       assert(min.getType() == max.getType());
       if( min.getType() == Type::STRING or min.getType() == Type::ARRAY )
         sstr << valentryname << " between '" << min << "' and '" << max << "' ";
@@ -71,6 +95,15 @@ class Range: public AttributeCondition {
         sstr << valentryname << " between " << min << " and " << max << " ";
       return sstr.str();
     }
+    bool getNumericIntervals(std::vector<std::pair<double, double>> & intervals) const override {
+      if( min.getType() != Type::NUMERIC ) return false;
+      intervals.push_back({min.getNumeric(), max.getNumeric()});
+      return true;
+    }
+    bool isSqlExact() const override {
+      return min.getType() == Type::NUMERIC or min.getType() == Type::STRING; }
+    std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const override {
+      return sqlKeyOfType(keyentryname, name, min.getType()); }
   private:
     Value min, max;
 };
@@ -84,12 +117,22 @@ class Min : public AttributeCondition {
       return std::unique_ptr<Min>(new Min(min)); }
     std::string getSqlValueDescription(std::string const & valentryname) const override { 
       std::stringstream sstr;
+      sstr << std::setprecision(17);
       if( min.getType() == Type::STRING or min.getType() == Type::ARRAY )
         sstr << valentryname << " >= '" << min << "' ";
       else
         sstr << valentryname << " >= " << min << " ";
       return sstr.str();
     }
+    bool getNumericIntervals(std::vector<std::pair<double, double>> & intervals) const override {
+      if( min.getType() != Type::NUMERIC ) return false;
+      intervals.push_back({min.getNumeric(), std::numeric_limits<double>::infinity()});
+      return true;
+    }
+    bool isSqlExact() const override {
+      return min.getType() == Type::NUMERIC or min.getType() == Type::STRING; }
+    std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const override {
+      return sqlKeyOfType(keyentryname, name, min.getType()); }
   private:
     Value min;
 };
@@ -97,17 +140,27 @@ class Max : public AttributeCondition {
   public:
     explicit Max(Value max_) : max(max_) {}
     bool matches(Attribute const & attr, std::string const & reqname) const {
-      return (attr.getType() == max.getType() && attr.getValue() >= max and attr.getName() == reqname); }
+      return (attr.getType() == max.getType() && attr.getValue() <= max and attr.getName() == reqname); }
     std::unique_ptr<AttributeCondition> clone() const { 
       return std::unique_ptr<Max>(new Max(max)); }
     std::string getSqlValueDescription(std::string const & valentryname) const override { 
       std::stringstream sstr;
+      sstr << std::setprecision(17);
       if( max.getType() == Type::STRING or max.getType() == Type::ARRAY )
         sstr << valentryname << " <= '" << max << "' ";
       else
         sstr << valentryname << " <= " << max << " ";
       return sstr.str();
     }
+    bool getNumericIntervals(std::vector<std::pair<double, double>> & intervals) const override {
+      if( max.getType() != Type::NUMERIC ) return false;
+      intervals.push_back({-std::numeric_limits<double>::infinity(), max.getNumeric()});
+      return true;
+    }
+    bool isSqlExact() const override {
+      return max.getType() == Type::NUMERIC or max.getType() == Type::STRING; }
+    std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const override {
+      return sqlKeyOfType(keyentryname, name, max.getType()); }
   private:
     Value max;
 };
@@ -115,15 +168,34 @@ class Present : public AttributeCondition {
   public:
     explicit Present (bool present_) : present(present_) {
       if( not present ) 
-        throw std::runtime_error("Present(AttributeCondition): present == false is not implemented.");
+        throw std::runtime_error("Present(AttributeCondition): absence is checked by an "
+            "AttributeExpression NOT of Present(true).");
     }
     bool matches(Attribute const & attr, std::string const & reqname) const {
       return attr.getName() == reqname; }
     std::unique_ptr<AttributeCondition> clone() const { 
       return std::unique_ptr<Present>(new Present(present)); }
+    bool isSqlExact() const override { return true; }
   private:
     bool present;
 };
+/*
+ * the smallest (or largest) value of the attribute among the datasets that
+ * fulfill all other conditions of the request. on single attributes, only the
+ * presence is checked; the extremal datasets are selected by the database or
+ * by reduceToExtrema.
+ */
+class Extremum : public AttributeCondition {
+  public:
+    explicit Extremum(bool largest_) : largest(largest_) {}
+    bool matches(Attribute const & attr, std::string const & reqname) const {
+      return attr.getName() == reqname; }
+    std::unique_ptr<AttributeCondition> clone() const { 
+      return std::unique_ptr<Extremum>(new Extremum(largest)); }
+    char const * getSqlAggregate() const override { return largest ? "max" : "min"; }
+  private:
+    bool largest;
+};
 class Or : public AttributeCondition {
   public:
     explicit Or(std::vector<Value> const & values) : vals(values) {
@@ -144,6 +216,7 @@ class Or : public AttributeCondition {
       return std::unique_ptr<Or>(new Or(vals)); }
     std::string getSqlValueDescription(std::string const & valentryname) const override { 
       std::stringstream sstr;
+      sstr << std::setprecision(17);
       assert(vals.size() > 0);
       Type typecheck = vals.front().getType();
       sstr << "( ";
@@ -155,11 +228,21 @@ class Or : public AttributeCondition {
           sstr << valentryname << " = " << vals[i] << " or ";
       }
       if( typecheck == Type::STRING or typecheck == Type::ARRAY )
-        sstr << valentryname << " = '" << vals.back() << "' or ";
+        sstr << valentryname << " = '" << vals.back() << "' )";
       else
         sstr << valentryname << " = " << vals.back() << " )";
       return sstr.str();
     }
+    bool getNumericIntervals(std::vector<std::pair<double, double>> & intervals) const override {
+      if( vals.front().getType() != Type::NUMERIC ) return false;
+      for( auto const & val : vals )
+        intervals.push_back({val.getNumeric(), val.getNumeric()});
+      return true;
+    }
+    bool isSqlExact() const override {
+      return vals.front().getType() == Type::NUMERIC or vals.front().getType() == Type::STRING; }
+    std::string getSqlKeyDescription(std::string const & keyentryname, std::string const & name) const override {
+      return sqlKeyOfType(keyentryname, name, vals.front().getType()); }
   private:
     std::vector<Value> vals;
 };
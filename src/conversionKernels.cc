@@ -0,0 +1,45 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include "conversionKernels.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rqcd_hdf5_reader_generic {
+void convertToDouble(float const * in, double * out, std::size_t n) {
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  // four floats per load, converted in two halves:
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128 f = _mm_loadu_ps(in + i);
+    _mm_storeu_pd(out + i,     _mm_cvtps_pd(f));
+    _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+  }
+#endif
+  for( ; i < n; ++i ) out[i] = (double)in[i];
+}
+void convertToDouble(std::int32_t const * in, double * out, std::size_t n) {
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + i));
+    _mm_storeu_pd(out + i,     _mm_cvtepi32_pd(v));
+    _mm_storeu_pd(out + i + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+  }
+#endif
+  for( ; i < n; ++i ) out[i] = (double)in[i];
+}
+// there are no packed conversions for these before AVX-512, a plain loop is
+// all we can do (the compiler may still unroll it):
+void convertToDouble(std::uint32_t const * in, double * out, std::size_t n) {
+  for( std::size_t i = 0; i < n; ++i ) out[i] = (double)in[i];
+}
+void convertToDouble(std::int64_t const * in, double * out, std::size_t n) {
+  for( std::size_t i = 0; i < n; ++i ) out[i] = (double)in[i];
+}
+void convertToDouble(std::uint64_t const * in, double * out, std::size_t n) {
+  for( std::size_t i = 0; i < n; ++i ) out[i] = (double)in[i];
+}
+}
@@ -0,0 +1,23 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __CONVERSION_KERNELS_H__
+#define __CONVERSION_KERNELS_H__
+#include <cstdint>
+#include <cstddef>
+
+namespace rqcd_hdf5_reader_generic {
+/*
+ * convert n values of a staging buffer (read from the file in its native type)
+ * to double precision. out must hold at least n doubles. on x86 the float and
+ * int32 conversions use SSE2, everything else (and the remainder) is a scalar
+ * loop.
+ */
+void convertToDouble(float const * in, double * out, std::size_t n);
+void convertToDouble(std::int32_t const * in, double * out, std::size_t n);
+void convertToDouble(std::uint32_t const * in, double * out, std::size_t n);
+void convertToDouble(std::int64_t const * in, double * out, std::size_t n);
+void convertToDouble(std::uint64_t const * in, double * out, std::size_t n);
+}
+#endif
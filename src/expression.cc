@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include "expression.h"
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+namespace rqcd_file_index {
+namespace {
+enum class Function {
+  ABS, SQRT, EXP, LOG, FLOOR, CEIL, MIN, MAX
+};
+struct FunctionSpec {
+  char const * name;
+  Function function;
+  int nargs; // -1: one or more
+};
+const FunctionSpec functions[] = {
+  {"abs", Function::ABS, 1}, {"sqrt", Function::SQRT, 1}, {"exp", Function::EXP, 1},
+  {"log", Function::LOG, 1}, {"floor", Function::FLOOR, 1}, {"ceil", Function::CEIL, 1},
+  {"min", Function::MIN, -1}, {"max", Function::MAX, -1}
+};
+struct Token {
+  enum class Kind { NUMBER, STRING, NAME, SYMBOL, END };
+  Kind kind;
+  std::string text;
+  double number;
+  std::size_t pos;
+  bool quoted; // names in backticks are never keywords
+};
+std::vector<Token> tokenize(std::string const & source) {
+  static const std::vector<std::string> symbols{"||", "&&", "==", "!=", "~=", "<=", ">=",
+    "<", ">", "!", "+", "-", "*", "/", "%", "^", "(", ")", "[", "]", ",", "."};
+  std::vector<Token> tokens;
+  std::size_t pos = 0;
+  while( true ) {
+    while( pos < source.size() and std::isspace((unsigned char)source[pos]) ) pos++;
+    if( pos == source.size() ) break;
+    const char c = source[pos];
+    Token tok{Token::Kind::SYMBOL, "", 0., pos, false};
+    if( std::isdigit((unsigned char)c) or (c == '.' and pos + 1 < source.size()
+          and std::isdigit((unsigned char)source[pos+1])) ) {
+      std::size_t len = 0;
+      tok.kind = Token::Kind::NUMBER;
+      tok.number = std::stod(source.substr(pos), &len);
+      pos += len;
+    } else if( std::isalpha((unsigned char)c) or c == '_' ) {
+      tok.kind = Token::Kind::NAME;
+      while( pos < source.size() and (std::isalnum((unsigned char)source[pos]) or source[pos] == '_') )
+        tok.text += source[pos++];
+    } else if( c == '\'' or c == '"' or c == '`' ) {
+      // strings, and names in backticks:
+      tok.kind = c == '`' ? Token::Kind::NAME : Token::Kind::STRING;
+      tok.quoted = true;
+      const std::size_t end = source.find(c, pos + 1);
+      if( end == std::string::npos ) {
+        std::stringstream errstr;
+        errstr << "expression: unterminated quote at position " << pos << " in \"" << source << "\".";
+        throw std::runtime_error(errstr.str());
+      }
+      tok.text = source.substr(pos + 1, end - pos - 1);
+      pos = end + 1;
+    } else {
+      for( auto const & sym : symbols )
+        if( source.compare(pos, sym.size(), sym) == 0 ) { tok.text = sym; break; }
+      if( tok.text.empty() ) {
+        std::stringstream errstr;
+        errstr << "expression: unexpected character '" << c << "' at position " << pos
+               << " in \"" << source << "\".";
+        throw std::runtime_error(errstr.str());
+      }
+      pos += tok.text.size();
+    }
+    tokens.push_back(tok);
+  }
+  tokens.push_back(Token{Token::Kind::END, "", 0., source.size(), false});
+  return tokens;
+}
+// an entry of the evaluation stack, booleans are numbers 0 or 1:
+struct Operand {
+  Type type;
+  double number;
+  std::string const * string;
+};
+}
+
+/*
+ * recursive descent over the tokens, emitting the code in postfix order.
+ * precedence from low to high: or, and, not, comparisons, + -, * / %, unary
+ * minus, ^ (right associative).
+ */
+class Expression::Compiler {
+  public:
+    Compiler(Expression & expr_) : expr(expr_), tokens(tokenize(expr_.source)) {}
+    void compile() {
+      parseOr();
+      if( peek().kind != Token::Kind::END ) fail("unexpected '" + peek().text + "'");
+    }
+  private:
+    Expression & expr;
+    std::vector<Token> tokens;
+    std::size_t next = 0;
+    std::size_t depth = 0;
+
+    Token const & peek() const { return tokens[next]; }
+    bool accept(std::string const & text) {
+      if( peek().kind == Token::Kind::END or peek().kind == Token::Kind::NUMBER
+          or peek().kind == Token::Kind::STRING or peek().quoted or peek().text != text ) return false;
+      next++;
+      return true;
+    }
+    void expect(std::string const & text) {
+      if( not accept(text) ) fail("expected '" + text + "'");
+    }
+    void fail(std::string const & msg) const {
+      std::stringstream errstr;
+      errstr << "expression: " << msg << " at position " << peek().pos << " in \"" << expr.source << "\".";
+      throw std::runtime_error(errstr.str());
+    }
+    // emits an instruction that changes the depth of the stack by delta:
+    std::size_t emit(OpCode op, int delta, int arg = 0, int arg2 = 0) {
+      expr.code.push_back(Instruction{op, arg, arg2});
+      depth += delta;
+      expr.maxdepth = std::max(expr.maxdepth, depth);
+      return expr.code.size() - 1;
+    }
+    int nameId(std::string const & name) {
+      auto it = std::find(expr.names.begin(), expr.names.end(), name);
+      if( it == expr.names.end() ) it = expr.names.insert(it, name);
+      return (int)(it - expr.names.begin());
+    }
+    int stringId(std::string const & str) {
+      auto it = std::find(expr.strings.begin(), expr.strings.end(), str);
+      if( it == expr.strings.end() ) it = expr.strings.insert(it, str);
+      return (int)(it - expr.strings.begin());
+    }
+    // a right side that is skipped if the left side decides, which is left
+    // on the stack by the jump:
+    void parseOr() {
+      parseAnd();
+      while( accept("or") or accept("||") ) {
+        const std::size_t jump = emit(OpCode::JUMP_IF_TRUE, -1);
+        parseAnd();
+        expr.code[jump].arg = (int)expr.code.size();
+      }
+    }
+    void parseAnd() {
+      parseNot();
+      while( accept("and") or accept("&&") ) {
+        const std::size_t jump = emit(OpCode::JUMP_IF_FALSE, -1);
+        parseNot();
+        expr.code[jump].arg = (int)expr.code.size();
+      }
+    }
+    void parseNot() {
+      if( accept("not") or accept("!") ) {
+        parseNot();
+        emit(OpCode::NOT, 0);
+      } else {
+        parseComparison();
+      }
+    }
+    void parseComparison() {
+      static const std::vector<std::pair<std::string, OpCode>> ops{{"==", OpCode::EQ},
+        {"!=", OpCode::NE}, {"~=", OpCode::NE}, {"<=", OpCode::LE}, {">=", OpCode::GE},
+        {"<", OpCode::LT}, {">", OpCode::GT}};
+      parseAdditive();
+      for( auto const & op : ops ) {
+        if( not accept(op.first) ) continue;
+        parseAdditive();
+        emit(op.second, -1);
+        return;
+      }
+    }
+    void parseAdditive() {
+      parseMultiplicative();
+      while( true ) {
+        if( accept("+") ) { parseMultiplicative(); emit(OpCode::ADD, -1); }
+        else if( accept("-") ) { parseMultiplicative(); emit(OpCode::SUB, -1); }
+        else return;
+      }
+    }
+    void parseMultiplicative() {
+      parseUnary();
+      while( true ) {
+        if( accept("*") ) { parseUnary(); emit(OpCode::MUL, -1); }
+        else if( accept("/") ) { parseUnary(); emit(OpCode::DIV, -1); }
+        else if( accept("%") ) { parseUnary(); emit(OpCode::MOD, -1); }
+        else return;
+      }
+    }
+    void parseUnary() {
+      if( accept("-") ) {
+        parseUnary();
+        emit(OpCode::NEG, 0);
+      } else {
+        parsePrimary();
+        // -x^2 is -(x^2), x^-2 is allowed:
+        if( accept("^") ) {
+          parseUnary();
+          emit(OpCode::POW, -1);
+        }
+      }
+    }
+    std::string parseName() {
+      if( peek().kind != Token::Kind::NAME ) fail("expected an attribute name");
+      std::string name = tokens[next++].text;
+      if( name == "attributes" and accept(".") ) return parseName();
+      return name;
+    }
+    void parsePrimary() {
+      Token const tok = peek();
+      if( tok.kind == Token::Kind::NUMBER ) {
+        next++;
+        expr.numbers.push_back(tok.number);
+        emit(OpCode::NUMBER, 1, (int)expr.numbers.size() - 1);
+      } else if( tok.kind == Token::Kind::STRING ) {
+        next++;
+        emit(OpCode::STRING, 1, stringId(tok.text));
+      } else if( accept("(") ) {
+        parseOr();
+        expect(")");
+      } else if( accept("true") ) {
+        emit(OpCode::BOOLEAN, 1, 1);
+      } else if( accept("false") ) {
+        emit(OpCode::BOOLEAN, 1, 0);
+      } else if( tok.kind == Token::Kind::NAME and tokens[next+1].text == "("
+          and tokens[next+1].kind == Token::Kind::SYMBOL ) {
+        parseCall();
+      } else {
+        const int name = nameId(parseName());
+        if( accept("[") ) {
+          Token const elem = peek();
+          if( elem.kind == Token::Kind::NUMBER and elem.number == std::floor(elem.number) and elem.number >= 0 )
+            emit(OpCode::ELEMENT, 1, name, stringId(std::to_string((long long)elem.number)));
+          else if( elem.kind == Token::Kind::STRING )
+            emit(OpCode::ELEMENT, 1, name, stringId(elem.text));
+          else
+            fail("expected an index or a key");
+          next++;
+          expect("]");
+        } else {
+          emit(OpCode::LOAD, 1, name);
+        }
+      }
+    }
+    void parseCall() {
+      const std::string fname = tokens[next].text;
+      const std::size_t fpos = next++;
+      expect("(");
+      if( fname == "has" ) {
+        emit(OpCode::HAS, 1, nameId(parseName()));
+        expect(")");
+        return;
+      }
+      auto fn = std::find_if(std::begin(functions), std::end(functions),
+          [&](FunctionSpec const & spec) { return fname == spec.name; });
+      if( fn == std::end(functions) ) {
+        next = fpos;
+        fail("unknown function '" + fname + "'");
+      }
+      int nargs = 0;
+      if( not accept(")") ) {
+        do { parseOr(); nargs++; } while( accept(",") );
+        expect(")");
+      }
+      if( (fn->nargs >= 0 and nargs != fn->nargs) or nargs == 0 ) {
+        next = fpos;
+        fail("wrong number of arguments for '" + fname + "'");
+      }
+      emit(OpCode::CALL, 1 - nargs, (int)fn->function, nargs);
+    }
+};
+
+Expression::Expression(std::string const & source_) : source(source_) {
+  Compiler(*this).compile();
+}
+bool Expression::evaluate(Value const * const * values) const {
+  // the stack is reused by the thread, top points to the last operand
+  // (stack[0] is never used):
+  thread_local std::vector<Operand> stack;
+  if( stack.size() < maxdepth + 1 ) stack.resize(maxdepth + 1);
+  Operand * top = stack.data();
+  auto fail = [this](std::string const & msg) {
+    std::stringstream errstr;
+    errstr << "expression: " << msg << " in \"" << source << "\".";
+    throw std::runtime_error(errstr.str());
+  };
+  auto operand = [&](Value const & val, std::string const & name) {
+    switch( val.getType() ) {
+      case Type::NUMERIC: return Operand{Type::NUMERIC, val.getNumeric(), nullptr};
+      case Type::BOOLEAN: return Operand{Type::BOOLEAN, val.getBool() ? 1. : 0., nullptr};
+      case Type::STRING:  return Operand{Type::STRING, 0., &val.getString()};
+      default: fail("the array " + name + " can only be used by its elements");
+    }
+    return Operand{Type::BOOLEAN, 0., nullptr};
+  };
+  auto numbers2 = [&](char const * op) {
+    if( top[-1].type != Type::NUMERIC or top[0].type != Type::NUMERIC )
+      fail(std::string("operands of ") + op + " must be numbers");
+  };
+  auto boolean = [&](Operand const & o, char const * op) {
+    if( o.type != Type::BOOLEAN ) fail(std::string("operand of ") + op + " must be a boolean");
+    return o.number != 0.;
+  };
+  auto compare = [&](char const * op) {
+    if( top[-1].type != top[0].type or top[0].type == Type::BOOLEAN )
+      fail(std::string("operands of ") + op + " must be two numbers or two strings");
+    if( top[0].type == Type::NUMERIC ) return top[-1].number < top[0].number ? -1 : (top[0].number < top[-1].number ? 1 : 0);
+    return top[-1].string->compare(*top[0].string);
+  };
+  auto equal = [&]() {
+    if( top[-1].type != top[0].type ) return false;
+    if( top[0].type == Type::STRING ) return *top[-1].string == *top[0].string;
+    return top[-1].number == top[0].number;
+  };
+  auto result = [&](bool b) { --top; *top = Operand{Type::BOOLEAN, b ? 1. : 0., nullptr}; };
+  auto arithmetic = [&](double d) { --top; top->number = d; };
+  for( std::size_t pc = 0; pc < code.size(); ++pc ) {
+    Instruction const & ins = code[pc];
+    switch( ins.op ) {
+      case OpCode::NUMBER:  *++top = Operand{Type::NUMERIC, numbers[ins.arg], nullptr}; break;
+      case OpCode::STRING:  *++top = Operand{Type::STRING, 0., &strings[ins.arg]}; break;
+      case OpCode::BOOLEAN: *++top = Operand{Type::BOOLEAN, (double)ins.arg, nullptr}; break;
+      case OpCode::HAS:     *++top = Operand{Type::BOOLEAN, values[ins.arg] ? 1. : 0., nullptr}; break;
+      case OpCode::LOAD:
+        if( not values[ins.arg] ) return false;
+        *++top = operand(*values[ins.arg], names[ins.arg]);
+        break;
+      case OpCode::ELEMENT: {
+        if( not values[ins.arg] ) return false;
+        if( values[ins.arg]->getType() != Type::ARRAY ) fail(names[ins.arg] + " is not an array");
+        auto const & elems = values[ins.arg]->getMap();
+        auto it = elems.find(strings[ins.arg2]);
+        if( it == elems.end() ) return false;
+        *++top = operand(it->second, names[ins.arg] + "[" + strings[ins.arg2] + "]");
+        break;
+      }
+      case OpCode::NEG:
+        if( top->type != Type::NUMERIC ) fail("operand of - must be a number");
+        top->number = -top->number;
+        break;
+      case OpCode::NOT: top->number = boolean(*top, "not") ? 0. : 1.; break;
+      case OpCode::ADD: numbers2("+"); arithmetic(top[-1].number + top[0].number); break;
+      case OpCode::SUB: numbers2("-"); arithmetic(top[-1].number - top[0].number); break;
+      case OpCode::MUL: numbers2("*"); arithmetic(top[-1].number * top[0].number); break;
+      case OpCode::DIV: numbers2("/"); arithmetic(top[-1].number / top[0].number); break;
+      case OpCode::MOD: numbers2("%"); arithmetic(std::fmod(top[-1].number, top[0].number)); break;
+      case OpCode::POW: numbers2("^"); arithmetic(std::pow(top[-1].number, top[0].number)); break;
+      case OpCode::EQ: result(equal()); break;
+      case OpCode::NE: result(not equal()); break;
+      case OpCode::LT: result(compare("<") < 0); break;
+      case OpCode::LE: result(compare("<=") <= 0); break;
+      case OpCode::GT: result(compare(">") > 0); break;
+      case OpCode::GE: result(compare(">=") >= 0); break;
+      case OpCode::JUMP_IF_FALSE:
+        if( not boolean(*top, "and") ) pc = ins.arg - 1;
+        else --top;
+        break;
+      case OpCode::JUMP_IF_TRUE:
+        if( boolean(*top, "or") ) pc = ins.arg - 1;
+        else --top;
+        break;
+      case OpCode::CALL: {
+        Operand * args = top - (ins.arg2 - 1);
+        for( Operand * a = args; a <= top; ++a )
+          if( a->type != Type::NUMERIC ) fail("arguments of functions must be numbers");
+        double & res = args[0].number;
+        switch( (Function)ins.arg ) {
+          case Function::ABS:   res = std::fabs(res); break;
+          case Function::SQRT:  res = std::sqrt(res); break;
+          case Function::EXP:   res = std::exp(res); break;
+          case Function::LOG:   res = std::log(res); break;
+          case Function::FLOOR: res = std::floor(res); break;
+          case Function::CEIL:  res = std::ceil(res); break;
+          case Function::MIN:   for( Operand * a = args + 1; a <= top; ++a ) res = std::min(res, a->number); break;
+          case Function::MAX:   for( Operand * a = args + 1; a <= top; ++a ) res = std::max(res, a->number); break;
+        }
+        top = args;
+        break;
+      }
+    }
+  }
+  if( top != stack.data() + 1 or top->type != Type::BOOLEAN ) fail("the result is not a boolean");
+  return top->number != 0.;
+}
+}
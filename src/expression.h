@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __EXPRESSION_H__
+#define __EXPRESSION_H__
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "value.h"
+
+namespace rqcd_file_index {
+/*
+ * an expression on the attributes of a dataset, e.g.
+ *
+ *   x^2 + y^2 + z^2 == 27 and (kind == 'table' or not has(mom))
+ *
+ * names refer to attributes (also as attributes.name, or `name` for names
+ * with other characters), mom[1] to an element of an array. the operators
+ * are those of lua and c: or ||, and &&, not !, == != ~= < <= > >=, + - * /
+ * % ^ and unary minus; functions are abs, sqrt, exp, log, floor, ceil, min,
+ * max and has(name). numbers compare with numbers, strings with strings and
+ * booleans with booleans; == of different types is false.
+ *
+ * the expression is compiled once into bytecode for a stack machine. the
+ * values of the attributes are bound by the position of their name in
+ * getNames(). an attribute that is needed but missing makes the expression
+ * false; 'and' and 'or' only evaluate their right side if needed.
+ */
+class Expression {
+  public:
+    explicit Expression(std::string const & source);
+    std::string const & getSource() const { return source; }
+    std::vector<std::string> const & getNames() const { return names; }
+    // values[i] is the value of the attribute getNames()[i], or nullptr:
+    bool evaluate(Value const * const * values) const;
+    bool evaluate(std::vector<Value const *> const & values) const { return evaluate(values.data()); }
+  private:
+    enum class OpCode : std::uint8_t {
+      NUMBER, STRING, BOOLEAN, LOAD, ELEMENT, HAS,
+      NEG, NOT, ADD, SUB, MUL, DIV, MOD, POW,
+      EQ, NE, LT, LE, GT, GE,
+      JUMP_IF_FALSE, JUMP_IF_TRUE, CALL
+    };
+    // arg is the constant, name or jump target, arg2 the element or the
+    // number of arguments:
+    struct Instruction {
+      OpCode op;
+      int arg;
+      int arg2;
+    };
+    class Compiler;
+    std::string source;
+    std::vector<std::string> names;
+    std::vector<Instruction> code;
+    std::vector<double> numbers;
+    std::vector<std::string> strings;
+    std::size_t maxdepth = 0;
+};
+}
+#endif
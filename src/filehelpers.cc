@@ -3,6 +3,18 @@
  * Licensed under MIT License. See LICENSE in the root directory.
  */
 #include "filehelpers.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <atomic>
+#include <exception>
+#include <cstdlib>
 
 /*
  * DISCLAIMER:
@@ -18,3 +30,157 @@ int FileHelpers::getFileModificationTime(std::string filename) {
   stat(filename.c_str(), &buffer);
   return buffer.st_mtime;
 }
+std::string FileHelpers::canonicalPath(std::string const & filename) {
+  const auto slash = filename.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : filename.substr(0, slash);
+  if( dir.empty() ) dir = "/";
+  const std::string base = slash == std::string::npos ? filename : filename.substr(slash + 1);
+  char *resolved = realpath(dir.c_str(), nullptr);
+  if( resolved == nullptr ) return filename;
+  std::string canonical(resolved);
+  free(resolved);
+  if( base.empty() or base == "." or base == ".." ) {
+    // a directory, resolve it as a whole:
+    char *full = realpath(filename.c_str(), nullptr);
+    if( full == nullptr ) return filename;
+    canonical = full;
+    free(full);
+    return canonical;
+  }
+  return canonical == "/" ? canonical + base : canonical + "/" + base;
+}
+FileHelpers::Fingerprint FileHelpers::getFingerprint(std::string filename) {
+  Fingerprint fp;
+  int fd = open(filename.c_str(), O_RDONLY);
+  if( fd < 0 ) return fp;
+  struct stat buffer;
+  if( fstat(fd, &buffer) == 0 ) {
+    fp.size = buffer.st_size;
+    // fnv-1a of five blocks at 0, 1/4, 1/2, 3/4 and the end of the file:
+    const off_t blocksize = 4096;
+    char block[blocksize];
+    std::uint64_t hash = 14695981039346656037ULL;
+    const off_t last = buffer.st_size > blocksize ? buffer.st_size - blocksize : 0;
+    for( off_t i = 0; i < 5; ++i ) {
+      ssize_t n = pread(fd, block, blocksize, last * i / 4);
+      for( ssize_t j = 0; j < n; ++j ) {
+        hash ^= (unsigned char)block[j];
+        hash *= 1099511628211ULL;
+      }
+    }
+    fp.hash = hash;
+  }
+  close(fd);
+  return fp;
+}
+FileHelpers::FileStat FileHelpers::statFile(std::string const & filename) {
+  struct stat buffer;
+  if( stat(filename.c_str(), &buffer) != 0 ) return FileStat{filename, 0, -1, false};
+  return FileStat{filename, (int)buffer.st_mtime, (long long)buffer.st_size, true};
+}
+void FileHelpers::statFiles(std::vector<std::string> const & filenames, std::size_t nthreads,
+    std::function<void(std::size_t, FileStat const &)> const & callback) {
+  // the threads take the next file from a shared counter, the results are
+  // passed to the callback in order:
+  std::vector<FileStat> results(filenames.size());
+  std::vector<char> done(filenames.size(), 0);
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stop(false);
+  std::mutex mtx;
+  std::condition_variable finished;
+  auto work = [&]() {
+    std::size_t i;
+    while( not stop and (i = next++) < filenames.size() ) {
+      FileStat result = statFile(filenames[i]);
+      std::lock_guard<std::mutex> lock(mtx);
+      results[i] = std::move(result);
+      done[i] = 1;
+      finished.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  for( std::size_t t = 0; t < std::max<std::size_t>(nthreads, 1); ++t ) threads.emplace_back(work);
+  std::exception_ptr error;
+  try {
+    for( std::size_t i = 0; i < filenames.size(); ++i ) {
+      FileStat result;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        finished.wait(lock, [&]() { return done[i] != 0; });
+        result = std::move(results[i]);
+      }
+      callback(i, result);
+    }
+  } catch (...) {
+    error = std::current_exception();
+    stop = true;
+  }
+  for( auto & thread : threads ) thread.join();
+  if( error ) std::rethrow_exception(error);
+}
+namespace {
+// reads one directory: its subdirectories and the matching files
+void scanDirectory(std::string const & dir, std::string const & pattern,
+    std::vector<std::string> & subdirs, std::vector<FileHelpers::FileStat> & files) {
+  DIR *dirp = opendir(dir.c_str());
+  if( dirp == nullptr ) return;
+  const std::string prefix = dir == "/" ? dir : dir + "/";
+  while( struct dirent *entry = readdir(dirp) ) {
+    const std::string name(entry->d_name);
+    if( name == "." or name == ".." ) continue;
+    const std::string path = prefix + name;
+    bool isdir = entry->d_type == DT_DIR;
+    struct stat buffer;
+    if( entry->d_type == DT_UNKNOWN and lstat(path.c_str(), &buffer) == 0 )
+      isdir = S_ISDIR(buffer.st_mode);
+    if( isdir ) {
+      subdirs.push_back(path);
+      continue;
+    }
+    if( fnmatch(pattern.c_str(), name.c_str(), 0) != 0 ) continue;
+    if( stat(path.c_str(), &buffer) == 0 and S_ISREG(buffer.st_mode) )
+      files.push_back(FileHelpers::FileStat{path, (int)buffer.st_mtime, (long long)buffer.st_size, true});
+  }
+  closedir(dirp);
+}
+}
+std::vector<FileHelpers::FileStat> FileHelpers::crawlDirectory(std::string dir, 
+    std::string const & pattern, std::size_t nthreads) {
+  while( dir.size() > 1 and dir.back() == '/' ) dir.pop_back();
+  struct stat buffer;
+  if( stat(dir.c_str(), &buffer) != 0 or not S_ISDIR(buffer.st_mode) )
+    throw std::runtime_error("\"" + dir + "\" is not a directory.");
+  // the directories that are still to be read are shared by all threads. the
+  // crawl is done when there are none and no thread is reading one.
+  std::mutex mtx;
+  std::condition_variable changed;
+  std::vector<std::string> pending{dir};
+  std::size_t reading = 0;
+  std::vector<FileStat> found;
+  auto work = [&]() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while( true ) {
+      changed.wait(lock, [&]() { return not pending.empty() or reading == 0; });
+      if( pending.empty() ) return;
+      std::string current = std::move(pending.back());
+      pending.pop_back();
+      reading++;
+      lock.unlock();
+      std::vector<std::string> subdirs;
+      std::vector<FileStat> files;
+      scanDirectory(current, pattern, subdirs, files);
+      lock.lock();
+      reading--;
+      pending.insert(pending.end(), subdirs.begin(), subdirs.end());
+      found.insert(found.end(), files.begin(), files.end());
+      changed.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  for( std::size_t i = 1; i < nthreads; ++i ) threads.emplace_back(work);
+  work();
+  for( auto & thread : threads ) thread.join();
+  std::sort(found.begin(), found.end(), 
+      [](FileStat const & a, FileStat const & b) { return a.filename < b.filename; });
+  return found;
+}
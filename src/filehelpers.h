@@ -6,8 +6,52 @@
 #define __FILEHELPERS_H__
 #include <sys/stat.h>
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
 namespace FileHelpers{
 bool file_exists(std::string filename);
 int getFileModificationTime(std::string filename);
+// cheap identification of the contents of a file: the size and a hash of
+// samples of the contents, the first block (with the superblock and usually
+// the object header of the root group) and blocks spread over the rest of
+// the file up to its end.
+struct Fingerprint {
+  long long size = -1; // -1: the file cannot be read
+  std::uint64_t hash = 0;
+  bool operator==(Fingerprint const & other) const {
+    return size == other.size and hash == other.hash;
+  }
+};
+Fingerprint getFingerprint(std::string filename);
+/*
+ * the absolute name of a file with its directory resolved (symbolic links,
+ * "." and ".."), the last component is kept as it is unless the name ends
+ * with "/", "/." or "/..", then it is resolved as a directory as well. the
+ * name is returned unchanged if it cannot be resolved.
+ */
+std::string canonicalPath(std::string const & filename);
+// what stat reported for a file (mtime and size only if it exists):
+struct FileStat {
+  std::string filename;
+  int mtime;
+  long long size;
+  bool exists;
+};
+FileStat statFile(std::string const & filename);
+/*
+ * stats the files in nthreads threads, one stat per file. callback(i, stat)
+ * is called from the calling thread for every file in the order of
+ * filenames, as soon as the files up to i have been stat'ed.
+ */
+void statFiles(std::vector<std::string> const & filenames, std::size_t nthreads,
+    std::function<void(std::size_t, FileStat const &)> const & callback);
+/*
+ * all regular files below dir (named dir/...) whose name matches the glob
+ * pattern, sorted by filename. the directories are read and the files are
+ * stat'ed by nthreads threads. symbolic links to directories are not
+ * followed, unreadable directories are skipped.
+ */
+std::vector<FileStat> crawlDirectory(std::string dir, std::string const & pattern, std::size_t nthreads);
 }
 #endif
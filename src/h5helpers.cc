@@ -4,6 +4,7 @@
  */
 #include "filehelpers.h"
 #include "h5helpers.h"
+#include <stdexcept>
 
 bool H5DataHelpers::h5_file_exists(std::string filename) {
   return FileHelpers::file_exists(filename);
@@ -14,3 +15,71 @@ bool H5DataHelpers::h5_file_is_hdf5(std::string filename) {
 int H5DataHelpers::getFileModificationTime(std::string filename) {
   return FileHelpers::getFileModificationTime(filename);
 }
+H5DataHelpers::FileAccessProfile H5DataHelpers::fileAccessProfileFromString(std::string const & str) {
+  if( str == "default" )       return FileAccessProfile::DEFAULT;
+  else if( str == "metadata" ) return FileAccessProfile::METADATA;
+  else if( str == "sieve" )    return FileAccessProfile::SIEVE;
+  else if( str == "core" )     return FileAccessProfile::CORE;
+  else if( str == "bigcache" ) return FileAccessProfile::BIGCACHE;
+  else throw std::runtime_error("unknown file access profile \"" + str + "\". "
+      "Only default, metadata, sieve, core and bigcache are supported.");
+}
+std::string H5DataHelpers::fileAccessProfileToString(FileAccessProfile const & profile) {
+  switch( profile ) {
+    case FileAccessProfile::DEFAULT:  return "default";
+    case FileAccessProfile::METADATA: return "metadata";
+    case FileAccessProfile::SIEVE:    return "sieve";
+    case FileAccessProfile::CORE:     return "core";
+    case FileAccessProfile::BIGCACHE: return "bigcache";
+    default: throw std::runtime_error("fileAccessProfileToString: unknown profile.");
+  }
+}
+namespace {
+void enlargeMetadataCache(hid_t fapl, std::size_t initial, std::size_t max) {
+  H5AC_cache_config_t config;
+  config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+  H5Pget_mdc_config(fapl, &config);
+  config.set_initial_size = true;
+  config.initial_size = initial;
+  config.max_size = max;
+  if( config.min_size > initial ) config.min_size = initial;
+  H5Pset_mdc_config(fapl, &config);
+}
+}
+hid_t H5DataHelpers::createFileAccessPropertyList(FileAccessProfile const & profile) {
+  hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+  switch( profile ) {
+    case FileAccessProfile::DEFAULT:
+      break;
+    case FileAccessProfile::METADATA:
+      H5Pset_meta_block_size(fapl, 1 << 20);
+      H5Pset_page_buffer_size(fapl, 16 << 20, 0, 0);
+      enlargeMetadataCache(fapl, 16 << 20, 64 << 20);
+      break;
+    case FileAccessProfile::SIEVE:
+      H5Pset_sieve_buf_size(fapl, 4 << 20);
+      break;
+    case FileAccessProfile::CORE:
+      H5Pset_fapl_core(fapl, 64 << 20, 0);
+      break;
+    case FileAccessProfile::BIGCACHE:
+      enlargeMetadataCache(fapl, 32 << 20, 128 << 20);
+      break;
+  }
+  return fapl;
+}
+hid_t H5DataHelpers::openFile(std::string const & filename, FileAccessProfile const & profile) {
+  hid_t fapl = createFileAccessPropertyList(profile);
+  hid_t file_id = -1;
+  if( profile == FileAccessProfile::METADATA ) {
+    // page buffering is only possible for files written with the paged file
+    // space strategy, all other files are opened without:
+    H5E_BEGIN_TRY {
+      file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, fapl);
+    } H5E_END_TRY;
+    if( file_id < 0 ) H5Pset_page_buffer_size(fapl, 0, 0, 0);
+  }
+  if( file_id < 0 ) file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, fapl);
+  H5Pclose(fapl);
+  return file_id;
+}
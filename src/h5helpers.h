@@ -10,5 +10,22 @@ namespace H5DataHelpers{
 bool h5_file_exists(std::string filename);
 bool h5_file_is_hdf5(std::string filename);
 int getFileModificationTime(std::string filename);
+/*
+ * named settings for opening files, for the access patterns of different
+ * filesystems:
+ *   default:  library defaults
+ *   metadata: large metadata blocks and page buffering, few large metadata
+ *             reads instead of many small ones (e.g. lustre)
+ *   sieve:    large sieve buffer for partial reads of contiguous datasets
+ *   core:     the whole file is read into memory on open (small files)
+ *   bigcache: enlarged metadata cache for files with many objects
+ */
+enum class FileAccessProfile { DEFAULT, METADATA, SIEVE, CORE, BIGCACHE };
+FileAccessProfile fileAccessProfileFromString(std::string const & str);
+std::string fileAccessProfileToString(FileAccessProfile const & profile);
+// the file access property list has to be closed by the caller:
+hid_t createFileAccessPropertyList(FileAccessProfile const & profile);
+// opens the file read-only with the given profile:
+hid_t openFile(std::string const & filename, FileAccessProfile const & profile);
 }
 #endif
@@ -3,12 +3,20 @@
  * Licensed under MIT License. See LICENSE in the root directory.
  */
 #include "hdf5ReaderGeneric.h"
+#include "conversionKernels.h"
+#include <memory>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 namespace rqcd_hdf5_reader_generic {
-H5ReaderGeneric::H5ReaderGeneric(File const & file) : H5ReaderGeneric(file.filename) {
+H5ReaderGeneric::H5ReaderGeneric(File const & file, H5DataHelpers::FileAccessProfile const & profile) :
+  H5ReaderGeneric(file.filename, profile) {
   if( not checkMtime(file) )
     std::cerr << "WARNING: file is newer than the requested." << std::endl;
 }
-H5ReaderGeneric::H5ReaderGeneric(std::string const & file) {
+H5ReaderGeneric::H5ReaderGeneric(std::string const & file, H5DataHelpers::FileAccessProfile const & profile) :
+  file_id(-1), fd(-1) {
   if( not H5DataHelpers::h5_file_exists(file) ) {
     std::stringstream sstr;
     sstr << "File \"" << file << "\" does not exist!";
@@ -19,55 +27,236 @@ H5ReaderGeneric::H5ReaderGeneric(std::string const & file) {
     sstr << "File \"" << file << "\" is not a HDF5 file!";
     throw std::runtime_error(sstr.str());
   }
-  file_id = H5Fopen(file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  file_id = H5DataHelpers::openFile(file, profile);
   if( file_id < 0 ) {
     std::stringstream sstr;
     sstr << "File \"" << file << "\" could not be opened!";
     throw std::runtime_error(sstr.str());
   }
+  // second, plain handle for direct reads of contiguous datasets. if this
+  // fails, everything is read through the library. files held in memory are
+  // always read through the library:
+  if( profile != H5DataHelpers::FileAccessProfile::CORE )
+    fd = open(file.c_str(), O_RDONLY);
 }
-H5ReaderGeneric::H5ReaderGeneric(DatasetSpec const & dsetspec) : 
-  H5ReaderGeneric(dsetspec.file) { }
+H5ReaderGeneric::H5ReaderGeneric(DatasetSpec const & dsetspec, H5DataHelpers::FileAccessProfile const & profile) : 
+  H5ReaderGeneric(dsetspec.file, profile) { }
 H5ReaderGeneric::~H5ReaderGeneric() {
+  if( fd >= 0 ) close(fd);
+  if( file_id < 0 ) return; // moved from.
   auto res = H5Fclose(file_id);
   if( res < 0 ) {
     std::cerr << "WARNING: could not close file. maybe it has already been closed?" << std::endl;
   }
 }
-H5ReaderGeneric::H5ReaderGeneric(H5ReaderGeneric && other) {
+H5ReaderGeneric::H5ReaderGeneric(H5ReaderGeneric && other) : file_id(-1), fd(-1) {
   std::swap(file_id, other.file_id);
+  std::swap(fd, other.fd);
+  std::swap(staging, other.staging);
+  std::swap(directLayouts, other.directLayouts);
+}
+namespace {
+/*
+ * how the values of a dataset are stored on disk: the native type they are
+ * read into and the number of values per element (2 for {re, im} compounds).
+ */
+enum class StorageType { FLOAT64, FLOAT32, INT32, UINT32, INT64, UINT64 };
+struct StorageLayout {
+  StorageType type;
+  hsize_t valuesPerElement;
+};
+StorageType storageTypeOf(hid_t atomic) {
+  auto cls  = H5Tget_class(atomic);
+  auto size = H5Tget_size(atomic);
+  if( cls == H5T_FLOAT and size == sizeof(double) ) return StorageType::FLOAT64;
+  if( cls == H5T_FLOAT and size == sizeof(float) )  return StorageType::FLOAT32;
+  if( cls == H5T_INTEGER ) {
+    bool isSigned = (H5Tget_sign(atomic) == H5T_SGN_2);
+    if( size == 4 ) return isSigned ? StorageType::INT32 : StorageType::UINT32;
+    if( size == 8 ) return isSigned ? StorageType::INT64 : StorageType::UINT64;
+  }
+  throw std::runtime_error("dataset type is not supported (only float32/64, "
+      "int32/64 and compounds of two floats are).");
+}
+hid_t nativeTypeOf(StorageType type) {
+  switch( type ) {
+    case StorageType::FLOAT64: return H5T_NATIVE_DOUBLE;
+    case StorageType::FLOAT32: return H5T_NATIVE_FLOAT;
+    case StorageType::INT32:   return H5T_NATIVE_INT32;
+    case StorageType::UINT32:  return H5T_NATIVE_UINT32;
+    case StorageType::INT64:   return H5T_NATIVE_INT64;
+    case StorageType::UINT64:  return H5T_NATIVE_UINT64;
+    default: throw std::runtime_error("nativeTypeOf: unknown storage type.");
+  }
+}
+std::size_t sizeOf(StorageType type) {
+  switch( type ) {
+    case StorageType::FLOAT64: return sizeof(double);
+    case StorageType::FLOAT32: return sizeof(float);
+    case StorageType::INT32:   return sizeof(std::int32_t);
+    case StorageType::UINT32:  return sizeof(std::uint32_t);
+    case StorageType::INT64:   return sizeof(std::int64_t);
+    case StorageType::UINT64:  return sizeof(std::uint64_t);
+    default: throw std::runtime_error("sizeOf: unknown storage type.");
+  }
+}
+StorageLayout storageLayoutOf(hid_t dtype) {
+  if( H5Tget_class(dtype) != H5T_COMPOUND )
+    return StorageLayout{storageTypeOf(dtype), 1u};
+  // complex numbers as compound {re, im} of two floating point members:
+  if( H5Tget_nmembers(dtype) != 2 )
+    throw std::runtime_error("compound datasets must have exactly two members {re, im}.");
+  hid_t re = H5Tget_member_type(dtype, 0);
+  hid_t im = H5Tget_member_type(dtype, 1);
+  bool ok = H5Tget_class(re) == H5T_FLOAT and H5Tget_class(im) == H5T_FLOAT
+        and H5Tget_size(re) == H5Tget_size(im);
+  H5Tclose(im);
+  if( not ok ) {
+    H5Tclose(re);
+    throw std::runtime_error("compound datasets must consist of two floating point members of the same size.");
+  }
+  StorageType type;
+  try {
+    type = storageTypeOf(re);
+  } catch (...) {
+    H5Tclose(re);
+    throw;
+  }
+  H5Tclose(re);
+  return StorageLayout{type, 2u};
+}
+hid_t createMemType(hid_t dtype, StorageLayout const & layout) {
+  hid_t native = nativeTypeOf(layout.type);
+  if( layout.valuesPerElement == 1 ) return H5Tcopy(native);
+  // packed {re, im} in memory with the member names from the file, so that
+  // hdf5 only has to copy (or swap bytes) but not to convert:
+  const std::size_t size = sizeOf(layout.type);
+  hid_t memtype = H5Tcreate(H5T_COMPOUND, 2*size);
+  for( unsigned i = 0; i < 2; ++i ) {
+    char * name = H5Tget_member_name(dtype, i);
+    H5Tinsert(memtype, name, i*size, native);
+    H5free_memory(name);
+  }
+  return memtype;
+}
+template <typename T>
+void convertStaging(std::vector<char> const & staging, double * out, std::size_t n) {
+  convertToDouble(reinterpret_cast<T const *>(staging.data()), out, n);
+}
 }
 std::vector<std::complex<double>> 
 H5ReaderGeneric::read(DatasetSpec const & dsetspec) {
   std::vector<std::complex<double>> res;
-  /* dummy data: */
-  res.push_back(std::complex<double>(1.0, 2.0));
-
-  auto dsetid = H5Dopen(file_id, dsetspec.datasetname.c_str(), H5P_DEFAULT);
-  auto dtype  = H5Dget_type(dsetid);
-  auto dclass = H5Tget_class(dtype);
-
-  if( dclass != H5T_FLOAT) {
+  readInto(dsetspec, res);
+  return res;
+}
+H5ReaderGeneric::DirectLayout const & 
+H5ReaderGeneric::getDirectLayout(std::string const & datasetname) {
+  auto it = directLayouts.find(datasetname);
+  if( it != directLayouts.end() ) return it->second;
+  DirectLayout layout;
+  layout.usable = false;
+  hid_t dsetid = H5Dopen(file_id, datasetname.c_str(), H5P_DEFAULT);
+  if( fd >= 0 and dsetid >= 0 ) {
+    hid_t dtype = H5Dget_type(dsetid);
+    hid_t dcpl  = H5Dget_create_plist(dsetid);
+    hid_t dspace = H5Dget_space(dsetid);
+    layout.ndims = H5Sget_simple_extent_ndims(dspace);
+    // the bytes in the file must be exactly what we want in memory: little
+    // endian doubles on a little endian machine, stored in one contiguous,
+    // unfiltered and already allocated block.
+    bool ok = H5Tequal(dtype, H5T_IEEE_F64LE) > 0 
+          and H5Tequal(H5T_NATIVE_DOUBLE, H5T_IEEE_F64LE) > 0
+          and H5Pget_layout(dcpl) == H5D_CONTIGUOUS
+          and H5Pget_nfilters(dcpl) == 0
+          and (layout.ndims == 1 or layout.ndims == 2)
+          and H5Sget_simple_extent_dims(dspace, layout.dims, NULL) >= 0;
+    if( ok ) {
+      layout.offset = H5Dget_offset(dsetid);
+      hsize_t nelements = layout.dims[0] * (layout.ndims == 2 ? layout.dims[1] : 1u);
+      layout.usable = (layout.offset != HADDR_UNDEF 
+          and H5Dget_storage_size(dsetid) == nelements*sizeof(double));
+    }
+    H5Sclose(dspace);
+    H5Pclose(dcpl);
     H5Tclose(dtype);
-    H5Dclose(dsetid);
-    throw std::runtime_error("dataset does not have float type.");
   }
-
-  auto size = H5Tget_size(dtype);
-  if( size != sizeof(double) ) {
+  if( dsetid >= 0 ) H5Dclose(dsetid);
+  return directLayouts.insert({datasetname, layout}).first->second;
+}
+void H5ReaderGeneric::readDirect(DirectLayout const & layout, DatasetSpec const & dsetspec,
+    std::vector<std::complex<double>> & out) {
+  hsize_t numberOfDoubles = 0;
+  off_t start = layout.offset;
+  if( layout.ndims == 1 ) {
+    if( dsetspec.location.row >= 0 )
+      throw std::runtime_error("row data requested, but dataset has only one dimension.");
+    numberOfDoubles = layout.dims[0];
+  } else if( dsetspec.location.row < 0 ) {
+    numberOfDoubles = layout.dims[0]*layout.dims[1];
+  } else if( (std::size_t)dsetspec.location.row >= layout.dims[0] ) {
+    throw std::runtime_error("requested row is larger than the available rows in the dataset.");
+  } else {
+    numberOfDoubles = layout.dims[1];
+    start += dsetspec.location.row * layout.dims[1] * sizeof(double);
+  }
+  if( numberOfDoubles % 2 != 0 )
+    throw std::runtime_error("read size is odd: cannot be complex numbers.");
+  const std::size_t offset = out.size();
+  out.resize(offset + numberOfDoubles/2);
+  char * dest = reinterpret_cast<char *>(out.data() + offset);
+  std::size_t remaining = numberOfDoubles * sizeof(double);
+  while( remaining > 0 ) {
+    ssize_t nread = pread(fd, dest, remaining, start);
+    if( nread < 0 and errno == EINTR ) continue;
+    if( nread <= 0 ) {
+      out.resize(offset);
+      throw std::runtime_error("could not read dataset (direct read failed).");
+    }
+    dest      += nread;
+    start     += nread;
+    remaining -= nread;
+  }
+}
+void H5ReaderGeneric::readInto(DatasetSpec const & dsetspec, 
+    std::vector<std::complex<double>> & out) {
+  // contiguous doubles are served from the page cache directly, bypassing the
+  // library. the layout is only determined once per dataset:
+  DirectLayout const & direct = getDirectLayout(dsetspec.datasetname);
+  if( direct.usable ) {
+    readDirect(direct, dsetspec, out);
+    return;
+  }
+  auto dsetid = H5Dopen(file_id, dsetspec.datasetname.c_str(), H5P_DEFAULT);
+  if( dsetid < 0 ) {
+    std::stringstream sstr;
+    sstr << "could not open dataset \"" << dsetspec.datasetname << "\".";
+    throw std::runtime_error(sstr.str());
+  }
+  auto dtype  = H5Dget_type(dsetid);
+  StorageLayout layout;
+  try {
+    layout = storageLayoutOf(dtype);
+  } catch (...) {
     H5Tclose(dtype);
     H5Dclose(dsetid);
-    throw std::runtime_error("dataset is not in double precision.");
+    throw;
   }
 
   auto dspace = H5Dget_space(dsetid);
-  if( size < 0 ) {
+  if( dspace < 0 ) {
     H5Tclose(dtype);
     H5Dclose(dsetid);
     throw std::runtime_error("could not open dataspace");
   }
   auto ndims  = H5Sget_simple_extent_ndims(dspace);
-  hsize_t * dims = new hsize_t[ndims];
+  if( ndims != 1 and ndims != 2 ) {
+    H5Sclose(dspace);
+    H5Tclose(dtype);
+    H5Dclose(dsetid);
+    throw std::runtime_error("only one- and two-dimensional datasets can be read.");
+  }
+  hsize_t dims[2];
   auto status = H5Sget_simple_extent_dims(dspace, dims, NULL);
   if( status < 0 ) {
     H5Sclose(dspace);
@@ -76,9 +265,7 @@ H5ReaderGeneric::read(DatasetSpec const & dsetspec) {
     throw std::runtime_error("could not get data space extent.");
   }
 
-  hsize_t numberOfDoubles = 0;
-  hid_t file_space_id = -1;
-  hid_t mem_space_id  = -1;
+  hsize_t numberOfElements = 0;
   if( ndims == 1 ) {
     // read one-dim:
     if( dsetspec.location.row >= 0 ) {
@@ -87,13 +274,11 @@ H5ReaderGeneric::read(DatasetSpec const & dsetspec) {
       H5Dclose(dsetid);
       throw std::runtime_error("row data requested, but dataset has only one dimension.");
     }
-    numberOfDoubles = dims[0];
-    file_space_id = H5S_ALL;
+    numberOfElements = dims[0];
   } else if( ndims == 2 ) {
     if( dsetspec.location.row < 0 ) {
       // read full dataset, serialize
-      numberOfDoubles = dims[0]*dims[1];
-      file_space_id   = H5S_ALL;
+      numberOfElements = dims[0]*dims[1];
     //begin cannot be negative, see above. A cast is save:
     } else if ( (std::size_t)dsetspec.location.row >= dims[0] ) {
       H5Sclose(dspace);
@@ -101,56 +286,132 @@ H5ReaderGeneric::read(DatasetSpec const & dsetspec) {
       H5Dclose(dsetid);
       throw std::runtime_error("requested row is larger than the available rows in the dataset.");
     } else {
-      // read only one column of the dataset:
-      numberOfDoubles = dims[1];
-      const hsize_t dspacedims[2] = {1u, numberOfDoubles};
-      const hssize_t offsets[2] = {dsetspec.location.row, 0u};
-      file_space_id   = H5Screate_simple(2,dspacedims,NULL);
-      status = H5Soffset_simple(file_space_id, offsets);
+      // read only one row of the dataset:
+      numberOfElements = dims[1];
+      const hsize_t start[2] = {(hsize_t)dsetspec.location.row, 0u};
+      const hsize_t count[2] = {1u, numberOfElements};
+      status = H5Sselect_hyperslab(dspace, H5S_SELECT_SET, start, NULL, count, NULL);
       if( status < 0 ) {
         H5Sclose(dspace);
         H5Tclose(dtype);
         H5Dclose(dsetid);
-        throw std::runtime_error("could not set data space offset.");
+        throw std::runtime_error("could not select row in data space.");
       }
     }
   }
   
-  if( numberOfDoubles % 2 != 0 ) {
+  // real and imaginary parts are either consecutive values or the two members
+  // of a compound element:
+  const hsize_t numberOfValues = numberOfElements * layout.valuesPerElement;
+  if( numberOfValues % 2 != 0 ) {
     H5Sclose(dspace);
     H5Tclose(dtype);
     H5Dclose(dsetid);
     throw std::runtime_error("read size is odd: cannot be complex numbers.");
   }
-  double * buf = new double[numberOfDoubles];
-  mem_space_id = H5Screate_simple(1, &numberOfDoubles, NULL);
+  hid_t mem_space_id = H5Screate_simple(1, &numberOfElements, NULL);
   if( mem_space_id < 0 ) {
     H5Sclose(dspace);
     H5Tclose(dtype);
     H5Dclose(dsetid);
     throw std::runtime_error("could create mem dataspace.");
   }
-  status = H5Dread(dsetid, H5T_NATIVE_DOUBLE, H5S_ALL, file_space_id, H5P_DEFAULT, buf);
-  if( status < 0 ) {
-    H5Sclose(dspace);
-    H5Tclose(dtype);
-    H5Dclose(dsetid);
-    throw std::runtime_error("could read dataset.");
-  }
-
-  res.resize(numberOfDoubles/2);
-  for( auto i = 0u; i < numberOfDoubles / 2; ++i) {
-    res[i] = std::complex<double>(buf[2*i], buf[2*i+1]);
+  hid_t memtype = createMemType(dtype, layout);
+  // std::complex<double> is layout compatible to double[2], so we can read
+  // (or convert) straight into the tail of the output vector:
+  const std::size_t offset = out.size();
+  out.resize(offset + numberOfValues/2);
+  double * dest = reinterpret_cast<double *>(out.data() + offset);
+  if( layout.type == StorageType::FLOAT64 ) {
+    status = H5Dread(dsetid, memtype, mem_space_id, dspace, H5P_DEFAULT, dest);
+  } else {
+    // read in the native type of the file and convert ourselves, which is
+    // much faster than the type conversion of the hdf5 library:
+    staging.resize(numberOfValues * sizeOf(layout.type));
+    status = H5Dread(dsetid, memtype, mem_space_id, dspace, H5P_DEFAULT, staging.data());
+    if( status >= 0 ) {
+      switch( layout.type ) {
+        case StorageType::FLOAT32: convertStaging<float>(staging, dest, numberOfValues); break;
+        case StorageType::INT32:   convertStaging<std::int32_t>(staging, dest, numberOfValues); break;
+        case StorageType::UINT32:  convertStaging<std::uint32_t>(staging, dest, numberOfValues); break;
+        case StorageType::INT64:   convertStaging<std::int64_t>(staging, dest, numberOfValues); break;
+        case StorageType::UINT64:  convertStaging<std::uint64_t>(staging, dest, numberOfValues); break;
+        default: break;
+      }
+    }
   }
-  delete[] dims;
-  delete[] buf;
-
+  H5Tclose(memtype);
+  H5Sclose(mem_space_id);
   H5Sclose(dspace);
   H5Tclose(dtype);
   H5Dclose(dsetid);
-  return res;
+  if( status < 0 ) {
+    out.resize(offset);
+    throw std::runtime_error("could not read dataset.");
+  }
 }
 bool H5ReaderGeneric::checkMtime(File const & file) {
   return (file.mtime <= H5DataHelpers::getFileModificationTime(file.filename));
 }
+void AverageAccumulator::add(std::vector<std::complex<double>> const & data) {
+  if( nhits == 0 ) {
+    sum = data;
+  } else {
+    if( data.size() != sum.size() )
+      throw std::runtime_error("cannot average hits of different length.");
+    // plain loop over the real and imaginary parts, vectorized by the compiler:
+    double * s = reinterpret_cast<double *>(sum.data());
+    double const * x = reinterpret_cast<double const *>(data.data());
+    const std::size_t n = 2*data.size();
+    for( std::size_t i = 0; i < n; ++i ) s[i] += x[i];
+  }
+  nhits++;
+}
+std::vector<std::complex<double>> AverageAccumulator::average() const {
+  if( nhits == 0 )
+    throw std::runtime_error("cannot average: no hits.");
+  std::vector<std::complex<double>> res(sum);
+  const double norm = 1.0 / nhits;
+  double * r = reinterpret_cast<double *>(res.data());
+  const std::size_t n = 2*res.size();
+  for( std::size_t i = 0; i < n; ++i ) r[i] *= norm;
+  return res;
+}
+std::vector<std::complex<double>> readAverage(Index const & idx,
+    H5DataHelpers::FileAccessProfile const & profile) {
+  AverageAccumulator acc;
+  std::vector<std::complex<double>> buf;
+  std::unique_ptr<H5ReaderGeneric> reader;
+  std::string currentFile;
+  for( auto const & dset : idx ) {
+    if( not reader or dset.file.filename != currentFile ) {
+      reader.reset(); // close the previous file first.
+      reader.reset(new H5ReaderGeneric(dset.file, profile));
+      currentFile = dset.file.filename;
+    }
+    buf.clear(); // keeps the capacity, no reallocation for equally sized hits
+    reader->readInto(dset, buf);
+    acc.add(buf);
+  }
+  return acc.average();
+}
+std::vector<std::complex<double>> readConcatenated(Index const & idx,
+    H5DataHelpers::FileAccessProfile const & profile) {
+  std::vector<std::complex<double>> res;
+  std::unique_ptr<H5ReaderGeneric> reader;
+  std::string currentFile;
+  for( auto const & dset : idx ) {
+    if( not reader or dset.file.filename != currentFile ) {
+      reader.reset();
+      reader.reset(new H5ReaderGeneric(dset.file, profile));
+      currentFile = dset.file.filename;
+    }
+    reader->readInto(dset, res);
+    // hits are usually of the same length: after the first one, reserve
+    // enough space for all of them to avoid repeated reallocations:
+    if( &dset == &idx.front() )
+      res.reserve(res.size() * idx.size());
+  }
+  return res;
+}
 }
@@ -8,6 +8,7 @@
 #include "h5helpers.h"
 #include "attributes.h" // for dsetspec / file
 #include <vector>
+#include <map>
 #include <complex>
 #include <string>
 #include <sstream>
@@ -16,16 +17,60 @@ namespace rqcd_hdf5_reader_generic {
 using namespace rqcd_file_index;
 class H5ReaderGeneric{
   public:
-  H5ReaderGeneric(File const & file);
-  H5ReaderGeneric(std::string const & file);
-  H5ReaderGeneric(DatasetSpec const & dsetspec);
+  H5ReaderGeneric(File const & file,
+      H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT);
+  H5ReaderGeneric(std::string const & file,
+      H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT);
+  H5ReaderGeneric(DatasetSpec const & dsetspec,
+      H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT);
   ~H5ReaderGeneric();
   H5ReaderGeneric(H5ReaderGeneric const &) = delete; // no copy,
   H5ReaderGeneric(H5ReaderGeneric && other); // just move!
   std::vector<std::complex<double>> read(DatasetSpec const & dsetspec);
+  // appends the data of dsetspec to out, reading directly into its storage:
+  void readInto(DatasetSpec const & dsetspec, std::vector<std::complex<double>> & out);
+  // true if the dataset is read with pread, see DirectLayout:
+  bool readsDirectly(std::string const & datasetname) { return getDirectLayout(datasetname).usable; }
   private:
+  /*
+   * datasets of contiguous, unfiltered little endian doubles are read with
+   * pread at their offset in the file instead of H5Dread.
+   */
+  struct DirectLayout {
+    bool usable;
+    haddr_t offset;
+    int ndims;
+    hsize_t dims[2];
+  };
   hid_t file_id;
+  int fd;
+  // reused buffer for data that is not stored in double precision:
+  std::vector<char> staging;
+  // cache of the layouts, by dataset name:
+  std::map<std::string, DirectLayout> directLayouts;
+  DirectLayout const & getDirectLayout(std::string const & datasetname);
+  void readDirect(DirectLayout const & layout, DatasetSpec const & dsetspec,
+      std::vector<std::complex<double>> & out);
   bool checkMtime(File const & file);
 };
+/*
+ * running sum over many hits of the same length. only one buffer of the size
+ * of a single hit is held, independent of the number of hits added.
+ */
+class AverageAccumulator {
+  public:
+  void add(std::vector<std::complex<double>> const & data);
+  std::vector<std::complex<double>> average() const;
+  std::size_t count() const { return nhits; }
+  private:
+  std::vector<std::complex<double>> sum;
+  std::size_t nhits = 0;
+};
+// streaming reductions over all datasets in idx (reopening files only when
+// the file changes between consecutive entries):
+std::vector<std::complex<double>> readAverage(Index const & idx,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT);
+std::vector<std::complex<double>> readConcatenated(Index const & idx,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT);
 }
 #endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include "indexFormats.h"
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace rqcd_file_index {
+IndexWriter::IndexWriter(std::ostream & os_, std::size_t buffersize_) :
+  os(os_), buffersize(buffersize_) {
+  buffer.reserve(buffersize + 4096);
+}
+void IndexWriter::write(DatasetSpec const & dset) {
+  append(dset);
+  if( buffer.size() >= buffersize ) {
+    os.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+void IndexWriter::flush() {
+  os.write(buffer.data(), buffer.size());
+  buffer.clear();
+  os.flush();
+}
+
+void TextIndexWriter::append(DatasetSpec const & dset) {
+  sstr.str("");
+  sstr << "dataset \"" << dset.datasetname << "\" (from file \""
+    << dset.file.filename << "\" and row " << dset.location.row << ")" <<
+    " has the following attributes:\n";
+  for ( auto const & attr : dset.attributes ) {
+    sstr << "  - " << attr.getName()
+      << " (" << typeToString(attr.getType()) << ") = "
+      << attr.getValue() << "\n";
+  }
+  buffer += sstr.str();
+}
+
+namespace {
+void appendJsonString(std::string & buf, std::string const & str) {
+  buf += '"';
+  for( char c : str ) {
+    switch( c ) {
+      case '"':  buf += "\\\""; break;
+      case '\\': buf += "\\\\"; break;
+      case '\n': buf += "\\n"; break;
+      case '\t': buf += "\\t"; break;
+      case '\r': buf += "\\r"; break;
+      default:
+        if( (unsigned char)c < 0x20 ) {
+          char esc[8];
+          std::snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)(unsigned char)c);
+          buf += esc;
+        } else {
+          buf += c;
+        }
+    }
+  }
+  buf += '"';
+}
+// the shortest of 15 and 17 digits that is read back as the same double:
+void appendJsonNumber(std::string & buf, double val) {
+  if( not std::isfinite(val) )
+    throw std::runtime_error("cannot write " + std::to_string(val) + " as json number.");
+  // integers (as most attributes are) directly:
+  if( std::fabs(val) < 1e15 and val == std::floor(val) ) {
+    buf += std::to_string((long long)val);
+    return;
+  }
+  char num[32];
+  std::snprintf(num, sizeof(num), "%.15g", val);
+  if( std::strtod(num, nullptr) != val ) std::snprintf(num, sizeof(num), "%.17g", val);
+  buf += num;
+}
+void appendJsonValue(std::string & buf, Value const & val) {
+  switch( val.getType() ) {
+    case Type::NUMERIC: appendJsonNumber(buf, val.getNumeric()); break;
+    case Type::STRING:  appendJsonString(buf, val.getString()); break;
+    case Type::BOOLEAN: buf += val.getBool() ? "true" : "false"; break;
+    case Type::ARRAY: {
+      buf += '{';
+      bool first = true;
+      for( auto const & elem : val.getMap() ) {
+        if( not first ) buf += ", ";
+        first = false;
+        appendJsonString(buf, elem.first);
+        buf += ": ";
+        appendJsonValue(buf, elem.second);
+      }
+      buf += '}';
+      break;
+    }
+    default:
+      throw std::runtime_error("unsupported type for json output.");
+  }
+}
+}
+void JsonLinesIndexWriter::append(DatasetSpec const & dset) {
+  buffer += "{\"attributes\": {";
+  for( auto i = 0u; i < dset.attributes.size(); ++i ) {
+    if( i ) buffer += ", ";
+    appendJsonString(buffer, dset.attributes[i].getName());
+    buffer += ": ";
+    appendJsonValue(buffer, dset.attributes[i].getValue());
+  }
+  buffer += "}, \"datasetname\": ";
+  appendJsonString(buffer, dset.datasetname);
+  buffer += ", \"file\": {\"filename\": ";
+  appendJsonString(buffer, dset.file.filename);
+  buffer += ", \"mtime\": " + std::to_string(dset.file.mtime)
+    + "}, \"location\": {\"row\": " + std::to_string(dset.location.row) + "}}\n";
+}
+
+namespace {
+const char binaryMagic[] = "MDIB";
+const std::uint32_t binaryVersion = 1;
+enum BinaryType : std::uint8_t { NUMERIC_VALUE = 0, STRING_VALUE = 1, BOOLEAN_VALUE = 2, ARRAY_VALUE = 3 };
+
+void appendUnsigned(std::string & buf, std::uint64_t val, int nbytes) {
+  for( int i = 0; i < nbytes; ++i ) buf += (char)((val >> (8*i)) & 0xff);
+}
+void appendBinaryString(std::string & buf, std::string const & str) {
+  appendUnsigned(buf, str.size(), 4);
+  buf += str;
+}
+void appendBinaryValue(std::string & buf, Value const & val) {
+  switch( val.getType() ) {
+    case Type::NUMERIC: {
+      std::uint64_t bits;
+      const double num = val.getNumeric();
+      std::memcpy(&bits, &num, sizeof(bits));
+      buf += (char)NUMERIC_VALUE;
+      appendUnsigned(buf, bits, 8);
+      break;
+    }
+    case Type::STRING:
+      buf += (char)STRING_VALUE;
+      appendBinaryString(buf, val.getString());
+      break;
+    case Type::BOOLEAN:
+      buf += (char)BOOLEAN_VALUE;
+      buf += (char)(val.getBool() ? 1 : 0);
+      break;
+    case Type::ARRAY:
+      buf += (char)ARRAY_VALUE;
+      appendUnsigned(buf, val.getMap().size(), 4);
+      for( auto const & elem : val.getMap() ) {
+        appendBinaryString(buf, elem.first);
+        appendBinaryValue(buf, elem.second);
+      }
+      break;
+    default:
+      throw std::runtime_error("unsupported type for binary output.");
+  }
+}
+
+/*
+ * reads the binary format from a stream, failing on truncated input.
+ */
+class BinaryReader {
+  public:
+  explicit BinaryReader(std::istream & is_) : is(is_) {}
+  // true at the end of the stream, between the records:
+  bool atEnd() { return is.peek() == std::char_traits<char>::eof(); }
+  std::uint64_t readUnsigned(int nbytes) {
+    unsigned char bytes[8];
+    read(reinterpret_cast<char *>(bytes), nbytes);
+    std::uint64_t val = 0;
+    for( int i = nbytes - 1; i >= 0; --i ) val = (val << 8) | bytes[i];
+    return val;
+  }
+  std::string readString() {
+    std::string str(readUnsigned(4), '\0');
+    if( not str.empty() ) read(&str[0], str.size());
+    return str;
+  }
+  Value readValue() {
+    switch( readUnsigned(1) ) {
+      case NUMERIC_VALUE: {
+        const std::uint64_t bits = readUnsigned(8);
+        double num;
+        std::memcpy(&num, &bits, sizeof(num));
+        return Value(num);
+      }
+      case STRING_VALUE:  return Value(readString());
+      case BOOLEAN_VALUE: return Value(readUnsigned(1) != 0);
+      case ARRAY_VALUE: {
+        std::map<std::string, Value> elems;
+        for( auto n = readUnsigned(4); n > 0; --n ) {
+          std::string key = readString();
+          elems.insert({key, readValue()});
+        }
+        return Value(std::move(elems));
+      }
+      default:
+        throw std::runtime_error("binary index: unknown value type.");
+    }
+  }
+  void read(char * data, std::size_t n) {
+    if( not is.read(data, n) ) throw std::runtime_error("binary index: unexpected end of input.");
+  }
+  private:
+  std::istream & is;
+};
+}
+BinaryIndexWriter::BinaryIndexWriter(std::ostream & os_, std::size_t buffersize_) :
+  IndexWriter(os_, buffersize_) {
+  buffer.append(binaryMagic, 4);
+  appendUnsigned(buffer, binaryVersion, 4);
+}
+void BinaryIndexWriter::append(DatasetSpec const & dset) {
+  appendBinaryString(buffer, dset.datasetname);
+  appendBinaryString(buffer, dset.file.filename);
+  appendUnsigned(buffer, (std::uint64_t)(std::int64_t)dset.file.mtime, 8);
+  appendUnsigned(buffer, (std::uint32_t)(std::int32_t)dset.location.row, 4);
+  appendUnsigned(buffer, dset.attributes.size(), 4);
+  for( auto const & attr : dset.attributes ) {
+    appendBinaryString(buffer, attr.getName());
+    appendBinaryValue(buffer, attr.getValue());
+  }
+}
+Index readBinaryIndex(std::istream & is) {
+  BinaryReader reader(is);
+  char magic[4];
+  reader.read(magic, 4);
+  if( std::memcmp(magic, binaryMagic, 4) != 0 )
+    throw std::runtime_error("binary index: not an index.");
+  const auto version = reader.readUnsigned(4);
+  if( version != binaryVersion ) {
+    std::stringstream errstr;
+    errstr << "binary index: unsupported version " << version << ".";
+    throw std::runtime_error(errstr.str());
+  }
+  Index idx;
+  while( not reader.atEnd() ) {
+    DatasetSpec dset;
+    dset.datasetname = reader.readString();
+    dset.file.filename = reader.readString();
+    dset.file.mtime = (int)(std::int64_t)reader.readUnsigned(8);
+    dset.location.row = (int)(std::int32_t)reader.readUnsigned(4);
+    for( auto n = reader.readUnsigned(4); n > 0; --n ) {
+      std::string name = reader.readString();
+      dset.attributes.push_back(Attribute(name, reader.readValue()));
+    }
+    idx.push_back(std::move(dset));
+  }
+  return idx;
+}
+std::unique_ptr<IndexWriter> makeIndexWriter(std::string const & format, std::ostream & os) {
+  if( format == "text" ) return std::unique_ptr<IndexWriter>(new TextIndexWriter(os));
+  if( format == "jsonl" ) return std::unique_ptr<IndexWriter>(new JsonLinesIndexWriter(os));
+  if( format == "binary" ) return std::unique_ptr<IndexWriter>(new BinaryIndexWriter(os));
+  throw std::runtime_error("unknown output format " + format + " (text, jsonl or binary).");
+}
+}
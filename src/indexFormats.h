@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __INDEXFORMATS_H__
+#define __INDEXFORMATS_H__
+#include <string>
+#include <ostream>
+#include <istream>
+#include <sstream>
+#include <memory>
+#include "attributes.h"
+
+namespace rqcd_file_index {
+/*
+ * writes datasets one after the other, e.g. the hits of a query as they are
+ * found. the records are collected in a large buffer, which is written to
+ * the stream when it is full and by flush(), instead of flushing every line.
+ */
+class IndexWriter {
+  public:
+    explicit IndexWriter(std::ostream & os_, std::size_t buffersize_ = 1 << 20);
+    virtual ~IndexWriter() {}
+    IndexWriter(IndexWriter const &) = delete;
+    void write(DatasetSpec const & dset);
+    void write(Index const & idx) { for( auto const & dset : idx ) write(dset); }
+    // writes the buffer to the stream and flushes it:
+    void flush();
+  protected:
+    virtual void append(DatasetSpec const & dset) = 0;
+    std::string buffer;
+  private:
+    std::ostream & os;
+    std::size_t buffersize;
+};
+// the human readable description of printIndex:
+class TextIndexWriter : public IndexWriter {
+  public:
+    using IndexWriter::IndexWriter;
+  private:
+    void append(DatasetSpec const & dset) override;
+    std::stringstream sstr; // reused for formatting the values
+};
+/*
+ * JSON Lines: one dataset per line, in the format read by dsetSpecFromString.
+ * unlike operator<<, strings are always quoted and escaped, and numbers are
+ * written such that they are read back exactly.
+ */
+class JsonLinesIndexWriter : public IndexWriter {
+  public:
+    using IndexWriter::IndexWriter;
+  private:
+    void append(DatasetSpec const & dset) override;
+};
+/*
+ * a compact binary format. all integers are little endian, strings are their
+ * length (u32) followed by their bytes. the stream starts with "MDIB" and
+ * the version (u32, 1), then follow the datasets:
+ *
+ *   datasetname, filename, mtime (i64), row (i32), number of attributes (u32)
+ *
+ * and each attribute as its name and its value: the type (u8: 0 numeric,
+ * 1 string, 2 boolean, 3 array), then a double (as its ieee 754 bits in a
+ * u64), a string, a u8, or the number of elements (u32) and each element as
+ * its key (a string) and its value.
+ */
+class BinaryIndexWriter : public IndexWriter {
+  public:
+    explicit BinaryIndexWriter(std::ostream & os_, std::size_t buffersize_ = 1 << 20);
+  private:
+    void append(DatasetSpec const & dset) override;
+};
+// the writer for a format: "text", "jsonl" or "binary":
+std::unique_ptr<IndexWriter> makeIndexWriter(std::string const & format, std::ostream & os);
+// reads all datasets written by a BinaryIndexWriter:
+Index readBinaryIndex(std::istream & is);
+}
+#endif
@@ -5,139 +5,289 @@
 #include "indexHdf5.h"
 #include "h5helpers.h"
 #include "hdf5.h"
-#include "hdf5_hl.h"
 #include <vector>
 #include <iostream>
 #include <algorithm>
 #include <sstream>
-
-//defines maximum char length for field names in tables.
-#define CHARMAX 1024
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 namespace rqcd_file_index {
-Value readArray( hid_t type, std::size_t idx, void const * buf, std::size_t const & size){
-  hid_t arrtype = H5Tget_member_type(type, idx);
-  auto ndims = H5Tget_array_ndims(arrtype);
-  hsize_t * dims = new hsize_t[ndims];
-  H5Tget_array_dims(arrtype, dims);
-  hid_t super = H5Tget_super( arrtype );
-  std::stringstream sstr;
-  std::map<std::string, Value> arrmap;
-  if( ndims != 1 ) throw std::runtime_error("not implemented / not tested for multidim arrays!");
-  for( auto idim = 0; idim < ndims; ++idim ) {
-    if( H5Tget_class( super ) == H5T_INTEGER ) {
-      for( auto i = 0u; i < dims[idim]; ++i ) {
-        sstr.str(""); sstr.clear(); sstr << i;
-        arrmap.insert({sstr.str(), Value( (double)((int*)buf)[i] )});
-      }
-      if( size != sizeof(int)*dims[idim] ) {
-        delete[] dims;
-        throw std::runtime_error("invalid read size.");
-      }
-    } else if ( H5Tget_class( super ) == H5T_FLOAT ) {
-      for( auto i = 0u; i < dims[idim]; ++i ) {
-        sstr.str(""); sstr.clear(); sstr << i;
-        arrmap.insert({sstr.str(), Value( ((double*)buf)[i] )});
+namespace {
+// memory type of boolean enums (FALSE = 0, TRUE = 1), as written e.g. by h5py:
+hid_t createBoolMemType() {
+  hid_t memtype = H5Tenum_create(H5T_NATIVE_INT8);
+  std::int8_t f = 0, t = 1;
+  H5Tenum_insert(memtype, "FALSE", &f);
+  H5Tenum_insert(memtype, "TRUE", &t);
+  return memtype;
+}
+// reads a single member of a compound dataset for all rows into buf:
+herr_t readMember(hid_t dset_id, std::string const & member, hid_t memtype, void * buf, 
+    std::size_t & operations) {
+  hid_t comptype = H5Tcreate(H5T_COMPOUND, H5Tget_size(memtype));
+  H5Tinsert(comptype, member.c_str(), 0, memtype);
+  operations++;
+  herr_t status = H5Dread(dset_id, comptype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf);
+  H5Tclose(comptype);
+  return status;
+}
+TableColumn readColumn(hid_t dset_id, std::string const & fieldname, hid_t fieldtype, std::size_t nrows,
+    std::size_t & operations) {
+  std::stringstream errstr;
+  // stays 0 for the types that are not read:
+  herr_t status = 0;
+  switch( H5Tget_class(fieldtype) ) {
+    case H5T_INTEGER:
+    case H5T_FLOAT: {
+      // integers of any width are converted by the library:
+      TableColumn col(fieldname, Type::NUMERIC);
+      col.numbers.resize(nrows);
+      status = readMember(dset_id, fieldname, H5T_NATIVE_DOUBLE, col.numbers.data(), operations);
+      if( status >= 0 ) return col;
+      break;
+    }
+    case H5T_ENUM: {
+      if( H5Tget_nmembers(fieldtype) != 2 ) break;
+      TableColumn col(fieldname, Type::BOOLEAN);
+      col.booleans.resize(nrows);
+      hid_t memtype = createBoolMemType();
+      status = readMember(dset_id, fieldname, memtype, col.booleans.data(), operations);
+      H5Tclose(memtype);
+      if( status >= 0 ) return col;
+      break;
+    }
+    case H5T_STRING: {
+      TableColumn col(fieldname, Type::STRING);
+      col.strings.reserve(nrows);
+      if( H5Tis_variable_str(fieldtype) > 0 ) {
+        std::vector<char *> buf(nrows, nullptr);
+        hid_t memtype = H5Tcopy(H5T_C_S1);
+        H5Tset_size(memtype, H5T_VARIABLE);
+        status = readMember(dset_id, fieldname, memtype, buf.data(), operations);
+        H5Tclose(memtype);
+        if( status >= 0 ) {
+          for( auto str : buf ) col.strings.push_back(str != nullptr ? std::string(str) : std::string());
+        }
+        for( auto str : buf ) H5free_memory(str);
+      } else {
+        const std::size_t size = H5Tget_size(fieldtype);
+        std::vector<char> buf(nrows*size);
+        hid_t memtype = H5Tcopy(fieldtype);
+        status = readMember(dset_id, fieldname, memtype, buf.data(), operations);
+        H5Tclose(memtype);
+        for( std::size_t row = 0; status >= 0 && row < nrows; ++row ) {
+          const char * begin = buf.data() + row*size;
+          col.strings.push_back(std::string(begin, strnlen(begin, size)));
+        }
       }
-      if( size != sizeof(double)*dims[idim] ){
-        delete[] dims;
-        throw std::runtime_error("invalid read size.");
+      if( status >= 0 ) return col;
+      break;
+    }
+    case H5T_ARRAY: {
+      // one-dimensional numeric arrays:
+      if( H5Tget_array_ndims(fieldtype) != 1 ) {
+        errstr << "table field \"" << fieldname << "\": multidimensional arrays are not implemented.";
+        throw std::runtime_error(errstr.str());
       }
-        /*
-         * TODO: add Float, Bool, String... 
-         */
-    } else {
-      delete[] dims;
-      throw std::runtime_error("not implemented array type.");
+      hsize_t width;
+      H5Tget_array_dims2(fieldtype, &width);
+      hid_t super = H5Tget_super(fieldtype);
+      H5T_class_t superclass = H5Tget_class(super);
+      H5Tclose(super);
+      if( superclass != H5T_INTEGER and superclass != H5T_FLOAT ) break;
+      TableColumn col(fieldname, Type::ARRAY, width);
+      col.numbers.resize(nrows*width);
+      hid_t memtype = H5Tarray_create2(H5T_NATIVE_DOUBLE, 1, &width);
+      status = readMember(dset_id, fieldname, memtype, col.numbers.data(), operations);
+      H5Tclose(memtype);
+      if( status >= 0 ) return col;
+      break;
     }
+    default: break;
   }
-  delete[] dims;
-  H5Tclose(super);
-  H5Tclose(arrtype);
-  return Value(arrmap);
+  if( status < 0 ) errstr << "cannot read table field \"" << fieldname << "\" (status " << status << ").";
+  else errstr << "table field \"" << fieldname << "\": type not implemented.";
+  throw std::runtime_error(errstr.str());
+}
 }
-Value readTable(hid_t link, const char* name) {
+Table readTable(hid_t link, const char* name, std::size_t * operations) {
   /*
-   * returns "a" value, containing the complete table as arrays:
-   *
-   * top level: "numeric" list of entries
-   *   ["0"]["row"]: (row number)
-   *        ["fields"]["somefieldname"]: (value)
-   *                  ["otherfieldname"]: (othervalue)
-   *   ["1"]["row"]: ...
-   *        ["fields"]...
+   * reads the table column by column: each field is read for all rows at once
+   * into a typed column (see table.h), the rows are only formed when the
+   * datasets are split (splitDsetSpecWithTable).
    */
-  std::map<std::string, Value> outerTable, rowTable, innerTable;
-  hsize_t nfields, nrecords;
-  H5TBget_table_info( link, name, &nfields, &nrecords);
-  char** fieldnames = new char*[nfields]; size_t* fieldsizes = new size_t[nfields];
-  for( auto i =00u ; i < nfields; i++) { fieldnames[i] = new char[CHARMAX]; }
-  size_t* fieldoffsets = new size_t[nfields]; size_t typesize;
-  H5TBget_field_info( link, name, fieldnames, fieldsizes, fieldoffsets, &typesize );
-  char* buffer = new char[typesize*nrecords];
-  H5TBread_table(link, name, typesize, fieldoffsets, fieldsizes, buffer);
-  
-  // interpretation:
-  // read type:
+  std::size_t uncounted = 0;
+  std::size_t & ops = operations != nullptr ? *operations : uncounted;
+  ops++;
   hid_t dset_id = H5Dopen(link, name, H5P_DEFAULT);
+  if( dset_id < 0 ) throw std::runtime_error("cannot open table.");
+  ops += 3; // type, space and close
   hid_t type_id = H5Dget_type(dset_id);
-  if( H5Tget_class(type_id) != H5T_COMPOUND )
-    throw std::runtime_error("table type is not compound.");
-  int nmembers = H5Tget_nmembers(type_id);
-  std::stringstream sstr;
-  for( auto irecord = 0u; irecord < nrecords; ++irecord ) {
-    rowTable.clear();
-    innerTable.clear();
-    for( auto i = 0; i < nmembers; i++ ) {
-      if( H5Tget_member_class( type_id, i ) == H5T_INTEGER ) {
-        Value val((double)*((int const *)(&buffer[typesize*irecord+fieldoffsets[i]])));
-        innerTable.insert({fieldnames[i], val});
-      } else if (H5Tget_member_class( type_id, i ) == H5T_ARRAY ) {
-        Value val = readArray(type_id, i, &(buffer[typesize*irecord+fieldoffsets[i]]), fieldsizes[i]);
-        innerTable.insert({fieldnames[i], val});
-        /*
-         * TODO: add Float, Bool, String... 
-         */
-      } else {
-        throw std::runtime_error("not implemented.");
+  hid_t space_id = H5Dget_space(dset_id);
+  Table res;
+  res.nrows = H5Sget_simple_extent_npoints(space_id);
+  H5Sclose(space_id);
+  try {
+    if( H5Tget_class(type_id) != H5T_COMPOUND )
+      throw std::runtime_error("table type is not compound.");
+    const int nmembers = H5Tget_nmembers(type_id);
+    res.columns.reserve(nmembers);
+    for( int i = 0; i < nmembers; i++ ) {
+      char * membername = H5Tget_member_name(type_id, i);
+      std::string fieldname(membername);
+      H5free_memory(membername);
+      hid_t fieldtype = H5Tget_member_type(type_id, i);
+      try {
+        res.columns.push_back(readColumn(dset_id, fieldname, fieldtype, res.nrows, ops));
+      } catch( ... ) {
+        H5Tclose(fieldtype);
+        throw;
       }
+      H5Tclose(fieldtype);
     }
-    rowTable.insert({"fields", innerTable});
-    rowTable.insert({"row", Value((double)irecord)});
-    sstr.clear(); sstr.str(""); sstr << irecord;
-    outerTable.insert({sstr.str(), Value(rowTable)});
+  } catch( ... ) {
+    H5Tclose(type_id);
+    H5Dclose(dset_id);
+    throw;
   }
   H5Tclose(type_id);
   H5Dclose(dset_id);
-  delete[] buffer;
-  for( auto i = 0u; i < nfields; i++) { delete[] fieldnames[i]; }
-  delete[] fieldsizes; delete[] fieldoffsets; delete[] fieldnames; 
-  return Value(outerTable);
+  return res;
 }
-
 bool isTable( hid_t link, const char* name ) {
-  hid_t oid = H5Oopen(link, name, H5P_DEFAULT);
-  if( not H5Aexists_by_name(link, name, "CLASS", H5P_DEFAULT) ) {
-    H5Oclose(oid);
+  if( H5Aexists_by_name(link, name, "CLASS", H5P_DEFAULT) <= 0 )
     return false;
-  }
   hid_t attrid =  H5Aopen_by_name(link, name, "CLASS", H5P_DEFAULT, H5P_DEFAULT);
+  if( attrid < 0 ) return false;
   hid_t dtype = H5Aget_type(attrid);
-  auto size = H5Tget_size(dtype);
-  char* buf = new char[size];
-  auto res = H5Aread(attrid, dtype, buf);
-  if( res != 0 ) { 
-    delete[] buf;
-    H5Tclose(dtype);
-    H5Aclose(attrid);
-    return false;
+  bool res = false;
+  if( H5Tget_class(dtype) == H5T_STRING and not H5Tis_variable_str(dtype) ) {
+    auto size = H5Tget_size(dtype);
+    std::string buf(size, '\0');
+    if( H5Aread(attrid, dtype, &buf[0]) >= 0 )
+      res = (std::string(buf.c_str()) == "TABLE");
   }
-  std::string strbuf(buf);
-  delete[] buf;
   H5Tclose(dtype);
   H5Aclose(attrid);
-  H5Oclose(oid);
-  return strbuf == "TABLE";
+  return res;
+}
+namespace {
+/*
+ * typed decoding of attribute data: the class and size of the attribute type
+ * are inspected once, the data is then read in exactly this (native) type.
+ * scalars are read into a single variable, arrays into one contiguous buffer.
+ */
+herr_t readAttribute(AttributeIteration & iteration, hid_t attr_id, hid_t memtype, void * buf) {
+  iteration.operations++;
+  return H5Aread(attr_id, memtype, buf);
+}
+template <typename T>
+herr_t decodeNumeric(hid_t attr_id, hid_t memtype, std::size_t npts,
+    char const * name, AttributeIteration & iteration) {
+  if( npts == 1 ) {
+    T val;
+    herr_t status = readAttribute(iteration, attr_id, memtype, &val);
+    if( status < 0 ) return status;
+    iteration.attrs.push_back(Attribute(name, Value((double)val)));
+    return 0;
+  }
+  std::vector<T> buf(npts);
+  herr_t status = readAttribute(iteration, attr_id, memtype, buf.data());
+  if( status < 0 ) return status;
+  std::vector<Value> elems;
+  elems.reserve(npts);
+  for( auto const & val : buf ) elems.push_back(Value((double)val));
+  iteration.attrs.push_back(Attribute(name, arrayFromElements(std::move(elems))));
+  return 0;
+}
+herr_t decodeInteger(hid_t attr_id, hid_t dtype, std::size_t npts,
+    char const * name, AttributeIteration & iteration) {
+  const bool isSigned = (H5Tget_sign(dtype) == H5T_SGN_2);
+  switch( H5Tget_size(dtype) ) {
+    case 1: return isSigned ? decodeNumeric<std::int8_t>(attr_id, H5T_NATIVE_INT8, npts, name, iteration)
+                            : decodeNumeric<std::uint8_t>(attr_id, H5T_NATIVE_UINT8, npts, name, iteration);
+    case 2: return isSigned ? decodeNumeric<std::int16_t>(attr_id, H5T_NATIVE_INT16, npts, name, iteration)
+                            : decodeNumeric<std::uint16_t>(attr_id, H5T_NATIVE_UINT16, npts, name, iteration);
+    case 4: return isSigned ? decodeNumeric<std::int32_t>(attr_id, H5T_NATIVE_INT32, npts, name, iteration)
+                            : decodeNumeric<std::uint32_t>(attr_id, H5T_NATIVE_UINT32, npts, name, iteration);
+    case 8: return isSigned ? decodeNumeric<std::int64_t>(attr_id, H5T_NATIVE_INT64, npts, name, iteration)
+                            : decodeNumeric<std::uint64_t>(attr_id, H5T_NATIVE_UINT64, npts, name, iteration);
+    default: return -2;
+  }
+}
+herr_t decodeFloat(hid_t attr_id, hid_t dtype, std::size_t npts,
+    char const * name, AttributeIteration & iteration) {
+  if( H5Tget_size(dtype) == sizeof(float) )
+    return decodeNumeric<float>(attr_id, H5T_NATIVE_FLOAT, npts, name, iteration);
+  // double, and everything else converted to double by the library:
+  return decodeNumeric<double>(attr_id, H5T_NATIVE_DOUBLE, npts, name, iteration);
+}
+herr_t decodeBoolEnum(hid_t attr_id, hid_t dtype, std::size_t npts,
+    char const * name, AttributeIteration & iteration) {
+  // only boolean enums are supported, i.e. two members FALSE and TRUE:
+  if( H5Tget_nmembers(dtype) != 2 ) return -2;
+  hid_t memtype = createBoolMemType();
+  std::vector<std::int8_t> buf(npts);
+  herr_t status = readAttribute(iteration, attr_id, memtype, buf.data());
+  H5Tclose(memtype);
+  if( status < 0 ) return -2; // not a FALSE/TRUE enum
+  if( npts == 1 ) {
+    iteration.attrs.push_back(Attribute(name, Value(buf[0] != 0)));
+  } else {
+    std::vector<Value> elems;
+    elems.reserve(npts);
+    for( auto const & val : buf ) elems.push_back(Value(val != 0));
+    iteration.attrs.push_back(Attribute(name, arrayFromElements(std::move(elems))));
+  }
+  return 0;
+}
+herr_t decodeString(hid_t attr_id, hid_t dtype, std::size_t npts,
+    char const * name, AttributeIteration & iteration) {
+  std::vector<std::string> strings;
+  strings.reserve(npts);
+  if( H5Tis_variable_str(dtype) > 0 ) {
+    std::vector<char *> buf(npts, nullptr);
+    hid_t memtype = H5Tcopy(H5T_C_S1);
+    H5Tset_size(memtype, H5T_VARIABLE);
+    herr_t status = readAttribute(iteration, attr_id, memtype, buf.data());
+    if( status >= 0 ) {
+      for( auto str : buf ) strings.push_back(str != nullptr ? std::string(str) : std::string());
+      hsize_t dims = npts;
+      hid_t space = H5Screate_simple(1, &dims, NULL);
+      H5Dvlen_reclaim(memtype, space, H5P_DEFAULT, buf.data());
+      H5Sclose(space);
+    }
+    H5Tclose(memtype);
+    if( status < 0 ) return status;
+  } else {
+    // fixed length strings, possibly not null terminated:
+    const std::size_t size = H5Tget_size(dtype);
+    std::vector<char> buf(npts * size);
+    herr_t status = readAttribute(iteration, attr_id, dtype, buf.data());
+    if( status < 0 ) return status;
+    for( std::size_t i = 0; i < npts; ++i ) {
+      const char * begin = buf.data() + i*size;
+      strings.push_back(std::string(begin, strnlen(begin, size)));
+    }
+  }
+  if( npts == 1 ) {
+    iteration.attrs.push_back(Attribute(name, Value(strings.front())));
+  } else {
+    std::vector<Value> elems;
+    elems.reserve(npts);
+    for( auto & str : strings ) elems.push_back(Value(std::move(str)));
+    iteration.attrs.push_back(Attribute(name, arrayFromElements(std::move(elems))));
+  }
+  return 0;
+}
 }
 herr_t h5_attr_iterate( hid_t o_id, const char *name, const H5A_info_t *attrinfo, void *opdata) {
   /*
@@ -145,78 +295,44 @@ herr_t h5_attr_iterate( hid_t o_id, const char *name, const H5A_info_t *attrinfo
    * in hdf5, attributes can be simply arrays. in this case,
    * we generate string keys with simply the integer as string
    */
-  std::vector<Attribute>* attrs = (std::vector<Attribute>*)opdata;
-  herr_t res = 0;
+  AttributeIteration & iteration = *static_cast<AttributeIteration *>(opdata);
+  iteration.operations++;
   hid_t attr_id = H5Aopen(o_id, name, H5P_DEFAULT);
+  if( attr_id < 0 ) return -3;
+  iteration.operations += 3; // type, space and close
   hid_t dtype = H5Aget_type(attr_id);
-  hid_t dspace = H5Aget_space(attr_id); //NEED TO CLOSE!
+  hid_t dspace = H5Aget_space(attr_id);
   int rank = H5Sget_simple_extent_ndims(dspace);
-  int npts = H5Sget_simple_extent_npoints(dspace);
-  res = H5Sclose(dspace);
-  if( rank > 1 ) return -1; // no multidimensional arrays implemented...
-  if( res < 0 ) { H5Tclose(dtype); H5Aclose(attr_id); return res; }
-  H5T_class_t typeclass = H5Tget_class(dtype);
-  std::stringstream sstr;
-  if( typeclass == H5T_INTEGER ) {
-    int* intbuf = new int[npts];
-    res |= H5Aread(attr_id, dtype, intbuf);
-    if( res != 0 ) { 
-      delete[] intbuf;
-      H5Tclose(dtype);
-      H5Aclose(attr_id);
-      return res; }
-    else {
-      std::map<std::string, Value> arr;
-      for( auto i = 0; i < npts; i++) {
-        sstr.clear(); sstr.str("");
-        sstr << i;
-        arr.insert({sstr.str(), (double)intbuf[i]});
-      }
-      if( npts == 1 ) attrs->push_back(Attribute(name, arr.at("0")));
-      else            attrs->push_back(Attribute(name, Value(arr)));
-      delete[] intbuf;
-    }
-  } else if ( typeclass == H5T_FLOAT ) {
-    double* floatbuf = new double[npts];
-    res |= H5Aread(attr_id, dtype, floatbuf);
-    if( res != 0 ) { 
-      delete[] floatbuf;
-      H5Tclose(dtype);
-      H5Aclose(attr_id);
-      return res; }
-    else {
-      std::map<std::string, Value> arr;
-      for( auto i = 0; i < npts; i++) {
-        sstr.clear(); sstr.str("");
-        sstr << i;
-        arr.insert({sstr.str(), floatbuf[i]});
-      }
-      if( npts == 1 ) attrs->push_back(Attribute(name, arr.at("0")));
-      else            attrs->push_back(Attribute(name, Value(arr)));
-      delete[] floatbuf;
-    }
-  } else if ( typeclass == H5T_STRING ) {
-    if( rank == 1 ) return -4; //no string array implemented.
-    auto size = H5Tget_size(dtype);
-    char* buf = new char[size];
-    res = H5Aread(attr_id, dtype, buf);
-    if( res != 0 ) { 
-      delete[] buf;
-      H5Tclose(dtype);
-      H5Aclose(attr_id);
-      return res; }
-    else {
-      attrs->push_back(Attribute(name, std::string(buf)));
-      delete[] buf;
+  hssize_t npts = H5Sget_simple_extent_npoints(dspace);
+  H5Sclose(dspace);
+  herr_t res = 0;
+  if( rank > 1 ) res = -1; // no multidimensional arrays implemented...
+  else if( npts > 0 ) { // attributes with empty (null) dataspace are skipped
+    // the type is only dispatched once, the attribute is constructed
+    // directly from the buffer:
+    switch( H5Tget_class(dtype) ) {
+      case H5T_INTEGER: res = decodeInteger(attr_id, dtype, npts, name, iteration); break;
+      case H5T_FLOAT:   res = decodeFloat(attr_id, dtype, npts, name, iteration); break;
+      case H5T_ENUM:    res = decodeBoolEnum(attr_id, dtype, npts, name, iteration); break;
+      case H5T_STRING:  res = decodeString(attr_id, dtype, npts, name, iteration); break;
+      default:          res = -2;
     }
-  } else {
-    H5Tclose(dtype);
-    H5Aclose(attr_id);
-    return -2;
   }
-  res = H5Tclose(dtype);
-  res &= H5Aclose(attr_id);
-  return 0;
+  H5Tclose(dtype);
+  H5Aclose(attr_id);
+  return res;
+}
+void TraversalState::push(DatasetSpec && group) {
+  stack.push_back(std::move(group));
+  pending.push_back(Index());
+}
+void TraversalState::pop() {
+  // the group is complete, so is its table:
+  Index datasets = expandIndex(pending.back(), tables);
+  tables.erase(getFullpath(stack));
+  stack.pop_back();
+  pending.pop_back();
+  if( sink and not datasets.empty() ) sink(std::move(datasets));
 }
 DatasetSpec processvector( Index const & idxstack ) {
   //copy all attributes along the hierarchical way from the root node to the
@@ -232,58 +348,128 @@ DatasetSpec processvector( Index const & idxstack ) {
   thisspec.file        = idxstack.back().file;
   return thisspec;
 }
-herr_t h5_link_iterate( hid_t thislink, const char *name, const H5L_info_t *info, void *opdata) {
-  //make the data easier accessible:
-  std::tuple<Index,Index,std::map<std::string, Value>>* data = (std::tuple<Index,Index,std::map<std::string, Value>>*) opdata;
-  Index & stackidx = std::get<0>(*data);
-  Index & dsetidx = std::get<1>(*data);
-  std::map<std::string, Value> & tables = std::get<2>(*data);
+namespace {
+bool hasTableClass(std::vector<Attribute> const & attrs) {
+  // hdf5 tables are marked by the attribute CLASS = "TABLE":
+  for( auto const & attr : attrs )
+    if( attr.getName() == "CLASS" and attr.getType() == Type::STRING 
+        and attr.getValue().getString() == "TABLE" ) return true;
+  return false;
+}
+std::string baseName(const char* path) {
+  std::string str(path);
+  auto pos = str.rfind('/');
+  return pos == std::string::npos ? str : str.substr(pos + 1);
+}
+std::size_t depthOf(const char* path) {
+  // number of path components ("a/b/c": 3)
+  std::size_t depth = 1;
+  for( const char* c = path; *c != '\0'; ++c )
+    if( *c == '/' ) depth++;
+  return depth;
+}
+std::string traversalError(herr_t code) {
+  //turning some c into c++ errors:
+  if( code == -1 ) return "no multidimensional array implemented.";
+  else if( code == -2 ) return "unimplemented datatype.";
+  else if( code == -3 ) return "cannot open object.";
+  else if( code == -4 ) return "no string array implemented.";
+  return "other unknown error during traversal of the file.";
+}
+// unsupported objects fail the traversal, unless they are skipped. the
+// reason defaults to the description of the code:
+herr_t skipOrFail(TraversalState & state, const char *name, bool isGroup, herr_t code, 
+    std::string const & reason = "") {
+  if( state.options == nullptr or not state.options->skipUnsupported or code == -3 ) 
+    return state.fail(code);
+  state.stats.skipped++;
+  state.exception = nullptr; // the reason to skip, if any
+  if( isGroup ) state.skippedGroup = std::string(name) + "/";
+  try {
+    if( state.options->onSkip ) 
+      state.options->onSkip("/" + std::string(name), reason.empty() ? traversalError(code) : reason);
+  } catch (...) {
+    state.exception = std::current_exception();
+    return state.fail(-5);
+  }
+  return 0;
+}
+}
+herr_t h5_object_visit( hid_t root, const char *name, const H5O_info_t *info, void *opdata) {
+  TraversalState & state = *static_cast<TraversalState *>(opdata);
+  // the root object itself. its attributes are not inherited.
+  if( name[0] == '.' and name[1] == '\0' ) return 0;
+  state.stats.objects++;
+  state.stats.metadataOperations++; // the object info passed by the visit
+  if( not state.skippedGroup.empty() ) {
+    if( std::strncmp(name, state.skippedGroup.c_str(), state.skippedGroup.size()) == 0 ) return 0;
+    state.skippedGroup.clear();
+  }
   //
-  //get all attributes of the current link:
-  std::vector<Attribute> attrdata;
-  hid_t obj_open_id = H5Oopen(thislink, name, H5P_DEFAULT);
-  if( obj_open_id <= 0 ) return -3; //cannot open object
-  herr_t res = H5Aiterate(obj_open_id, H5_INDEX_NAME, H5_ITER_NATIVE, 
-                           NULL, h5_attr_iterate, &attrdata);
-  if( res < 0 ) return res;
-  res = H5Oclose(obj_open_id);
-  if( res < 0 ) return res;
+  // the objects are visited depth first: leave every group on the stack that
+  // is not a parent of this object (the root stays, it is element 0):
+  const std::size_t depth = depthOf(name);
+  try {
+    while( state.stack.size() > depth ) state.pop();
+  } catch (...) {
+    // don't throw through the library:
+    state.exception = std::current_exception();
+    return state.fail(-5);
+  }
+  assert(not state.stack.empty());
   //
-  //save name and attributes on the stack index:
-  assert(not stackidx.empty());
-
-  stackidx.push_back(DatasetSpec(attrdata, std::string(name), stackidx.back().file, DatasetChunkSpec(0)));
-
-  //find out the type of the object:
-  H5O_info_t objinfo;
-  res = H5Oget_info_by_name(thislink, name, &objinfo, H5P_DEFAULT);
-  if( res < 0 ) return res;
-  if( objinfo.type == H5O_TYPE_GROUP ){
-    //if it is a group: further recursion into subgroup:
-    hid_t groupId = H5Gopen(thislink, name, H5P_DEFAULT);
-    res = H5Literate(groupId, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, h5_link_iterate, opdata);
-    H5Gclose(groupId);
-    if( res < 0 ) return res;
-    stackidx.pop_back();
-  }
-  else if( objinfo.type == H5O_TYPE_DATASET ) {
-    // if it is a dataset: end of recursion: 
-    // work back through the vector... and store in index:
-    // IF it isn't a table:
-    if( isTable( thislink, name ) ) {
-      //read and store table... 
-      stackidx.pop_back();
-      tables.insert({ getFullpath(stackidx), readTable(thislink, name)});
+  //get all attributes of the object, but only open it if it has any:
+  AttributeIteration iteration;
+  std::vector<Attribute> & attrdata = iteration.attrs;
+  if( info->num_attrs > 0 ) {
+    state.stats.metadataOperations++;
+    hid_t obj_open_id = H5Oopen(root, name, H5P_DEFAULT);
+    if( obj_open_id < 0 ) return state.fail(-3); //cannot open object
+    herr_t res = H5Aiterate(obj_open_id, H5_INDEX_NAME, H5_ITER_NATIVE, 
+                             NULL, h5_attr_iterate, &iteration);
+    H5Oclose(obj_open_id);
+    state.stats.metadataOperations += 2 + iteration.operations; // iterate and close
+    state.stats.attributes += attrdata.size();
+    if( res < 0 ) return skipOrFail(state, name, info->type == H5O_TYPE_GROUP, res);
+  }
+  if( info->type == H5O_TYPE_GROUP ) {
+    // stays on the stack until all children have been visited:
+    state.stats.groups++;
+    state.push(DatasetSpec(attrdata, baseName(name), state.stack.back().file, DatasetChunkSpec(0)));
+  } else if( info->type == H5O_TYPE_DATASET ) {
+    if( hasTableClass(attrdata) ) {
+      // the table describes the other datasets in the same group:
+      state.stats.tables++;
+      try {
+        state.tables.insert({ getFullpath(state.stack), readTable(root, name, &state.stats.metadataOperations)});
+      } catch (std::exception const & exc) {
+        // don't throw through the library, unsupported tables are skipped:
+        state.exception = std::current_exception();
+        return skipOrFail(state, name, false, -5, exc.what());
+      } catch (...) {
+        state.exception = std::current_exception();
+        return state.fail(-5);
+      }
     } else {
-      dsetidx.push_back(processvector(stackidx));
-      stackidx.pop_back();
+      state.stats.datasets++;
+      state.stack.push_back(DatasetSpec(attrdata, baseName(name), state.stack.back().file, DatasetChunkSpec(0)));
+      DatasetSpec dset = processvector(state.stack);
+      state.stack.pop_back();
+      state.pending.back().push_back(std::move(dset));
     }
   }
-  else return -2; //unimplemented datatype
+  else return skipOrFail(state, name, false, -2); //unimplemented datatype
   return 0;
 }
-Index indexHdf5File(std::string filename) {
-  //checks:
+namespace {
+// turns the result of a traversal into exceptions:
+void checkTraversal(herr_t visitres, TraversalState const & state) {
+  if( state.error < 0 ) visitres = state.error;
+  if( state.exception ) std::rethrow_exception(state.exception);
+  if( visitres < 0 ) throw std::runtime_error(traversalError(visitres));
+}
+}
+void checkHdf5File(std::string const & filename) {
   if( not H5DataHelpers::h5_file_exists(filename) ) {
     std::stringstream sstr;
     sstr << "File \"" << filename << "\" does not exist.";
@@ -294,30 +480,546 @@ Index indexHdf5File(std::string filename) {
     sstr << "File \"" << filename << "\" is not a hdf5 file.";
     throw std::runtime_error(sstr.str());
   }
+}
+namespace {
+herr_t collectLinkName(hid_t, const char *name, const H5L_info_t *, void *opdata) {
+  static_cast<std::vector<std::string> *>(opdata)->push_back(name);
+  return 0;
+}
+herr_t getObjectInfo(hid_t loc, const char *name, H5O_info_t *info) {
+#if H5_VERSION_GE(1,10,3)
+  return H5Oget_info_by_name2(loc, name, info, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS, H5P_DEFAULT);
+#else
+  return H5Oget_info_by_name(loc, name, info, H5P_DEFAULT);
+#endif
+}
+// visit of the subtree of a top-level group, with the names relative to the
+// root of the file:
+struct SubtreeVisit {
+  hid_t root;
+  std::string prefix;
+  std::string name;
+  TraversalState * state;
+};
+herr_t h5_subtree_visit( hid_t, const char *name, const H5O_info_t *info, void *opdata) {
+  SubtreeVisit & visit = *static_cast<SubtreeVisit *>(opdata);
+  if( name[0] == '.' and name[1] == '\0' ) return 0; // the group itself
+  visit.name.assign(visit.prefix).append(name);
+  return h5_object_visit(visit.root, visit.name.c_str(), info, visit.state);
+}
+// receives the datasets of the object with the given link index, in parts:
+typedef std::function<void(std::size_t, Index &&)> TopLevelSink;
+/*
+ * indexes the objects directly below the root with the given link indices,
+ * each with everything below it, and passes their datasets to the sink as in
+ * indexHdf5File. the datasets directly below the root are passed last, with
+ * the index names.size().
+ */
+void indexTopLevelObjects(hid_t file_id, File const & file, std::vector<std::string> const & names,
+    std::vector<std::size_t> const & indices, TopLevelSink const & sink, TraversalStats & stats,
+    TraversalOptions const & options) {
+  TraversalState state;
+  state.options = &options;
+  std::size_t current = names.size();
+  state.sink = [&sink, &current](Index && part) { sink(current, std::move(part)); };
+  state.push(DatasetSpec({}, "", file, DatasetChunkSpec(0)));
+  H5E_auto2_t errfunc; void *errdata;
+  H5Eget_auto2(H5E_DEFAULT, &errfunc, &errdata);
+  H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+  herr_t visitres = 0;
+  for( auto idx : indices ) {
+    current = idx;
+    H5O_info_t info;
+    visitres = getObjectInfo(file_id, names[idx].c_str(), &info);
+    if( visitres < 0 ) { visitres = -3; break; }
+    visitres = h5_object_visit(file_id, names[idx].c_str(), &info, &state);
+    if( visitres < 0 ) break;
+    if( info.type == H5O_TYPE_GROUP ) {
+      hid_t group_id = H5Gopen2(file_id, names[idx].c_str(), H5P_DEFAULT);
+      if( group_id < 0 ) { visitres = -3; break; }
+      SubtreeVisit visit{file_id, names[idx] + "/", "", &state};
+#if H5_VERSION_GE(1,10,3)
+      visitres = H5Ovisit2(group_id, H5_INDEX_NAME, H5_ITER_NATIVE, h5_subtree_visit, 
+                           &visit, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS);
+#else
+      visitres = H5Ovisit(group_id, H5_INDEX_NAME, H5_ITER_NATIVE, h5_subtree_visit, &visit);
+#endif
+      H5Gclose(group_id);
+      if( visitres < 0 ) break;
+    }
+    // the object is complete:
+    try {
+      while( state.stack.size() > 1 ) state.pop();
+      if( info.type == H5O_TYPE_GROUP and options.onGroupDone ) options.onGroupDone(names[idx]);
+    } catch (...) {
+      state.exception = std::current_exception();
+      break;
+    }
+  }
+  H5Eset_auto2(H5E_DEFAULT, errfunc, errdata);
+  stats = state.stats;
+  checkTraversal(visitres, state);
+  current = names.size();
+  state.pop();
+}
+void addStats(TraversalStats & sum, TraversalStats const & other) {
+  sum.objects += other.objects;
+  sum.groups += other.groups;
+  sum.datasets += other.datasets;
+  sum.tables += other.tables;
+  sum.attributes += other.attributes;
+  sum.metadataOperations += other.metadataOperations;
+  sum.skipped += other.skipped;
+}
+}
+void indexHdf5File(std::string filename, DatasetSink const & sink, TraversalStats * stats,
+    H5DataHelpers::FileAccessProfile const & profile, TraversalOptions const & options) {
+  checkHdf5File(filename);
   int mtime = H5DataHelpers::getFileModificationTime(filename);
 
   //open file:
-  hid_t file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t file_id = H5DataHelpers::openFile(filename, profile);
   if( file_id < 0 ) throw std::runtime_error("could not open file.");
 
-  //iterate over the file, filling two index objects, the first is the
-  // current stack, i.e. all elements that lead from the top (root) node to the
-  // current one.
-  // the second is the collection of all datasets that will be gathered into the
-  // database.
-  std::tuple<Index,Index,std::map<std::string,Value>> data;
-  std::get<0>(data).push_back(DatasetSpec({}, "", File(filename, mtime), DatasetChunkSpec(0)));
-  herr_t visitres = H5Literate(file_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, h5_link_iterate, &data);
+  if( not options.skipTopLevel.empty() or options.onGroupDone ) {
+    // one object below the root after the other:
+    std::vector<std::string> names;
+    std::vector<std::size_t> indices;
+    TraversalStats sum;
+    try {
+      if( H5Literate(file_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, collectLinkName, &names) < 0 )
+        throw std::runtime_error("cannot list the objects below the root.");
+      for( std::size_t i = 0; i < names.size(); ++i )
+        if( options.skipTopLevel.count(names[i]) == 0 ) indices.push_back(i);
+      indexTopLevelObjects(file_id, File(filename, mtime), names, indices, 
+          [&sink](std::size_t, Index && part) { sink(std::move(part)); }, sum, options);
+    } catch (...) {
+      H5Fclose(file_id);
+      if( stats != nullptr ) *stats = sum;
+      throw;
+    }
+    H5Fclose(file_id);
+    if( stats != nullptr ) *stats = sum;
+    return;
+  }
+
+  //visit every object of the file exactly once. the stack holds all elements
+  // that lead from the top (root) node to the current one, the datasets of
+  // each group go to the sink when the group is left.
+  TraversalState state;
+  state.sink = sink;
+  state.options = &options;
+  state.push(DatasetSpec({}, "", File(filename, mtime), DatasetChunkSpec(0)));
+  // errors are reported by the exceptions below, the error stack of the
+  // aborted iteration would only be noise:
+  H5E_auto2_t errfunc; void *errdata;
+  H5Eget_auto2(H5E_DEFAULT, &errfunc, &errdata);
+  H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+#if H5_VERSION_GE(1,10,3)
+  herr_t visitres = H5Ovisit2(file_id, H5_INDEX_NAME, H5_ITER_NATIVE, h5_object_visit, 
+                              &state, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS);
+#else
+  herr_t visitres = H5Ovisit(file_id, H5_INDEX_NAME, H5_ITER_NATIVE, h5_object_visit, &state);
+#endif
+  H5Eset_auto2(H5E_DEFAULT, errfunc, errdata);
   H5Fclose(file_id);
+  if( stats != nullptr ) *stats = state.stats;
+  checkTraversal(visitres, state);
 
-  //turning some c into c++ errors:
-  if( visitres == -1 ) throw std::runtime_error("no multidimensional array implemented.");
-  else if( visitres == -2 ) throw std::runtime_error("unimplemented datatype.");
-  else if( visitres == -3 ) throw std::runtime_error("cannot open object.");
-  else if( visitres == -4 ) throw std::runtime_error("no string array implemented.");
-  else if( visitres < 0 )throw std::runtime_error("other unknown error during"
-                                                  "traversal of the file.");
-  //returning only the datasets and not the stack (which should be empty anyway)
-  return expandIndex(std::get<1>(data), std::get<2>(data));
+  // the groups of the last visited object and the root are complete:
+  while( not state.stack.empty() ) state.pop();
+}
+Index indexHdf5File(std::string filename, TraversalStats * stats,
+    H5DataHelpers::FileAccessProfile const & profile, TraversalOptions const & options) {
+  Index res;
+  indexHdf5File(filename, [&res](Index && part) {
+      res.insert(res.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }, stats, profile, options);
+  return res;
+}
+namespace {
+/*
+ * the results of a worker are sent to the parent through a pipe as records
+ * of (uint32 length, char tag, payload), all in native byte order:
+ *   'D': link index, datasetname, row, attributes (name and value each)
+ *   'S': traversal stats
+ *   'K': path of a skipped object and the reason
+ *   'G': name of a group below the root whose datasets have all been sent
+ *   'E': error message
+ * values are exact (doubles are sent as their bytes), strings are prefixed by
+ * their length. the attributes keep their order and duplicates.
+ */
+template <typename T>
+void put(std::string & out, T const & val) {
+  out.append(reinterpret_cast<char const *>(&val), sizeof(T));
+}
+void putString(std::string & out, std::string const & str) {
+  put(out, (std::uint32_t)str.size());
+  out.append(str);
+}
+void putValue(std::string & out, Value const & val) {
+  switch( val.getType() ) {
+    case Type::NUMERIC: out.push_back('n'); put(out, val.getNumeric()); break;
+    case Type::BOOLEAN: out.push_back(val.getBool() ? 't' : 'f'); break;
+    case Type::STRING:  out.push_back('s'); putString(out, val.getString()); break;
+    case Type::ARRAY: {
+      out.push_back('a');
+      auto const & map = val.getMap();
+      put(out, (std::uint32_t)map.size());
+      for( auto const & elem : map ) {
+        putString(out, elem.first);
+        putValue(out, elem.second);
+      }
+      break;
+    }
+    default: throw std::runtime_error("cannot send value of unknown type.");
+  }
+}
+std::size_t beginRecord(std::string & out, char tag) {
+  const std::size_t start = out.size();
+  put(out, (std::uint32_t)0);
+  out.push_back(tag);
+  return start;
+}
+void endRecord(std::string & out, std::size_t start) {
+  const std::uint32_t length = out.size() - start - sizeof(std::uint32_t);
+  std::memcpy(&out[start], &length, sizeof(length));
+}
+class RecordReader {
+  public:
+  RecordReader(char const * begin, char const * end) : pos(begin), last(end) {}
+  template <typename T>
+  T get() {
+    check(sizeof(T));
+    T val;
+    std::memcpy(&val, pos, sizeof(T));
+    pos += sizeof(T);
+    return val;
+  }
+  std::string getString() {
+    const std::uint32_t size = get<std::uint32_t>();
+    check(size);
+    std::string res(pos, size);
+    pos += size;
+    return res;
+  }
+  Value getValue() {
+    switch( get<char>() ) {
+      case 'n': return Value(get<double>());
+      case 't': return Value(true);
+      case 'f': return Value(false);
+      case 's': return Value(getString());
+      case 'a': {
+        const std::uint32_t size = get<std::uint32_t>();
+        std::map<std::string, Value> map;
+        for( std::uint32_t i = 0; i < size; ++i ) {
+          std::string key = getString();
+          map.emplace_hint(map.end(), std::move(key), getValue());
+        }
+        return Value(std::move(map));
+      }
+      default: throw std::runtime_error("invalid value in worker output.");
+    }
+  }
+  private:
+  void check(std::size_t size) const {
+    if( (std::size_t)(last - pos) < size ) throw std::runtime_error("truncated worker output.");
+  }
+  char const * pos;
+  char const * last;
+};
+void writeAll(int fd, std::string const & str) {
+  std::size_t written = 0;
+  while( written < str.size() ) {
+    ssize_t res = write(fd, str.data() + written, str.size() - written);
+    if( res < 0 and errno == EINTR ) continue;
+    if( res < 0 ) return;
+    written += res;
+  }
+}
+void runWorker(int fd, std::string const & filename, File const & file, 
+    std::vector<std::string> const & names, std::vector<std::size_t> const & indices,
+    H5DataHelpers::FileAccessProfile const & profile, TraversalOptions const & options) {
+  std::string buf;
+  try {
+    hid_t file_id = H5DataHelpers::openFile(filename, profile);
+    if( file_id < 0 ) throw std::runtime_error("could not open file.");
+    // the datasets are sent as soon as their group is complete:
+    auto send = [&buf, fd](std::size_t idx, Index && part) {
+      for( auto const & dset : part ) {
+        auto start = beginRecord(buf, 'D');
+        put(buf, (std::uint64_t)idx);
+        putString(buf, dset.datasetname);
+        put(buf, (std::int32_t)dset.location.row);
+        put(buf, (std::uint32_t)dset.attributes.size());
+        for( auto const & attr : dset.attributes ) {
+          putString(buf, attr.getName());
+          putValue(buf, attr.getValue());
+        }
+        endRecord(buf, start);
+        if( buf.size() > (1 << 20) ) { writeAll(fd, buf); buf.clear(); }
+      }
+    };
+    TraversalOptions workerOptions;
+    workerOptions.skipUnsupported = options.skipUnsupported;
+    workerOptions.onSkip = [&buf](std::string const & path, std::string const & reason) {
+      auto start = beginRecord(buf, 'K');
+      putString(buf, path);
+      putString(buf, reason);
+      endRecord(buf, start);
+    };
+    if( options.onGroupDone ) {
+      workerOptions.onGroupDone = [&buf](std::string const & name) {
+        auto start = beginRecord(buf, 'G');
+        putString(buf, name);
+        endRecord(buf, start);
+      };
+    }
+    TraversalStats stats;
+    try {
+      indexTopLevelObjects(file_id, file, names, indices, send, stats, workerOptions);
+    } catch (...) {
+      H5Fclose(file_id);
+      throw;
+    }
+    H5Fclose(file_id);
+    auto start = beginRecord(buf, 'S');
+    for( auto n : {stats.objects, stats.groups, stats.datasets, stats.tables, stats.attributes, 
+                   stats.metadataOperations, stats.skipped} )
+      put(buf, (std::uint64_t)n);
+    endRecord(buf, start);
+    writeAll(fd, buf);
+  } catch (std::exception const & exc) {
+    buf.clear();
+    auto start = beginRecord(buf, 'E');
+    putString(buf, exc.what());
+    endRecord(buf, start);
+    writeAll(fd, buf);
+  }
+}
+// collects the output of one worker:
+struct WorkerOutput {
+  pid_t pid;
+  int fd;
+  std::string pending; // incomplete record
+  std::string error;
+  bool finished = false;
+  // the datasets received since they were last passed to the sink, all of
+  // the object with the link index current:
+  Index datasets;
+  std::size_t current = 0;
+};
+void passDatasets(WorkerOutput & worker, TopLevelSink const & sink) {
+  if( worker.datasets.empty() ) return;
+  Index part;
+  part.swap(worker.datasets);
+  sink(worker.current, std::move(part));
+}
+void processRecord(RecordReader & record, File const & file, TopLevelSink const & sink, 
+    TraversalStats & stats, WorkerOutput & worker, TraversalOptions const & options) {
+  const char tag = record.get<char>();
+  if( tag == 'E' ) {
+    worker.error = record.getString();
+  } else if( tag == 'K' ) {
+    std::string path = record.getString();
+    std::string reason = record.getString();
+    if( options.onSkip ) options.onSkip(path, reason);
+  } else if( tag == 'G' ) {
+    std::string name = record.getString();
+    passDatasets(worker, sink);
+    if( options.onGroupDone ) options.onGroupDone(name);
+  } else if( tag == 'S' ) {
+    TraversalStats other;
+    other.objects = record.get<std::uint64_t>();
+    other.groups = record.get<std::uint64_t>();
+    other.datasets = record.get<std::uint64_t>();
+    other.tables = record.get<std::uint64_t>();
+    other.attributes = record.get<std::uint64_t>();
+    other.metadataOperations = record.get<std::uint64_t>();
+    other.skipped = record.get<std::uint64_t>();
+    addStats(stats, other);
+  } else if( tag == 'D' ) {
+    const std::size_t idx = record.get<std::uint64_t>();
+    std::string datasetname = record.getString();
+    const int row = record.get<std::int32_t>();
+    const std::uint32_t nattrs = record.get<std::uint32_t>();
+    std::vector<Attribute> attrs;
+    attrs.reserve(nattrs);
+    for( std::uint32_t i = 0; i < nattrs; ++i ) {
+      std::string name = record.getString();
+      attrs.push_back(Attribute(name, record.getValue()));
+    }
+    if( idx != worker.current ) passDatasets(worker, sink);
+    worker.current = idx;
+    worker.datasets.push_back(DatasetSpec(attrs, datasetname, file, DatasetChunkSpec(row)));
+  } else {
+    throw std::runtime_error("invalid record in worker output.");
+  }
+}
+/*
+ * the datasets of the workers are passed to the sink in the order in which
+ * they arrive, with the link index of their object below the root.
+ */
+void indexParallel(std::string const & filename, std::size_t nworkers, TopLevelSink const & sink, 
+    TraversalStats * stats, H5DataHelpers::FileAccessProfile const & profile, 
+    TraversalOptions const & options) {
+  checkHdf5File(filename);
+  const File file(filename, H5DataHelpers::getFileModificationTime(filename));
+
+  // the objects below the root, in the order of the traversal:
+  std::vector<std::string> names;
+  std::vector<std::size_t> groups, others;
+  {
+    hid_t file_id = H5DataHelpers::openFile(filename, profile);
+    if( file_id < 0 ) throw std::runtime_error("could not open file.");
+    herr_t res = H5Literate(file_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, collectLinkName, &names);
+    for( std::size_t i = 0; res >= 0 and i < names.size(); ++i ) {
+      H5O_info_t info;
+      res = getObjectInfo(file_id, names[i].c_str(), &info);
+      if( res < 0 ) break;
+      if( options.skipTopLevel.count(names[i]) > 0 ) continue;
+      if( info.type == H5O_TYPE_GROUP ) groups.push_back(i);
+      else others.push_back(i);
+    }
+    // no hdf5 handles may be open while forking:
+    H5Fclose(file_id);
+    if( res < 0 ) throw std::runtime_error("cannot list the objects below the root.");
+  }
+  if( nworkers > groups.size() ) nworkers = groups.size();
+  if( nworkers < 2 ) {
+    indexHdf5File(filename, [&sink](Index && part) { sink(0, std::move(part)); }, stats, profile, options);
+    return;
+  }
+
+  // the top-level groups are distributed round robin to the workers:
+  std::vector<WorkerOutput> workers;
+  std::string error;
+  std::cout << std::flush; std::cerr << std::flush;
+  for( std::size_t w = 0; w < nworkers; ++w ) {
+    std::vector<std::size_t> indices;
+    for( std::size_t i = w; i < groups.size(); i += nworkers )
+      indices.push_back(groups[i]);
+    int fds[2];
+    if( pipe(fds) != 0 ) { error = "cannot create pipe for worker."; break; }
+    pid_t pid = fork();
+    if( pid < 0 ) {
+      close(fds[0]); close(fds[1]);
+      error = "cannot start worker process.";
+      break;
+    }
+    if( pid == 0 ) {
+      close(fds[0]);
+      for( auto const & worker : workers ) close(worker.fd);
+      runWorker(fds[1], filename, file, names, indices, profile, options);
+      close(fds[1]);
+      _exit(0);
+    }
+    close(fds[1]);
+    workers.push_back(WorkerOutput());
+    workers.back().pid = pid;
+    workers.back().fd = fds[0];
+  }
+
+  // the objects directly below the root that are no groups are indexed here,
+  // while the workers traverse the groups:
+  TraversalStats sum;
+  try {
+    if( not error.empty() ) throw std::runtime_error(error);
+    hid_t file_id = H5DataHelpers::openFile(filename, profile);
+    if( file_id < 0 ) throw std::runtime_error("could not open file.");
+    try {
+      indexTopLevelObjects(file_id, file, names, others, sink, sum, options);
+    } catch (...) {
+      H5Fclose(file_id);
+      throw;
+    }
+    H5Fclose(file_id);
+  } catch (std::exception const & exc) {
+    error = exc.what();
+  }
+  // their results are not needed anymore, the pipes are still drained:
+  if( not error.empty() )
+    for( auto const & worker : workers ) kill(worker.pid, SIGKILL);
+
+  // read all pipes concurrently, such that no worker blocks on a full pipe:
+  std::vector<char> buf(1 << 16);
+  std::size_t nrunning = workers.size();
+  try {
+    while( nrunning > 0 ) {
+      std::vector<pollfd> pfds;
+      std::vector<WorkerOutput *> polled;
+      for( auto & worker : workers ) {
+        if( worker.finished ) continue;
+        pfds.push_back(pollfd{worker.fd, POLLIN, 0});
+        polled.push_back(&worker);
+      }
+      if( poll(pfds.data(), pfds.size(), -1) < 0 ) {
+        if( errno == EINTR ) continue;
+        throw std::runtime_error("cannot read from workers.");
+      }
+      for( std::size_t i = 0; i < pfds.size(); ++i ) {
+        if( pfds[i].revents == 0 ) continue;
+        WorkerOutput & worker = *polled[i];
+        ssize_t n = read(worker.fd, buf.data(), buf.size());
+        if( n < 0 and errno == EINTR ) continue;
+        if( n <= 0 ) {
+          worker.finished = true;
+          nrunning--;
+          continue;
+        }
+        worker.pending.append(buf.data(), n);
+        // all complete records:
+        std::size_t pos = 0;
+        std::uint32_t length;
+        while( worker.pending.size() - pos >= sizeof(length) ) {
+          std::memcpy(&length, worker.pending.data() + pos, sizeof(length));
+          if( worker.pending.size() - pos - sizeof(length) < length ) break;
+          char const * begin = worker.pending.data() + pos + sizeof(length);
+          RecordReader record(begin, begin + length);
+          processRecord(record, file, sink, sum, worker, options);
+          pos += sizeof(length) + length;
+        }
+        worker.pending.erase(0, pos);
+        passDatasets(worker, sink);
+      }
+    }
+  } catch (std::exception const & exc) {
+    // the workers still running are stopped, all of them are reaped below:
+    if( error.empty() ) error = exc.what();
+    for( auto & worker : workers )
+      if( not worker.finished ) kill(worker.pid, SIGKILL);
+  }
+  for( auto & worker : workers ) {
+    close(worker.fd);
+    int status;
+    while( waitpid(worker.pid, &status, 0) < 0 and errno == EINTR ) {}
+    if( error.empty() and not worker.error.empty() ) error = worker.error;
+    if( error.empty() and not (WIFEXITED(status) and WEXITSTATUS(status) == 0) )
+      error = "worker process failed.";
+  }
+  if( stats != nullptr ) *stats = sum;
+  if( not error.empty() ) throw std::runtime_error(error);
+}
+}
+Index indexHdf5FileParallel(std::string filename, std::size_t nworkers, TraversalStats * stats,
+    H5DataHelpers::FileAccessProfile const & profile, TraversalOptions const & options) {
+  std::map<std::size_t, Index> results;
+  indexParallel(filename, nworkers, [&results](std::size_t idx, Index && part) {
+      Index & res = results[idx];
+      res.insert(res.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }, stats, profile, options);
+  // merged in the order of the objects below the root and the datasets
+  // directly below the root last, as in indexHdf5File:
+  Index res;
+  for( auto & result : results )
+    res.insert(res.end(), std::make_move_iterator(result.second.begin()), 
+                          std::make_move_iterator(result.second.end()));
+  return res;
+}
+void indexHdf5FileParallel(std::string filename, std::size_t nworkers, DatasetSink const & sink, 
+    TraversalStats * stats, H5DataHelpers::FileAccessProfile const & profile, 
+    TraversalOptions const & options) {
+  indexParallel(filename, nworkers, [&sink](std::size_t, Index && part) { sink(std::move(part)); }, 
+      stats, profile, options);
 }
 }
@@ -5,17 +5,102 @@
 #ifndef __INDEX_HDF5_H__
 #define __INDEX_HDF5_H__
 #include "attributes.h"
+#include "h5helpers.h"
 #include <hdf5.h>
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
+#include <exception>
+#include <functional>
 
 namespace rqcd_file_index {
-Index indexHdf5File(std::string filename);
-Value readTable(hid_t link, const char* name);
-Value readArray( hid_t type, std::size_t idx, void const * buf, std::size_t const & size);
+// what the traversal of a file did, for diagnostics:
+struct TraversalStats {
+  std::size_t objects = 0;
+  std::size_t groups = 0;
+  std::size_t datasets = 0;
+  std::size_t tables = 0;
+  std::size_t attributes = 0;
+  // calls into the library that access objects, attributes and tables in the
+  // file (H5O, H5A and H5D), one for the info of each visited object:
+  std::size_t metadataOperations = 0;
+  // unsupported objects that were skipped (see TraversalOptions):
+  std::size_t skipped = 0;
+};
+struct TraversalOptions {
+  // objects with unsupported datatypes or attributes are skipped, with
+  // everything below them, instead of failing the traversal:
+  bool skipUnsupported = false;
+  // called with the path and the reason for every skipped object:
+  std::function<void(std::string const &, std::string const &)> onSkip;
+  // objects directly below the root that are not traversed:
+  std::set<std::string> skipTopLevel;
+  // called with the name of each group directly below the root as soon as
+  // all datasets below it have been passed to the sink:
+  std::function<void(std::string const &)> onGroupDone;
+};
+// receives the datasets of a traversal, in parts:
+typedef std::function<void(Index &&)> DatasetSink;
+struct TraversalState {
+  Index stack; // from the root to the current group
+  // the datasets directly below each group of the stack. they are passed to
+  // the sink, expanded by the table of their group, when the group is left:
+  std::vector<Index> pending;
+  std::map<std::string, Table> tables;
+  DatasetSink sink;
+  TraversalOptions const * options = nullptr;
+  std::string skippedGroup; // everything below is skipped
+  TraversalStats stats;
+  herr_t error = 0;
+  std::exception_ptr exception;
+  herr_t fail(herr_t code) { error = code; return code; }
+  void push(DatasetSpec && group);
+  void pop();
+};
+Index indexHdf5File(std::string filename, TraversalStats * stats = nullptr,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT,
+    TraversalOptions const & options = TraversalOptions());
+/*
+ * traverses the file and passes the datasets of each group to the sink as
+ * soon as the group has been visited completely, such that only the datasets
+ * of the groups on the current path are held in memory. the datasets directly
+ * below the root are passed last. indexHdf5File collects these parts.
+ * if objects below the root are skipped or their completion is reported, the
+ * objects below the root are traversed one after the other.
+ */
+void indexHdf5File(std::string filename, DatasetSink const & sink, TraversalStats * stats = nullptr,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT,
+    TraversalOptions const & options = TraversalOptions());
+/*
+ * same result as indexHdf5File, but the groups directly below the root are
+ * distributed to nworkers forked processes, each traversing its groups in
+ * its own handle of the file. objects that are linked from several of these
+ * groups are indexed once per group (indexHdf5File visits them only once).
+ * options.onGroupDone is called in this process, after all datasets of the
+ * group have been passed on.
+ */
+Index indexHdf5FileParallel(std::string filename, std::size_t nworkers, TraversalStats * stats = nullptr,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT,
+    TraversalOptions const & options = TraversalOptions());
+// passes the datasets to the sink as they are received from the workers,
+// not in the order of the traversal:
+void indexHdf5FileParallel(std::string filename, std::size_t nworkers, DatasetSink const & sink, 
+    TraversalStats * stats = nullptr,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT,
+    TraversalOptions const & options = TraversalOptions());
+// throws if the file does not exist or is not a hdf5 file:
+void checkHdf5File(std::string const & filename);
+// counts the calls into the library in operations, if given:
+Table readTable(hid_t link, const char* name, std::size_t * operations = nullptr);
 bool isTable( hid_t link, const char* name );
+// the attributes read by h5_attr_iterate (opdata), and its calls into the library:
+struct AttributeIteration {
+  std::vector<Attribute> attrs;
+  std::size_t operations = 0;
+};
 herr_t h5_attr_iterate( hid_t o_id, const char *name, const H5A_info_t *attrinfo, void *opdata);
 DatasetSpec processvector( Index const & idxstack );
-herr_t h5_link_iterate( hid_t thislink, const char *name, const H5L_info_t *info, void *opdata);
+herr_t h5_object_visit( hid_t root, const char *name, const H5O_info_t *info, void *opdata);
 } //rqcd_file_index
 #endif
@@ -4,6 +4,7 @@
  */
 #include <iostream>
 #include <complex>
+#include <sstream>
 #include "attributes.h"
 #include "indexHdf5.h"
 #include "sqliteHelpers.h"
@@ -11,17 +12,108 @@
 #include "postselection.h"
 #include "hdf5ReaderGeneric.h"
 #include "parseJson.h"
+#include "pipeline.h"
+#include "indexFormats.h"
 
 using namespace rqcd_file_index;
 
-Index getMatchingDatasetSpecs(sqlite3 *db, Request const & req) {
-  auto ids = sqlite_helpers::getLocIdsMatchingPreSelection(db, req);
-  Index idx = sqlite_helpers::idsToIndex(db, ids);
-  filterIndexByPostselectionRules(idx, req);
-  return idx;
+// options of the form --name or --name=value, valid for all subcommands:
+std::map<std::string, std::string> options;
+void extractOptions(int & argc, char** argv) {
+  // removes the options from argv, such that the subcommands only see the
+  // positional arguments:
+  int npositional = 0;
+  for( int i = 0; i < argc; ++i ) {
+    std::string arg(argv[i]);
+    if( i > 0 and arg.size() > 2 and arg.compare(0, 2, "--") == 0 ) {
+      auto pos = arg.find('=');
+      if( pos == std::string::npos ) options[arg.substr(2)] = "";
+      else options[arg.substr(2, pos - 2)] = arg.substr(pos + 1);
+    } else {
+      argv[npositional++] = argv[i];
+    }
+  }
+  argc = npositional;
+}
+bool hasOption(std::string const & name) {
+  return options.count(name) > 0;
+}
+// the value of --name=<n>, a positive number:
+std::size_t getCountOption(std::string const & name, std::size_t defaultvalue) {
+  if( not hasOption(name) ) return defaultvalue;
+  std::string const & value = options.at(name);
+  std::size_t count = 0;
+  for( char c : value ) {
+    if( c < '0' or c > '9' or count > 1000000 ) { count = 0; break; }
+    count = 10*count + (c - '0');
+  }
+  if( count == 0 ) 
+    throw std::runtime_error("usage: --" + name + "=<n> with a positive number n, not \"" + value + "\".");
+  return count;
+}
+// how hdf5 files are opened, selected with --profile=<name>:
+H5DataHelpers::FileAccessProfile getProfile() {
+  if( not hasOption("profile") ) return H5DataHelpers::FileAccessProfile::DEFAULT;
+  return H5DataHelpers::fileAccessProfileFromString(options.at("profile"));
+}
+// the datasets are written to the database while the file is traversed, in
+// --workers=<n> processes if given. an interrupted run is continued with
+// --resume (unless it is rolled back, then resumable is false). unsupported
+// objects are skipped with --skip-unsupported.
+void indexHdf5FileWithOptions(sqlite3 *db, std::string const & h5file, TraversalStats * stats = nullptr,
+    bool resumable = true) {
+  // taken before the traversal, such that changes during indexing are seen:
+  const File file(h5file);
+  const auto fingerprint = FileHelpers::getFingerprint(h5file);
+  TraversalOptions traversal;
+  traversal.skipUnsupported = hasOption("skip-unsupported");
+  traversal.onSkip = [](std::string const & path, std::string const & reason) {
+    std::cerr << "skipped \"" << path << "\": " << reason << std::endl;
+  };
+  try {
+    indexPipelined(db, h5file, stats, getProfile(), traversal, hasOption("resume"), 
+        getCountOption("workers", 1));
+  } catch (std::exception const & exc) {
+    if( not resumable ) throw;
+    std::stringstream sstr;
+    sstr << exc.what() << "\nthe groups indexed so far are kept, continue with --resume.";
+    throw std::runtime_error(sstr.str());
+  }
+  sqlite_helpers::updateFileInfo(db, file, fingerprint);
+}
+
+// threads for reading directories and stat'ing files, --threads=<n>:
+std::size_t getThreads() {
+  return getCountOption("threads", 8);
+}
+// files that no longer exist need an update, too (they are removed). the
+// modification time may also move backwards (e.g. after a restore or rsync
+// -t), any change of it or of the size is checked (see contentsChanged):
+bool fileNeedsUpdate(sqlite3 *db, File const & file, FileHelpers::FileStat const & stat) {
+  if( not stat.exists or file.mtime != stat.mtime ) return true;
+  FileHelpers::Fingerprint stored;
+  return sqlite_helpers::getFingerprint(db, file.filename, stored) and stored.size != stat.size;
 }
-bool fileNeedsUpdate(File const & file) {
-  return file.mtime < FileHelpers::getFileModificationTime(file.filename);
+// the names of the files, for FileHelpers::statFiles:
+std::vector<std::string> filenames(std::vector<File> const & files) {
+  std::vector<std::string> names;
+  for( auto const & file : files ) names.push_back(file.filename);
+  return names;
+}
+// files whose indexing was interrupted:
+bool fileIsIncomplete(sqlite3 *db, File const & file) {
+  return sqlite_helpers::listIncompleteFiles(db).count(file.filename) > 0;
+}
+// a file that was only touched, copied or synced keeps its fingerprint. its
+// index stays valid, only the modification time is refreshed.
+bool contentsChanged(sqlite3 *db, File const & file) {
+  FileHelpers::Fingerprint stored;
+  if( not sqlite_helpers::getFingerprint(db, file.filename, stored) ) return true;
+  const File current(file.filename);
+  const auto fingerprint = FileHelpers::getFingerprint(file.filename);
+  if( not (fingerprint == stored) ) return true;
+  sqlite_helpers::updateFileInfo(db, current, fingerprint);
+  return false;
 }
 void version(int argc, char** argv) {
   std::cerr << "TODO: take version info from cmake" << std::endl;
@@ -31,16 +123,46 @@ void help(int argc, char** argv) {
   std::cout << "\n" <<
     "available subcommands:" << std::endl <<
     "  index <idxfile> <hdf5 file>   indexes hdf5 file" << std::endl <<
+    "      [--stats]                 reports the traversal statistics" << std::endl <<
+    "      [--workers=<n>]           traverses the top-level groups in n processes" << std::endl <<
+    "      [--resume]                continues an interrupted run, skipping the" << std::endl <<
+    "                                top-level groups that are complete" << std::endl <<
+    "      [--skip-unsupported]      skips objects with unsupported datatypes or" << std::endl <<
+    "                                attributes instead of failing" << std::endl <<
     "  update <idxfile> <hdf5 file>  updates hdf5 file in the index" << std::endl <<
     "  updateAll <idxfile>           updates all files in the index" << std::endl <<
+    "      [--threads=<n>]           stats the files in n threads (8)" << std::endl <<
+    "  sync <idxfile> <directory>    adds, updates and removes the files below" << std::endl <<
+    "                                the directory" << std::endl <<
+    "      [--glob=<pattern>]        only files matching the pattern (*.h5)" << std::endl <<
+    "      [--threads=<n>]           reads the directories in n threads (8)" << std::endl <<
+    "      [--batch-files=<n>]       adds the new files n per transaction (64)" << std::endl <<
     "  rm <idxfile> <hdf5 file>      removes hdf5 file from index" << std::endl <<
     "  files <idxfile>               lists file contained in index" << std::endl <<
+    "      [--threads=<n>]           stats the files in n threads (8)" << std::endl <<
     "  attributes <idxfile>          lists attributes in index" << std::endl <<
+    "  stats <idxfile> [<attrname>]  shows the number of locations and values of" << std::endl <<
+    "                                the attributes, or of each value of one" << std::endl <<
+    "  facets <idxfile> [<attrname>] shows the values of the attributes (or of" << std::endl <<
+    "                                one) with their number of locations and files" << std::endl <<
+    "      [--where=<query>]         only of the datasets matching the query" << std::endl <<
     "  get <idxfile> <query>         outputs all data matching the query" << std::endl <<
+    "      [--pipeline]              runs query, reading and output concurrently" << std::endl <<
     "  query <idxfile> <query>       shows all hits matching the query" << std::endl <<
     "                                (without reading from the hdf5 file)" << std::endl <<
+    "      [--format=<format>]       text, jsonl (one json dataset per line, as" << std::endl <<
+    "                                read by dsetSpecFromString) or binary" << std::endl <<
+    "  count <idxfile> <query>       outputs the number of hits matching the query" << std::endl <<
+    "  exists <idxfile> <query>      outputs (and exits with 0) if there is a hit" << std::endl <<
     "  help                          outputs this help" << std::endl <<
-    "  version                       outputs version information" << std::endl;
+    "  version                       outputs version information" << std::endl <<
+    "\n" <<
+    "options for all subcommands reading hdf5 files:" << std::endl <<
+    "  --profile=<name>              how files are opened: default, metadata" << std::endl <<
+    "                                (large metadata reads, e.g. on lustre)," << std::endl <<
+    "                                sieve (large sieve buffer), core (whole" << std::endl <<
+    "                                file in memory) or bigcache (large" << std::endl <<
+    "                                metadata cache)" << std::endl;
 }
 int listAttributes(int argc, char** argv) {
   if( argc != 3 ) {
@@ -68,6 +190,86 @@ int listAttributes(int argc, char** argv) {
   }
   return 0;
 }
+int listStatistics(int argc, char** argv) {
+  if( argc != 3 and argc != 4 ) {
+    std::cerr << "wrong number of args." << std::endl;
+    return 1;
+  }
+  const std::string sqlfile(argv[2]);
+  try {
+    if( not FileHelpers::file_exists(sqlfile) ) {
+      throw std::runtime_error("index file does not exist!");
+    }
+    sqlite3 *db;
+    sqlite3_open(sqlfile.c_str(), &db);
+    // indices without statistics get them now:
+    sqlite_helpers::prepareSqliteFile(db);
+    if( argc == 4 ) {
+      const std::string attrname(argv[3]);
+      auto frequencies = sqlite_helpers::getValueFrequencies(db, attrname);
+      sqlite3_close(db);
+      if( frequencies.empty() ) throw std::runtime_error("no values of attribute " + attrname + " in the index.");
+      for( auto const & freq : frequencies )
+        std::cout << "  - " << freq.first << ": " << freq.second << " locations" << std::endl;
+      return 0;
+    }
+    auto stats = sqlite_helpers::getAttributeStats(db);
+    sqlite3_close(db);
+    for( auto const & attr : stats ) {
+      std::cout << "  - " << attr.name << " (" << attr.type << "): " << attr.nlocations 
+        << " locations, " << attr.ndistinct << (attr.ndistinct == 1 ? " distinct value" : " distinct values");
+      if( attr.ndistinct > 1 ) std::cout << " from " << attr.min << " to " << attr.max;
+      else std::cout << " (" << attr.min << ")";
+      std::cout << std::endl;
+    }
+  } catch ( std::exception const & exc ) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+int listFacets(int argc, char** argv) {
+  if( argc != 3 and argc != 4 ) {
+    std::cerr << "wrong number of args." << std::endl;
+    return 1;
+  }
+  const std::string sqlfile(argv[2]);
+  const std::string attrname(argc == 4 ? argv[3] : "");
+  try {
+    if( not FileHelpers::file_exists(sqlfile) ) {
+      throw std::runtime_error("index file does not exist!");
+    }
+    sqlite3 *db;
+    sqlite3_open(sqlfile.c_str(), &db);
+    // indices without statistics get them now:
+    sqlite_helpers::prepareSqliteFile(db);
+    std::vector<sqlite_helpers::Facet> facets;
+    try {
+      if( hasOption("where") ) {
+        Request req = queryToRequest(options.at("where"));
+        sqlite_helpers::orderBySelectivity(db, req);
+        facets = sqlite_helpers::getFacets(db, attrname, req);
+      } else {
+        facets = sqlite_helpers::getFacets(db, attrname);
+      }
+    } catch (...) {
+      sqlite3_close(db);
+      throw;
+    }
+    sqlite3_close(db);
+    for( auto i = 0u; i < facets.size(); ++i ) {
+      auto const & facet = facets[i];
+      if( attrname.empty() and (i == 0 or facet.name != facets[i-1].name) ) 
+        std::cout << "  - " << facet.name << " (" << facet.type << "):" << std::endl;
+      std::cout << (attrname.empty() ? "    - " : "  - ") << facet.value << ": " << facet.nlocations 
+        << " locations in " << facet.nfiles << (facet.nfiles == 1 ? " file" : " files") << std::endl;
+    }
+  } catch ( std::exception const & exc ) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
 int listFiles(int argc, char** argv) {
   if( argc != 3 ) {
     std::cerr << "TODO give help for files." << std::endl;
@@ -82,19 +284,25 @@ int listFiles(int argc, char** argv) {
     sqlite3_open(sqlfile.c_str(), &db);
 
     auto files = sqlite_helpers::listFiles(db);
-
-    sqlite3_close(db);
-
-    for( auto const & file : files ) { 
-      if( not FileHelpers::file_exists(file.filename) ) {
+    auto incomplete = sqlite_helpers::listIncompleteFiles(db);
+
+    // the files are stat'ed concurrently, each is printed as soon as it and
+    // all before it are done:
+    FileHelpers::statFiles(filenames(files), getThreads(), 
+        [&](std::size_t i, FileHelpers::FileStat const & stat) {
+      File const & file = files[i];
+      if( not stat.exists ) {
         std::cout << "[abs] ";
-      } else if( fileNeedsUpdate(file) ) {
+      } else if( incomplete.count(file.filename) > 0 ) {
+        std::cout << "[inc] ";
+      } else if( fileNeedsUpdate(db, file, stat) ) {
         std::cout << "[upd] ";
       } else {
         std::cout << " [ok] ";
       }
       std::cout << file.filename << std::endl;
-    }
+    });
+    sqlite3_close(db);
   } catch ( std::exception const & exc ) {
     std::cerr << "ERROR " << exc.what() << std::endl;
     return 1;
@@ -125,6 +333,16 @@ int removeFile(int argc, char** argv) {
   }
   return 0;
 }
+void printTraversalStats(TraversalStats const & stats, std::ostream & os) {
+  os << "visited " << stats.objects << " objects (" << stats.groups << " groups, " 
+     << stats.datasets << " datasets, " << stats.tables << " tables) with " 
+     << stats.attributes << " attributes." << std::endl;
+  os << "metadata operations: " << stats.metadataOperations;
+  if( stats.objects > 0 )
+    os << " (" << (double)stats.metadataOperations / stats.objects << " per object)";
+  os << std::endl;
+  if( stats.skipped > 0 ) os << "skipped " << stats.skipped << " unsupported objects." << std::endl;
+}
 int indexFile(int argc, char** argv) {
   if( argc != 4 )
   {
@@ -142,11 +360,12 @@ int indexFile(int argc, char** argv) {
     sqlite3_exec(db, "PRAGMA synchronous = OFF", NULL, NULL, &zErrMsg);
     sqlite_helpers::prepareSqliteFile(db);
 
-    Index idx = indexHdf5File(h5file);
-
-    sqlite_helpers::insertDataset(db, idx);
+    TraversalStats stats;
+    indexHdf5FileWithOptions(db, h5file, &stats);
 
     sqlite3_close(db);
+
+    if( hasOption("stats") ) printTraversalStats(stats, std::cerr);
   } catch ( std::exception const & exc ) {
     std::cerr << "ERROR " << exc.what() << std::endl;
     return 1;
@@ -169,17 +388,23 @@ int updateAllFiles(int argc, char** argv) {
     char *zErrMsg = nullptr;
     sqlite3_open(sqlfile.c_str(), &db);
     sqlite3_exec(db, "PRAGMA synchronous = OFF", NULL, NULL, &zErrMsg);
+    sqlite_helpers::prepareSqliteFile(db);
 
     auto files = sqlite_helpers::listFiles(db);
+    auto incomplete = sqlite_helpers::listIncompleteFiles(db);
 
-    for( auto const & file : files ) {
-      if( fileNeedsUpdate( file ) )
+    // the files are updated while the next ones are stat'ed:
+    FileHelpers::statFiles(filenames(files), getThreads(), 
+        [&](std::size_t i, FileHelpers::FileStat const & stat) {
+      File const & file = files[i];
+      if( fileNeedsUpdate(db, file, stat) or incomplete.count(file.filename) > 0 )
       {
-        if( FileHelpers::file_exists(file.filename) ){
+        if( stat.exists and incomplete.count(file.filename) == 0 and not contentsChanged(db, file) ) {
+          std::cout << "file \"" << file.filename << "\" is unchanged, only its modification time is updated." << std::endl;
+        } else if( stat.exists ){
           std::cout << "updating file \"" << file.filename << "\"..." << std::endl;
           sqlite_helpers::removeFile(db, file.filename);
-          Index idx = indexHdf5File(file.filename);
-          sqlite_helpers::insertDataset(db, idx);
+          indexHdf5FileWithOptions(db, file.filename);
         } else {
           std::cout << "file \"" << file.filename << "\" no longer exists. removing." << std::endl;
           sqlite_helpers::removeFile(db, file.filename);
@@ -187,7 +412,7 @@ int updateAllFiles(int argc, char** argv) {
       } else {
         std::cout << "file \"" << file.filename << "\" is up to date." << std::endl;
       }
-    }
+    });
 
     sqlite3_close(db);
   } catch ( std::exception const & exc ) {
@@ -212,16 +437,22 @@ int updateFile(int argc, char** argv) {
     char *zErrMsg = nullptr;
     sqlite3_open(sqlfile.c_str(), &db);
     sqlite3_exec(db, "PRAGMA synchronous = OFF", NULL, NULL, &zErrMsg);
+    sqlite_helpers::prepareSqliteFile(db);
 
-    if( not fileNeedsUpdate( sqlite_helpers::getFile(db, h5file) ) )
+    File file = sqlite_helpers::getFile(db, h5file);
+    if( not fileNeedsUpdate(db, file, FileHelpers::statFile(h5file)) and not fileIsIncomplete(db, file) )
     {
       std::cerr << "ERROR File \"" << h5file << "\" doesn't need update.. To force an update first remove (rm) the file and then add it again." << std::endl;
       return 1;
     }
+    if( not fileIsIncomplete(db, file) and not contentsChanged(db, file) ) {
+      std::cout << "file \"" << h5file << "\" is unchanged, only its modification time is updated." << std::endl;
+      sqlite3_close(db);
+      return 0;
+    }
     sqlite_helpers::removeFile(db, h5file);
 
-    Index idx = indexHdf5File(h5file);
-    sqlite_helpers::insertDataset(db, idx);
+    indexHdf5FileWithOptions(db, h5file);
 
     sqlite3_close(db);
   } catch ( std::exception const & exc ) {
@@ -231,58 +462,322 @@ int updateFile(int argc, char** argv) {
   
   return 0;
 }
+int syncDirectory(int argc, char** argv) {
+  if( argc != 4 ) {
+    std::cerr << "usage: sync <idxfile> <directory> [--glob=<pattern>] [--threads=<n>] [--batch-files=<n>]" << std::endl;
+    return 1;
+  }
+  const std::string sqlfile(argv[2]);
+  // the files are compared by their canonical names, such that "data" and
+  // "./data" or a symbolic link to it are the same directory:
+  const std::string dir = FileHelpers::canonicalPath(std::string(argv[3]) + "/");
+  const std::string pattern = hasOption("glob") ? options.at("glob") : "*.h5";
+
+  bool failed = false;
+  try {
+    // named below the canonical directory, without following links to
+    // directories, so these names are canonical already:
+    auto found = FileHelpers::crawlDirectory(dir, pattern, getThreads());
+
+    sqlite3 *db;
+    char *zErrMsg = nullptr;
+    sqlite3_open(sqlfile.c_str(), &db);
+    sqlite3_exec(db, "PRAGMA synchronous = OFF", NULL, NULL, &zErrMsg);
+    sqlite_helpers::prepareSqliteFile(db);
+
+    // the indexed files below the directory by their canonical name; a file
+    // indexed twice under different names is removed with the second name:
+    const std::string prefix = dir == "/" ? dir : dir + "/";
+    std::map<std::string, File> indexed;
+    std::vector<std::string> added, updated, removed;
+    for( auto const & file : sqlite_helpers::listFiles(db) ) {
+      const std::string canonical = FileHelpers::canonicalPath(file.filename);
+      if( canonical.compare(0, prefix.size(), prefix) != 0 ) continue;
+      if( not indexed.insert({canonical, file}).second ) removed.push_back(file.filename);
+    }
+    auto incomplete = sqlite_helpers::listIncompleteFiles(db);
+
+    std::size_t unchanged = 0;
+    for( auto const & entry : found ) {
+      auto it = indexed.find(entry.filename);
+      if( it == indexed.end() ) {
+        added.push_back(entry.filename);
+        continue;
+      }
+      const File & file = it->second;
+      if( incomplete.count(file.filename) > 0 ) updated.push_back(file.filename);
+      else if( fileNeedsUpdate(db, file, entry) and contentsChanged(db, file) ) updated.push_back(file.filename);
+      else unchanged++;
+      indexed.erase(it);
+    }
+    for( auto const & file : indexed ) removed.push_back(file.second.filename);
+
+    // the files that are gone are removed in one transaction:
+    sqlite_helpers::removeFiles(db, removed);
+    for( auto const & filename : removed )
+      std::cout << "removed \"" << filename << "\"." << std::endl;
+    // a changed file is replaced in one transaction, such that its previous
+    // index is kept if indexing fails. the files are indexed one after the
+    // other (hdf5 is not thread safe), each in --workers processes if given.
+    for( auto const & filename : updated ) {
+      std::cout << "updating \"" << filename << "\"..." << std::endl;
+      sqlite_helpers::beginTransaction(db);
+      try {
+        sqlite_helpers::removeFile(db, filename);
+        indexHdf5FileWithOptions(db, filename, nullptr, false);
+      } catch ( std::exception const & exc ) {
+        sqlite_helpers::rollbackTransaction(db);
+        std::cerr << "ERROR " << exc.what() << "\nthe previous index of the file is kept." << std::endl;
+        failed = true;
+        continue;
+      }
+      sqlite_helpers::commitTransaction(db);
+    }
+    // the new files are added in batches of --batch-files files, one
+    // transaction per batch. a file that fails keeps the groups indexed so
+    // far (the writes roll back to their own savepoints), it is resumed by
+    // the next sync.
+    const std::size_t batchFiles = getCountOption("batch-files", 64);
+    for( std::size_t first = 0; first < added.size(); first += batchFiles ) {
+      const std::size_t last = std::min(added.size(), first + batchFiles);
+      sqlite_helpers::beginTransaction(db);
+      for( std::size_t i = first; i < last; ++i ) {
+        std::cout << "adding \"" << added[i] << "\"..." << std::endl;
+        try {
+          indexHdf5FileWithOptions(db, added[i]);
+        } catch ( std::exception const & exc ) {
+          std::cerr << "ERROR " << exc.what() << std::endl;
+          failed = true;
+        }
+      }
+      sqlite_helpers::commitTransaction(db);
+    }
+    std::cout << "sync: " << added.size() << " added, " << updated.size() << " updated, " 
+              << removed.size() << " removed, " << unchanged << " unchanged." << std::endl;
+
+    sqlite3_close(db);
+  } catch ( std::exception const & exc ) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
+  return failed ? 1 : 0;
+}
 int queryDb(int argc, char** argv) {
   if( argc != 4 ) {
-    std::cerr << "wrong number of args." << std::endl; 
-    return -1; 
+    std::cerr << "usage: query <idxfile> <query> [--format=<format>]" << std::endl;
+    return 2;
   }
 
   const std::string dbfile(argv[2]);
   const std::string query(argv[3]);
 
-  Request req = queryToRequest(query);
-
-  sqlite3 *db;
-  sqlite3_open(dbfile.c_str(), &db);
+  std::unique_ptr<IndexWriter> writer;
+  try {
+    writer = makeIndexWriter(hasOption("format") ? options.at("format") : "text", std::cout);
+    Request req = queryToRequest(query);
+    if( not FileHelpers::file_exists(dbfile) )
+      throw std::runtime_error("index file does not exist!");
+    sqlite3 *db;
+    sqlite3_open(dbfile.c_str(), &db);
+    try {
+      sqlite_helpers::orderBySelectivity(db, req);
+      // the hits are written as they are found:
+      sqlite_helpers::forEachMatchingDataset(db, req, [&writer](DatasetSpec const & dset) {
+          writer->write(dset); return true; });
+    } catch (...) {
+      sqlite3_close(db);
+      throw;
+    }
+    sqlite3_close(db);
+  } catch (std::exception const & exc) {
+    // the hits written so far are kept:
+    if( writer ) writer->flush();
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
+  writer->flush();
 
-  auto idx = getMatchingDatasetSpecs(db, req);
+  return 0;
+}
 
-  printIndex(idx, std::cout);
+// usage errors exit with 2, as for grep:
+int countDatasets(int argc, char** argv) {
+  if( argc != 4 ) {
+    std::cerr << "usage: count <idxfile> <query>" << std::endl;
+    return 2;
+  }
 
-  sqlite3_close(db);
+  const std::string dbfile(argv[2]);
+  const std::string query(argv[3]);
 
+  try {
+    Request req = queryToRequest(query);
+    if( not FileHelpers::file_exists(dbfile) )
+      throw std::runtime_error("index file does not exist!");
+    sqlite3 *db;
+    sqlite3_open(dbfile.c_str(), &db);
+    try {
+      sqlite_helpers::orderBySelectivity(db, req);
+      std::cout << sqlite_helpers::countMatchingDatasets(db, req) << std::endl;
+    } catch (...) {
+      sqlite3_close(db);
+      throw;
+    }
+    sqlite3_close(db);
+  } catch (std::exception const & exc) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
   return 0;
 }
+// the exit code tells if there is a matching dataset, as for grep: 0 if
+// there is one, 1 if there is none and 2 on errors (also of the usage):
+int datasetExists(int argc, char** argv) {
+  if( argc != 4 ) {
+    std::cerr << "usage: exists <idxfile> <query>" << std::endl;
+    return 2;
+  }
+
+  const std::string dbfile(argv[2]);
+  const std::string query(argv[3]);
 
+  bool exists = false;
+  try {
+    Request req = queryToRequest(query);
+    if( not FileHelpers::file_exists(dbfile) )
+      throw std::runtime_error("index file does not exist!");
+    sqlite3 *db;
+    sqlite3_open(dbfile.c_str(), &db);
+    try {
+      sqlite_helpers::orderBySelectivity(db, req);
+      exists = sqlite_helpers::existsMatchingDataset(db, req);
+    } catch (...) {
+      sqlite3_close(db);
+      throw;
+    }
+    sqlite3_close(db);
+  } catch (std::exception const & exc) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 2;
+  }
+  std::cout << (exists ? "yes" : "no") << std::endl;
+  return exists ? 0 : 1;
+}
+
+void outputHit( std::pair<DatasetSpec, std::vector<std::complex<double>>> const & hit ) {
+  std::cout << hit.first << std::endl;
+  for( auto const & nmbr : hit.second ) {
+    std::cout << "  " << std::real(nmbr) << " " << std::imag(nmbr) << std::endl;
+  }
+}
 void outputData( std::vector<std::pair<DatasetSpec, std::vector<std::complex<double>>>> const & res ) {
   for( auto const & hit : res ) {
-    std::cout << hit.first << std::endl;
-    for( auto const & nmbr : hit.second ) {
-      std::cout << "  " << std::real(nmbr) << " " << std::imag(nmbr) << std::endl;
-    }
+    outputHit(hit);
+  }
+}
+void outputReducedData( std::string const & description, std::vector<std::complex<double>> const & res ) {
+  std::cout << "# " << description << std::endl;
+  for( auto const & nmbr : res ) {
+    std::cout << "  " << std::real(nmbr) << " " << std::imag(nmbr) << std::endl;
+  }
+}
+int getDataPipelined(sqlite3 *db, Request const & req) {
+  // all stages run concurrently, the hits are written (or reduced) as soon as
+  // they have been read:
+  rqcd_hdf5_reader_generic::AverageAccumulator acc;
+  std::vector<std::complex<double>> concat;
+  std::size_t nhits = 0;
+  try {
+    nhits = runPipelined(db, req, [&](Hit & hit) {
+      switch( req.smode ) {
+        case SearchMode::FIRST:
+          outputHit(hit);
+          return false;
+        case SearchMode::ALL:
+          outputHit(hit);
+          return true;
+        case SearchMode::AVERAGE:
+          acc.add(hit.second);
+          return true;
+        case SearchMode::CONCATENATE:
+          // the first hit is taken over. the number of hits is only known
+          // with a limit, then all of them fit without reallocation:
+          if( concat.empty() ) {
+            concat = std::move(hit.second);
+            if( req.limit > 0 ) concat.reserve(concat.size() * req.limit);
+          } else {
+            concat.insert(concat.end(), hit.second.begin(), hit.second.end());
+          }
+          return true;
+        default:
+          throw std::runtime_error("unsupported search mode.");
+      }
+    }, 64, getProfile());
+  } catch (std::exception const & exc) {
+    std::cerr << "ERROR while reading file: " << exc.what() << std::endl;
+    return 1;
   }
+  if( nhits == 0 ) {
+    std::cerr << "ERROR no dataset matches the query." << std::endl;
+    return 1;
+  }
+  std::stringstream sstr;
+  if( req.smode == SearchMode::AVERAGE ) {
+    sstr << "average over " << nhits << " datasets";
+    outputReducedData(sstr.str(), acc.average());
+  } else if( req.smode == SearchMode::CONCATENATE ) {
+    sstr << "concatenation of " << nhits << " datasets";
+    outputReducedData(sstr.str(), concat);
+  }
+  return 0;
 }
 int getData(int argc, char** argv) {
   if( argc != 4 ) {
-    std::cerr << "wrong number of args." << std::endl; 
-    return -1; 
+    std::cerr << "usage: get <idxfile> <query>" << std::endl;
+    return 2;
   }
 
   const std::string dbfile(argv[2]);
   const std::string query(argv[3]);
 
-  Request req = queryToRequest(query);
-
-  sqlite3 *db;
-  sqlite3_open(dbfile.c_str(), &db);
+  Request req;
+  Index idx;
+  try {
+    req = queryToRequest(query);
+    // only the first hit is read:
+    if( req.smode == SearchMode::FIRST ) req.limit = 1;
+    if( not FileHelpers::file_exists(dbfile) )
+      throw std::runtime_error("index file does not exist!");
+    sqlite3 *db;
+    sqlite3_open(dbfile.c_str(), &db);
+    try {
+      sqlite_helpers::orderBySelectivity(db, req);
+      if( hasOption("pipeline") ) {
+        int res = getDataPipelined(db, req);
+        sqlite3_close(db);
+        return res;
+      }
+      idx = sqlite_helpers::getMatchingDatasets(db, req);
+    } catch (...) {
+      sqlite3_close(db);
+      throw;
+    }
+    sqlite3_close(db);
+  } catch (std::exception const & exc) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
 
-  auto idx = getMatchingDatasetSpecs(db, req);
+  if( idx.empty() ) {
+    std::cerr << "ERROR no dataset matches the query." << std::endl;
+    return 1;
+  }
 
   std::vector<std::pair<DatasetSpec, std::vector<std::complex<double>>>> res;
   if ( req.smode == SearchMode::FIRST ) 
   {
     try {
-      rqcd_hdf5_reader_generic::H5ReaderGeneric reader(idx.front().file);
+      rqcd_hdf5_reader_generic::H5ReaderGeneric reader(idx.front().file, getProfile());
       res.push_back(make_pair(idx.front(), reader.read(idx.front())));
     } catch (std::exception const & exc) {
       std::cerr << "ERROR while reading file: " << exc.what() << std::endl;
@@ -298,7 +793,7 @@ int getData(int argc, char** argv) {
             new FileConditions::NameMatches(file.filename)));
       filterIndexByPostselectionRules(idxcp, onlyThisFileReq);
       try {
-        rqcd_hdf5_reader_generic::H5ReaderGeneric reader(file);
+        rqcd_hdf5_reader_generic::H5ReaderGeneric reader(file, getProfile());
         for( auto const & dset : idxcp ) {
           res.push_back(std::make_pair(dset, reader.read(dset)));
         }
@@ -307,10 +802,28 @@ int getData(int argc, char** argv) {
         return 1;
       }
     }
+  } else if ( req.smode == SearchMode::AVERAGE ) {
+    try {
+      auto avg = rqcd_hdf5_reader_generic::readAverage(idx, getProfile());
+      std::stringstream sstr;
+      sstr << "average over " << idx.size() << " datasets";
+      outputReducedData(sstr.str(), avg);
+    } catch (std::exception const & exc) {
+      std::cerr << "ERROR while reading file: " << exc.what() << std::endl;
+      return 1;
+    }
+  } else if ( req.smode == SearchMode::CONCATENATE ) {
+    try {
+      auto concat = rqcd_hdf5_reader_generic::readConcatenated(idx, getProfile());
+      std::stringstream sstr;
+      sstr << "concatenation of " << idx.size() << " datasets";
+      outputReducedData(sstr.str(), concat);
+    } catch (std::exception const & exc) {
+      std::cerr << "ERROR while reading file: " << exc.what() << std::endl;
+      return 1;
+    }
   }
 
-  sqlite3_close(db);
-
   outputData(res);
 
   return 0;
@@ -318,6 +831,16 @@ int getData(int argc, char** argv) {
 
 int main(int argc, char** argv) {
 
+  extractOptions(argc, argv);
+  try {
+    getProfile(); // fail early for unknown profiles and counts
+    getCountOption("workers", 1);
+    getCountOption("batch-files", 64);
+    getThreads();
+  } catch ( std::exception const & exc ) {
+    std::cerr << "ERROR " << exc.what() << std::endl;
+    return 1;
+  }
   if( argc < 2 ) {
     std::cerr << "no command given." << std::endl;
     help(argc, argv);
@@ -334,6 +857,8 @@ int main(int argc, char** argv) {
     return updateFile(argc, argv);
   } else if ( command == "updateAll" ) {
     return updateAllFiles(argc, argv);
+  } else if ( command == "sync" ) {
+    return syncDirectory(argc, argv);
   } else if ( command == "help" ) {
     help(argc, argv);
     return 0;
@@ -341,8 +866,16 @@ int main(int argc, char** argv) {
     return listFiles(argc, argv);
   } else if ( command == "attributes" or command == "attr" ) {
     return listAttributes(argc, argv);
+  } else if ( command == "stats" ) {
+    return listStatistics(argc, argv);
+  } else if ( command == "facets" ) {
+    return listFacets(argc, argv);
   } else if ( command == "query" ) {
     return queryDb(argc, argv);
+  } else if ( command == "count" ) {
+    return countDatasets(argc, argv);
+  } else if ( command == "exists" ) {
+    return datasetExists(argc, argv);
   } else if ( command == "get" ) {
     return getData(argc, argv);
   } else if ( command == "version" ) {
@@ -37,8 +37,15 @@ Value jsonValueToValue(Json::Value const & json) {
     throw std::runtime_error("json value is not representable as Value.");
   }
 }
+// objects with one of the condition keywords are conditions, not values:
+bool isConditionObject(Json::Value const & json) {
+  if( not json.isObject() ) return false;
+  for( auto keyword : {"not", "min", "max", "present", "or", "matches", "smallest", "largest"} )
+    if( json.isMember(keyword) ) return true;
+  return false;
+}
 AttributeRequest parseAttributeRequest(Json::Value const & root, std::string const & name) {
-  if( isRepresentableAsValue(root[name]) ) {
+  if( isRepresentableAsValue(root[name]) and not isConditionObject(root[name]) ) {
     return AttributeRequest(name, AttributeConditions::Equals(jsonValueToValue(root[name])));
   }
   else if( root[name].isMember("not") ) {
@@ -71,10 +78,62 @@ AttributeRequest parseAttributeRequest(Json::Value const & root, std::string con
   else if( root[name].isMember("matches") and root[name]["matches"].isString() ) {
     return AttributeRequest(name, AttributeConditions::Matches(root[name]["matches"].asString()));
   }
+  else if( root[name].isMember("smallest") and root[name]["smallest"].isBool() 
+      and root[name]["smallest"].asBool() ) {
+    return AttributeRequest(name, AttributeConditions::Extremum(false));
+  }
+  else if( root[name].isMember("largest") and root[name]["largest"].isBool() 
+      and root[name]["largest"].asBool() ) {
+    return AttributeRequest(name, AttributeConditions::Extremum(true));
+  }
   else {
     throw std::runtime_error("json value is not parsable to Request.");
   }
 }
+namespace {
+// the extrema are relative to the whole request, not to a part of it:
+void checkNoExtrema(AttributeExpression const & expr) {
+  for( auto const & attrreq : expr.requests ) 
+    if( attrreq.getSqlAggregate() )
+      throw std::runtime_error("smallest and largest cannot be used within anyOf, allOf or not.");
+  for( auto const & sub : expr.expressions ) checkNoExtrema(sub);
+}
+}
+void parseAttributeOperands(Json::Value const & root, std::vector<AttributeRequest> & requests,
+    std::vector<AttributeExpression> & expressions) {
+  if( not root.isObject() )
+    throw std::runtime_error("attribute requests must be given as an object.");
+  for( auto const & name : root.getMemberNames() ) {
+    if( (name == "anyOf" or name == "allOf") and root[name].isArray() ) {
+      // each element is an object of operands that must be fulfilled together:
+      AttributeExpression expr(name == "anyOf" ? AttributeExpression::Operator::ANY_OF 
+                                               : AttributeExpression::Operator::ALL_OF);
+      for( auto const & elem : root[name] ) {
+        AttributeExpression all(AttributeExpression::Operator::ALL_OF);
+        parseAttributeOperands(elem, all.requests, all.expressions);
+        if( all.requests.size() == 1 and all.expressions.empty() )
+          expr.requests.push_back(std::move(all.requests.front()));
+        else
+          expr.expressions.push_back(std::move(all));
+      }
+      checkNoExtrema(expr);
+      expressions.push_back(std::move(expr));
+    } else if( name == "not" and root[name].isObject() ) {
+      AttributeExpression expr(AttributeExpression::Operator::NOT);
+      parseAttributeOperands(root[name], expr.requests, expr.expressions);
+      checkNoExtrema(expr);
+      expressions.push_back(std::move(expr));
+    } else if( root[name].isObject() and root[name].isMember("present") 
+        and root[name]["present"].isBool() and not root[name]["present"].asBool() ) {
+      // absent: not present
+      AttributeExpression expr(AttributeExpression::Operator::NOT);
+      expr.requests.push_back(AttributeRequest(name, AttributeConditions::Present(true)));
+      expressions.push_back(std::move(expr));
+    } else {
+      requests.push_back(parseAttributeRequest(root, name));
+    }
+  }
+}
 Hdf5DatasetRequest parseDsetRequest(Json::Value const & root, std::string const & name ) {
   assert(root.isMember(name));
   if( name == "matches" and root[name].isString() ) {
@@ -114,8 +173,7 @@ Request queryToRequest(std::string const & query) {
   for( auto name : names ) {
     if( name == std::string("attributes") ) {
       //attribute request:
-      for( auto attrname : root["attributes"].getMemberNames())
-        req.attrrequests.push_back(parseAttributeRequest(root["attributes"], attrname));
+      parseAttributeOperands(root["attributes"], req.attrrequests, req.attrexpressions);
     } else if ( name == std::string("file") ) {
       for( auto condname : root["file"].getMemberNames()) {
         req.filerequests.push_back(parseFileRequest(root["file"], condname));
@@ -124,10 +182,17 @@ Request queryToRequest(std::string const & query) {
       for( auto condname : root["dataset"].getMemberNames()) {
         req.dsetrequests.push_back(parseDsetRequest(root["dataset"], condname));
       }
+    } else if ( name == std::string("expression") and root[name].isString() ) {
+      req.expressions.push_back(Expression(root[name].asString()));
+    } else if ( name == std::string("expression") and root[name].isArray() ) {
+      for( auto const & expr : root[name] )
+        req.expressions.push_back(Expression(expr.asString()));
     } else if ( name == std::string("luacode") ) {
-      throw std::runtime_error("lua postprocessing is not yet implemented.");
+      throw std::runtime_error("lua postprocessing is not implemented, use \"expression\" instead.");
     } else if ( name == std::string("searchmode") and root[name].isString() ) {
       req.smode = searchModeFromString(root["searchmode"].asString());
+    } else if ( name == std::string("limit") and root[name].isUInt() ) {
+      req.limit = root[name].asUInt();
     } else {
       std::stringstream sstr;
       sstr << "unknown request type: " << name << std::endl;
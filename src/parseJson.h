@@ -11,9 +11,14 @@
 
 namespace rqcd_file_index {
 bool isRepresentableAsValue(Json::Value const & json);
+bool isConditionObject(Json::Value const & json);
 Value jsonValueToValue(Json::Value const & json);
 Attribute parseAttribute( Json::Value const & root);
 AttributeRequest parseAttributeRequest(Json::Value const & root, std::string const & name);
+// the members of an "attributes" object: conditions on single attributes, and
+// the combinators "anyOf", "allOf" and "not":
+void parseAttributeOperands(Json::Value const & root, std::vector<AttributeRequest> & requests,
+    std::vector<AttributeExpression> & expressions);
 DatasetSpec parseDsetspec( Json::Value const & root );
 FileRequest parseFileRequest(Json::Value const & root, std::string const & name);
 Request queryToRequest(std::string const & query);
@@ -0,0 +1,176 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include "pipeline.h"
+#include "boundedQueue.h"
+#include "sqliteHelpers.h"
+#include "postselection.h"
+#include "hdf5ReaderGeneric.h"
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <iterator>
+#include <set>
+
+namespace rqcd_file_index {
+std::size_t runPipelined(sqlite3 *db, Request const & req, HitSink const & sink,
+    std::size_t queuesize, H5DataHelpers::FileAccessProfile const & profile) {
+  BoundedQueue<DatasetSpec> candidates(queuesize), selected(queuesize);
+  BoundedQueue<Hit> hits(queuesize);
+  // set if any stage fails or the sink does not want any further hits:
+  std::atomic<bool> stop(false);
+  std::exception_ptr error;
+  std::mutex errmtx;
+  auto abort = [&]() {
+    {
+      std::lock_guard<std::mutex> lock(errmtx);
+      if( not error ) error = std::current_exception();
+    }
+    stop = true;
+    candidates.close(); selected.close(); hits.close();
+  };
+
+  std::thread preselection([&]() {
+    try {
+      sqlite_helpers::forEachLocIdMatchingPreSelection(db, req, [&](int locid) {
+        if( stop ) return false;
+        return candidates.push(sqlite_helpers::idsToDatasetSpec(db, locid));
+      });
+    } catch (...) { abort(); }
+    candidates.close();
+  });
+  std::thread postselection([&]() {
+    try {
+      PostselectionPlan plan(req);
+      DatasetSpec dset;
+      if( hasExtrema(req.attrrequests) ) {
+        // the extremal datasets are only known after all candidates:
+        Index extremal;
+        while( not stop and candidates.pop(dset) )
+          if( plan.matches(dset) ) extremal.push_back(std::move(dset));
+        reduceToExtrema(extremal, req.attrrequests);
+        for( auto & selecteddset : extremal )
+          if( stop or not selected.push(std::move(selecteddset)) ) break;
+      } else {
+        while( not stop and candidates.pop(dset) ) {
+          if( plan.matches(dset) and not selected.push(std::move(dset)) )
+            break;
+        }
+      }
+    } catch (...) { abort(); }
+    candidates.close();
+    selected.close();
+  });
+  std::thread reading([&]() {
+    try {
+      std::unique_ptr<rqcd_hdf5_reader_generic::H5ReaderGeneric> reader;
+      std::string currentFile;
+      DatasetSpec dset;
+      while( not stop and selected.pop(dset) ) {
+        if( not reader or dset.file.filename != currentFile ) {
+          reader.reset(); // close the previous file first.
+          reader.reset(new rqcd_hdf5_reader_generic::H5ReaderGeneric(dset.file, profile));
+          currentFile = dset.file.filename;
+        }
+        Hit hit;
+        hit.first = std::move(dset);
+        reader->readInto(hit.first, hit.second);
+        if( not hits.push(std::move(hit)) ) break;
+      }
+    } catch (...) { abort(); }
+    selected.close();
+    hits.close();
+  });
+
+  std::size_t nhits = 0;
+  try {
+    Hit hit;
+    while( not stop and hits.pop(hit) ) {
+      nhits++;
+      if( not sink(hit) or nhits == req.limit ) break;
+    }
+  } catch (...) { abort(); }
+  // the sink is done (or failed): let the other stages finish early.
+  stop = true;
+  candidates.close(); selected.close(); hits.close();
+  preselection.join();
+  postselection.join();
+  reading.join();
+  if( error ) std::rethrow_exception(error);
+  return nhits;
+}
+namespace {
+// datasets that are written in one transaction, and the groups directly below
+// the root that are complete with them:
+struct IndexBatch {
+  Index datasets;
+  std::vector<std::string> completed;
+};
+}
+std::size_t indexPipelined(sqlite3 *db, std::string const & filename, TraversalStats * stats,
+    H5DataHelpers::FileAccessProfile const & profile, TraversalOptions const & options, 
+    bool resume, std::size_t nworkers, std::size_t batchsize, std::size_t queuesize) {
+  checkHdf5File(filename);
+  const File file(filename);
+  TraversalOptions opts(options);
+  std::set<std::string> done;
+  if( resume and sqlite_helpers::getProgress(db, file, done) ) {
+    opts.skipTopLevel.insert(done.begin(), done.end());
+  } else {
+    // the datasets of an interrupted run (of this or another version of the
+    // file) are not continued, they are indexed again:
+    if( sqlite_helpers::listIncompleteFiles(db).count(filename) > 0 )
+      sqlite_helpers::removeFile(db, filename);
+    sqlite_helpers::startProgress(db, file);
+  }
+
+  BoundedQueue<IndexBatch> batches(queuesize);
+  std::exception_ptr error;
+  std::thread writer([&]() {
+    try {
+      IndexBatch batch;
+      while( batches.pop(batch) ) {
+        sqlite_helpers::insertDataset(db, batch.datasets);
+        // inserting is idempotent: a group that is not recorded yet is just
+        // inserted again when resuming.
+        sqlite_helpers::addProgress(db, file, batch.completed);
+      }
+    } catch (...) {
+      error = std::current_exception();
+      batches.close(); // the traversal stops at the next push.
+    }
+  });
+
+  std::size_t ndatasets = 0;
+  try {
+    IndexBatch batch;
+    opts.onGroupDone = [&batch](std::string const & name) { batch.completed.push_back(name); };
+    auto sink = [&](Index && part) {
+      ndatasets += part.size();
+      if( batch.datasets.empty() ) batch.datasets = std::move(part);
+      else batch.datasets.insert(batch.datasets.end(), std::make_move_iterator(part.begin()), 
+                                                       std::make_move_iterator(part.end()));
+      if( batch.datasets.size() >= batchsize ) {
+        if( not batches.push(std::move(batch)) ) throw std::runtime_error("writing to the database failed.");
+        batch = IndexBatch();
+      }
+    };
+    if( nworkers > 1 ) indexHdf5FileParallel(filename, nworkers, sink, stats, profile, opts);
+    else indexHdf5File(filename, sink, stats, profile, opts);
+    batches.push(std::move(batch));
+  } catch (...) {
+    batches.close();
+    writer.join();
+    // the error of the writer is the cause:
+    if( not error ) error = std::current_exception();
+  }
+  batches.close();
+  if( writer.joinable() ) writer.join();
+  // the completed groups stay in the database, such that indexing can be resumed:
+  if( error ) std::rethrow_exception(error);
+  sqlite_helpers::finishProgress(db, file);
+  return ndatasets;
+}
+}
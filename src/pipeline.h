@@ -0,0 +1,56 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+#include <sqlite3.h>
+#include <vector>
+#include <complex>
+#include <functional>
+#include "attributes.h"
+#include "h5helpers.h"
+#include "indexHdf5.h"
+
+namespace rqcd_file_index {
+typedef std::pair<DatasetSpec, std::vector<std::complex<double>>> Hit;
+// receives the hits in the order of the preselection. returning false stops
+// the pipeline, no further hits are produced.
+typedef std::function<bool(Hit &)> HitSink;
+/*
+ * pipelined execution of a request: preselection (and hydration of the
+ * DatasetSpecs), postselection, reading and output run concurrently, connected
+ * by bounded queues of at most queuesize elements each:
+ *
+ *   sql -> DatasetSpec -> postselection -> hdf5 reader -> sink
+ *
+ * the sink is called from the calling thread. sqlite and hdf5 are only used
+ * from one thread each. returns the number of hits passed to the sink, at
+ * most the limit of the request.
+ */
+std::size_t runPipelined(sqlite3 *db, Request const & req, HitSink const & sink,
+    std::size_t queuesize = 64,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT);
+/*
+ * indexes the file into the database while it is traversed: the datasets of
+ * the completed groups are collected into batches of about batchsize datasets
+ * and passed through a bounded queue of queuesize batches to a writer thread,
+ * which inserts each batch in its own transaction. the memory used does not
+ * depend on the size of the file. returns the number of datasets.
+ *
+ * the groups directly below the root are recorded as progress in the
+ * database as soon as all their datasets have been written. if indexing
+ * fails, the written datasets stay in the database and the file is marked as
+ * incomplete. with resume, the groups recorded for the same version of the
+ * file are not traversed again.
+ *
+ * with more than one worker, the groups directly below the root are
+ * traversed by forked processes (see indexHdf5FileParallel), and their
+ * datasets are written as they arrive.
+ */
+std::size_t indexPipelined(sqlite3 *db, std::string const & filename, TraversalStats * stats = nullptr,
+    H5DataHelpers::FileAccessProfile const & profile = H5DataHelpers::FileAccessProfile::DEFAULT,
+    TraversalOptions const & options = TraversalOptions(), bool resume = false,
+    std::size_t nworkers = 1, std::size_t batchsize = 4096, std::size_t queuesize = 4);
+}
+#endif
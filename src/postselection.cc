@@ -4,50 +4,306 @@
  */
 #include "postselection.h"
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <limits>
 
 namespace rqcd_file_index {
-void filterIndexByAttributeRequests(Index& idx, std::vector<AttributeRequest> const & req) {
-  idx.erase( std::remove_if( idx.begin(), idx.end(),
-    [&req](DatasetSpec const & dsetspec) {
-      bool matches = true; //preselection has already matched..
-      // run over all attributeRequests: every request must match against
-      // any attribute:
-      for( auto const & attrreq : req) {
-        bool thisReqIsFulfilled = false;
-        for( auto const & attr : dsetspec.attributes )
-          thisReqIsFulfilled |= attrreq.matches(attr);
-        // no need to look further: remove the datasetspec...
-        if( not thisReqIsFulfilled ) return true;
-        matches &= thisReqIsFulfilled;
+namespace {
+std::vector<AttributeExpression> const noAttrExpressions;
+std::vector<Hdf5DatasetRequest> const noDsetRequests;
+std::vector<FileRequest> const noFileRequests;
+std::vector<Expression> const noExpressions;
+std::atomic<unsigned long> lastPlanId(0);
+// datasets per chunk of the postselection:
+const std::size_t chunksize = 1024;
+// removes the datasets that are not kept, the others keep their order:
+void compact(Index & idx, std::vector<char> const & keep) {
+  std::size_t nkept = 0;
+  for( std::size_t i = 0; i < idx.size(); ++i ) {
+    if( not keep[i] ) continue;
+    if( nkept != i ) idx[nkept] = std::move(idx[i]);
+    nkept++;
+  }
+  idx.erase(idx.begin() + nkept, idx.end());
+}
+}
+PostselectionPlan::PostselectionPlan(Request const & req) :
+  PostselectionPlan(req.attrrequests, req.attrexpressions, req.dsetrequests, req.filerequests, 
+      req.expressions) {}
+PostselectionPlan::PostselectionPlan(std::vector<AttributeRequest> const & attrreqs) :
+  PostselectionPlan(attrreqs, noAttrExpressions, noDsetRequests, noFileRequests, noExpressions) {}
+PostselectionPlan::PostselectionPlan(std::vector<AttributeRequest> const & attrreqs, 
+    std::vector<AttributeExpression> const & exprs,
+    std::vector<Hdf5DatasetRequest> const & dsetreqs, std::vector<FileRequest> const & filereqs,
+    std::vector<Expression> const & expressions_) :
+  attrrequests(attrreqs), attrexpressions(exprs), dsetrequests(dsetreqs), filerequests(filereqs), 
+  expressions(expressions_), id(++lastPlanId) {
+  for( auto const & attrreq : attrrequests ) {
+    auto it = nameids.emplace(attrreq.getName(), (int)nameids.size()).first;
+    reqnameids.push_back(it->second);
+    intervals.emplace_back();
+    reqcolumns.push_back(-1);
+    if( not attrreq.getNumericIntervals(intervals.back()) ) continue;
+    // one column per name:
+    auto col = std::find(columnnameids.begin(), columnnameids.end(), it->second);
+    reqcolumns.back() = (int)(col - columnnameids.begin());
+    if( col == columnnameids.end() ) columnnameids.push_back(it->second);
+  }
+  for( auto const & expr : expressions ) {
+    exprnameids.emplace_back();
+    for( auto const & name : expr.getNames() )
+      exprnameids.back().push_back(nameids.emplace(name, (int)nameids.size()).first->second);
+  }
+}
+PostselectionPlan::Slots const & PostselectionPlan::slotsOf(DatasetSpec const & dsetspec) const {
+  // the slots of the last dataset seen by this thread. the datasets of a
+  // group share their attribute names, so the names are usually only
+  // compared, not looked up:
+  thread_local Slots slots;
+  auto const & attrs = dsetspec.attributes;
+  bool samenames = slots.planid == id and slots.names.size() == attrs.size();
+  for( auto i = 0u; samenames and i < attrs.size(); ++i )
+    samenames = slots.names[i] == attrs[i].getName();
+  if( samenames ) return slots;
+  slots.planid = id;
+  slots.names.clear();
+  slots.first.assign(nameids.size(), -1);
+  slots.next.assign(attrs.size(), -1);
+  for( auto const & attr : attrs ) slots.names.push_back(attr.getName());
+  for( int i = (int)attrs.size() - 1; i >= 0; --i ) {
+    auto it = nameids.find(attrs[i].getName());
+    if( it == nameids.end() ) continue;
+    slots.next[i] = slots.first[it->second];
+    slots.first[it->second] = i;
+  }
+  return slots;
+}
+bool PostselectionPlan::matchesAttributes(DatasetSpec const & dsetspec, bool skipNumeric) const {
+  for( auto const & expr : attrexpressions )
+    if( not matchesAttributeExpression(dsetspec, expr) ) return false;
+  if( attrrequests.empty() ) return true;
+  auto const & slots = slotsOf(dsetspec);
+  // every request must match against any attribute in its slot:
+  for( auto r = 0u; r < attrrequests.size(); ++r ) {
+    if( skipNumeric and reqcolumns[r] >= 0 ) continue;
+    bool fulfilled = false;
+    for( int i = slots.first[reqnameids[r]]; i >= 0 and not fulfilled; i = slots.next[i] )
+      fulfilled = attrrequests[r].matches(dsetspec.attributes[i]);
+    if( not fulfilled ) return false;
+  }
+  return true;
+}
+bool PostselectionPlan::matchesExpressions(DatasetSpec const & dsetspec) const {
+  if( expressions.empty() ) return true;
+  auto const & slots = slotsOf(dsetspec);
+  // the values of the first attribute in each slot are bound to the names:
+  thread_local std::vector<Value const *> values;
+  for( auto e = 0u; e < expressions.size(); ++e ) {
+    values.resize(exprnameids[e].size());
+    for( auto n = 0u; n < values.size(); ++n ) {
+      const int a = slots.first[exprnameids[e][n]];
+      values[n] = a >= 0 ? &dsetspec.attributes[a].getValue() : nullptr;
+    }
+    if( not expressions[e].evaluate(values) ) return false;
+  }
+  return true;
+}
+bool PostselectionPlan::matches(DatasetSpec const & dsetspec) const {
+  return matchesHdf5DatasetRequests(dsetspec, dsetrequests)
+     and matchesAttributes(dsetspec)
+     and matchesFileRequests(dsetspec, filerequests)
+     and matchesExpressions(dsetspec);
+}
+void PostselectionPlan::gatherColumns(Index const & idx, std::size_t begin, std::size_t end,
+    ColumnarCandidates & cols) const {
+  // the columns are reused for the next chunk:
+  cols.size = end - begin;
+  const std::size_t nwords = (cols.size + 63) / 64;
+  cols.values.resize(columnnameids.size());
+  cols.present.resize(columnnameids.size());
+  for( auto c = 0u; c < columnnameids.size(); ++c ) {
+    cols.values[c].assign(cols.size, std::numeric_limits<double>::quiet_NaN());
+    cols.present[c].assign(nwords, 0);
+  }
+  cols.recheck.assign(nwords, 0);
+  for( std::size_t i = 0; i < cols.size; ++i ) {
+    auto const & attrs = idx[begin + i].attributes;
+    auto const & slots = slotsOf(idx[begin + i]);
+    for( auto c = 0u; c < columnnameids.size(); ++c ) {
+      int a = slots.first[columnnameids[c]];
+      if( a < 0 ) continue;
+      if( slots.next[a] >= 0 ) {
+        cols.recheck[i/64] |= std::uint64_t(1) << (i % 64);
+        continue;
       }
-      //remove if none of the attributes could match the conditions in the
-      //request.
-      return (not matches);
-    }), idx.end());
+      if( attrs[a].getType() != Type::NUMERIC ) continue;
+      cols.values[c][i] = attrs[a].getValue().getNumeric();
+      cols.present[c][i/64] |= std::uint64_t(1) << (i % 64);
+    }
+  }
+}
+std::vector<std::uint64_t> PostselectionPlan::selectColumnar(ColumnarCandidates const & cols, SimdLevel level) const {
+  const std::size_t nwords = (cols.size + 63) / 64;
+  std::vector<std::uint64_t> selected(nwords, ~std::uint64_t(0)), matched(nwords);
+  for( auto r = 0u; r < attrrequests.size(); ++r ) {
+    if( reqcolumns[r] < 0 ) continue;
+    std::fill(matched.begin(), matched.end(), 0);
+    for( auto const & interval : intervals[r] )
+      selectInterval(cols.values[reqcolumns[r]].data(), cols.size, interval.first, interval.second,
+          matched.data(), level);
+    auto const & present = cols.present[reqcolumns[r]];
+    for( std::size_t w = 0; w < nwords; ++w ) selected[w] &= matched[w] & present[w];
+  }
+  for( std::size_t w = 0; w < nwords; ++w ) selected[w] |= cols.recheck[w];
+  return selected;
+}
+void PostselectionPlan::select(Index const & idx, std::size_t begin, std::size_t end, std::vector<char> & keep) const {
+  if( columnnameids.empty() ) {
+    for( std::size_t i = begin; i < end; ++i ) keep[i] = matches(idx[i]);
+    return;
+  }
+  // the numeric requests on columns of at most chunksize datasets first,
+  // the others only for the datasets that fulfill them:
+  const bool onlyNumeric = attrexpressions.empty() 
+    and std::count(reqcolumns.begin(), reqcolumns.end(), -1) == 0;
+  ColumnarCandidates cols;
+  for( std::size_t chunk = begin; chunk < end; chunk += chunksize ) {
+    gatherColumns(idx, chunk, std::min(end, chunk + chunksize), cols);
+    auto selected = selectColumnar(cols);
+    for( std::size_t i = 0; i < cols.size; ++i ) {
+      DatasetSpec const & dsetspec = idx[chunk + i];
+      if( not ((selected[i/64] >> (i % 64)) & 1) ) 
+        keep[chunk + i] = false;
+      else if( (cols.recheck[i/64] >> (i % 64)) & 1 )
+        keep[chunk + i] = matches(dsetspec);
+      else
+        keep[chunk + i] = matchesHdf5DatasetRequests(dsetspec, dsetrequests)
+          and (onlyNumeric or matchesAttributes(dsetspec, true))
+          and matchesFileRequests(dsetspec, filerequests)
+          and matchesExpressions(dsetspec);
+    }
+  }
+}
+bool matchesAttributeExpression(DatasetSpec const & dsetspec, AttributeExpression const & expr) {
+  // an operand is fulfilled if any attribute matches the request, the
+  // operands are evaluated until the result is known:
+  const bool any = expr.op == AttributeExpression::Operator::ANY_OF;
+  bool result = not any;
+  for( auto const & attrreq : expr.requests ) {
+    const bool fulfilled = std::any_of(dsetspec.attributes.begin(), dsetspec.attributes.end(),
+        [&](Attribute const & attr) { return attrreq.matches(attr); });
+    if( fulfilled == any ) { result = fulfilled; break; }
+  }
+  if( result != any )
+    for( auto const & sub : expr.expressions ) {
+      const bool fulfilled = matchesAttributeExpression(dsetspec, sub);
+      if( fulfilled == any ) { result = fulfilled; break; }
+    }
+  return expr.op == AttributeExpression::Operator::NOT ? not result : result;
+}
+bool matchesExpression(DatasetSpec const & dsetspec, Expression const & expr) {
+  std::vector<Value const *> values;
+  for( auto const & name : expr.getNames() ) {
+    auto it = std::find_if(dsetspec.attributes.begin(), dsetspec.attributes.end(), 
+        [&](Attribute const & attr) { return attr.getName() == name; });
+    values.push_back(it != dsetspec.attributes.end() ? &it->getValue() : nullptr);
+  }
+  return expr.evaluate(values);
+}
+bool matchesFileRequests(DatasetSpec const & dsetspec, std::vector<FileRequest> const & req) {
+  for( auto const & filereq : req ) {
+    if( not filereq->matches(dsetspec.file) ) return false;
+  }
+  return true;
+}
+bool matchesHdf5DatasetRequests(DatasetSpec const & dsetspec, std::vector<Hdf5DatasetRequest> const & req) {
+  for( auto const & dsetreq : req ) {
+    if( not dsetreq->matches(dsetspec.datasetname, dsetspec.location) ) return false;
+  }
+  return true;
+}
+void filterIndexByAttributeRequests(Index& idx, std::vector<AttributeRequest> const & req) {
+  std::vector<char> keep(idx.size());
+  PostselectionPlan(req).select(idx, 0, idx.size(), keep);
+  compact(idx, keep);
+  reduceToExtrema(idx, req);
 }
 void filterIndexByFileRequests(Index& idx, std::vector<FileRequest> const & req) {
   idx.erase( std::remove_if( idx.begin(), idx.end(),
     [&req](DatasetSpec const & dsetspec) {
-      bool matches = true;
-      for( auto const & filereq : req ) {
-        matches &= filereq->matches(dsetspec.file);
-      }
-      return (not matches);
+      return not matchesFileRequests(dsetspec, req);
     }), idx.end());
 }
 void filterIndexByHdf5DatasetRequests(Index& idx, std::vector<Hdf5DatasetRequest> const & req) {
   idx.erase( std::remove_if( idx.begin(), idx.end(),
     [&req](DatasetSpec const & dsetspec) {
-      bool matches = true;
-      for( auto const & dsetreq : req ) {
-        matches &= dsetreq->matches(dsetspec.datasetname, dsetspec.location);
-      }
-      return (not matches);
+      return not matchesHdf5DatasetRequests(dsetspec, req);
     }), idx.end());
 }
 void filterIndexByPostselectionRules(Index& idx, Request const & req) {
-  filterIndexByHdf5DatasetRequests(idx, req.dsetrequests);
-  filterIndexByAttributeRequests(idx, req.attrrequests);
-  filterIndexByFileRequests(idx, req.filerequests);
+  std::vector<char> keep(idx.size());
+  PostselectionPlan(req).select(idx, 0, idx.size(), keep);
+  compact(idx, keep);
+  reduceToExtrema(idx, req.attrrequests);
+}
+bool hasExtrema(std::vector<AttributeRequest> const & req) {
+  return std::any_of(req.begin(), req.end(), 
+      [](AttributeRequest const & attrreq) { return attrreq.getSqlAggregate() != nullptr; });
+}
+void reduceToExtrema(Index& idx, std::vector<AttributeRequest> const & req) {
+  for( auto const & attrreq : req ) {
+    if( not attrreq.getSqlAggregate() or idx.empty() ) continue;
+    const bool largest = std::string(attrreq.getSqlAggregate()) == "max";
+    // the value of the requested attribute of each dataset:
+    std::vector<Value const *> values(idx.size(), nullptr);
+    Value const * best = nullptr;
+    for( auto i = 0u; i < idx.size(); ++i ) {
+      for( auto const & attr : idx[i].attributes )
+        if( attr.getName() == attrreq.getName() ) { values[i] = &attr.getValue(); break; }
+      if( values[i] and (not best or (largest ? *best < *values[i] : *values[i] < *best)) )
+        best = values[i];
+    }
+    std::vector<char> keep(idx.size());
+    for( auto i = 0u; i < idx.size(); ++i )
+      keep[i] = values[i] and *values[i] == *best;
+    compact(idx, keep);
+  }
+}
+void filterIndexByPostselectionRulesParallel(Index& idx, Request const & req, std::size_t nthreads) {
+  if( nthreads == 0 ) nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+  nthreads = std::min(nthreads, (idx.size() + chunksize - 1) / chunksize);
+  if( nthreads <= 1 ) {
+    filterIndexByPostselectionRules(idx, req);
+    return;
+  }
+  // the threads take the next chunk from a shared counter and mark the
+  // datasets to keep. the index is only changed once all of them succeeded:
+  PostselectionPlan plan(req);
+  std::vector<char> keep(idx.size());
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stop(false);
+  std::exception_ptr error;
+  std::mutex errmtx;
+  auto work = [&]() {
+    try {
+      std::size_t chunk;
+      while( not stop and (chunk = next++) * chunksize < idx.size() ) {
+        plan.select(idx, chunk * chunksize, std::min(idx.size(), (chunk + 1) * chunksize), keep);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errmtx);
+      if( not error ) error = std::current_exception();
+      stop = true;
+    }
+  };
+  std::vector<std::thread> threads;
+  for( std::size_t t = 0; t < nthreads; ++t ) threads.emplace_back(work);
+  for( auto & thread : threads ) thread.join();
+  if( error ) std::rethrow_exception(error);
+  compact(idx, keep);
+  reduceToExtrema(idx, req.attrrequests);
 }
 }
@@ -2,11 +2,107 @@
  * Copyright (c) 2016 by Jakob Simeth
  * Licensed under MIT License. See LICENSE in the root directory.
  */
+#ifndef __POSTSELECTION_H__
+#define __POSTSELECTION_H__
+#include <unordered_map>
+#include <cstdint>
 #include "attributes.h"
 #include "conditions.h"
+#include "selectionKernels.h"
+#include "expression.h"
 
 namespace rqcd_file_index {
+/*
+ * the numeric attributes of a range of datasets in columns, one for each
+ * attribute name with numeric conditions: values[c][i] is the value of the
+ * i-th dataset (nan if it has none), bit i of present[c] is set if it has
+ * one. datasets with more than one attribute of a column's name are marked
+ * in recheck, they are checked one by one.
+ */
+struct ColumnarCandidates {
+  std::size_t size = 0;
+  std::vector<std::vector<double>> values;
+  std::vector<std::vector<std::uint64_t>> present;
+  std::vector<std::uint64_t> recheck;
+};
+/*
+ * a request compiled for the postselection of many datasets. the requested
+ * attribute names are interned once: a dataset is checked by looking up the
+ * slot of each of its attributes by name, then the attribute requests are
+ * evaluated in order on the attributes in their slot only, stopping at the
+ * first one that is not fulfilled.
+ *
+ * the slots are reused as long as the attribute names do not change.
+ *
+ * numeric conditions (see AttributeCondition::getNumericIntervals) on ranges
+ * of datasets are evaluated on columns instead, by the selection kernels.
+ * the attribute expressions are evaluated after the attribute requests, the
+ * expressions (see Expression) after all other conditions, on the values in
+ * the slots of their names.
+ *
+ * the plan refers to the conditions of the request, which must outlive it.
+ * matches() may be called from several threads at once.
+ */
+class PostselectionPlan {
+  public:
+    explicit PostselectionPlan(Request const & req);
+    explicit PostselectionPlan(std::vector<AttributeRequest> const & attrreqs);
+    bool matches(DatasetSpec const & dsetspec) const;
+    bool matchesAttributes(DatasetSpec const & dsetspec) const { return matchesAttributes(dsetspec, false); }
+    // sets keep[i] for the datasets idx[begin] ... idx[end-1]:
+    void select(Index const & idx, std::size_t begin, std::size_t end, std::vector<char> & keep) const;
+    void gatherColumns(Index const & idx, std::size_t begin, std::size_t end, ColumnarCandidates & cols) const;
+    // bit i is set if dataset i fulfills all numeric requests or must be rechecked:
+    std::vector<std::uint64_t> selectColumnar(ColumnarCandidates const & cols, 
+        SimdLevel level = detectSimdLevel()) const;
+  private:
+    PostselectionPlan(std::vector<AttributeRequest> const & attrreqs, std::vector<AttributeExpression> const & exprs,
+        std::vector<Hdf5DatasetRequest> const & dsetreqs, std::vector<FileRequest> const & filereqs,
+        std::vector<Expression> const & expressions_);
+    // the first attribute with each requested name, and the next one with
+    // the same name (-1: none):
+    struct Slots {
+      unsigned long planid = 0;
+      std::vector<std::string> names;
+      std::vector<int> first, next;
+    };
+    Slots const & slotsOf(DatasetSpec const & dsetspec) const;
+    bool matchesAttributes(DatasetSpec const & dsetspec, bool skipNumeric) const;
+    bool matchesExpressions(DatasetSpec const & dsetspec) const;
+    std::vector<AttributeRequest> const & attrrequests;
+    std::vector<AttributeExpression> const & attrexpressions;
+    std::vector<Hdf5DatasetRequest> const & dsetrequests;
+    std::vector<FileRequest> const & filerequests;
+    std::vector<Expression> const & expressions;
+    unsigned long id; // identifies the plan in the per-thread slots
+    // interned attribute names, and the name id of each attribute request:
+    std::unordered_map<std::string, int> nameids;
+    std::vector<int> reqnameids;
+    // the name id of each name of the expressions:
+    std::vector<std::vector<int>> exprnameids;
+    // the intervals of the numeric requests, and their column (-1: not
+    // numeric). column c holds the attributes with name id columnnameids[c]:
+    std::vector<std::vector<std::pair<double, double>>> intervals;
+    std::vector<int> reqcolumns;
+    std::vector<int> columnnameids;
+};
+// single DatasetSpecs; a stream of them is checked with a PostselectionPlan
+// built once (its smallest and largest values are only checked for presence,
+// see reduceToExtrema):
+bool matchesAttributeExpression(DatasetSpec const & dsetspec, AttributeExpression const & expr);
+bool matchesExpression(DatasetSpec const & dsetspec, Expression const & expr);
+bool matchesFileRequests(DatasetSpec const & dsetspec, std::vector<FileRequest> const & req);
+bool matchesHdf5DatasetRequests(DatasetSpec const & dsetspec, std::vector<Hdf5DatasetRequest> const & req);
+// complete indices:
 void filterIndexByAttributeRequests(Index& idx, std::vector<AttributeRequest> const & req);
 void filterIndexByFileRequests(Index& idx, std::vector<FileRequest> const & req);
 void filterIndexByPostselectionRules(Index& idx, Request const & req);
+// keeps the datasets holding the smallest or largest value of the attributes
+// requested with AttributeConditions::Extremum, one after the other:
+bool hasExtrema(std::vector<AttributeRequest> const & req);
+void reduceToExtrema(Index& idx, std::vector<AttributeRequest> const & req);
+// complete indices, split into chunks that are checked by nthreads threads
+// (0: one per core). the remaining datasets keep their order:
+void filterIndexByPostselectionRulesParallel(Index& idx, Request const & req, std::size_t nthreads = 0);
 }
+#endif
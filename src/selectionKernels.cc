@@ -0,0 +1,76 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include "selectionKernels.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SELECTION_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace rqcd_file_index {
+namespace {
+void selectIntervalScalar(double const * values, std::size_t begin, std::size_t n,
+    double lo, double hi, std::uint64_t * mask) {
+  for( std::size_t i = begin; i < n; ++i )
+    mask[i/64] |= (std::uint64_t)(lo <= values[i] and values[i] <= hi) << (i % 64);
+}
+#if defined(SELECTION_KERNELS_X86)
+// two values per compare, a word of the mask is filled by 32 of them:
+__attribute__((target("sse2")))
+void selectIntervalSse2(double const * values, std::size_t n, double lo, double hi, std::uint64_t * mask) {
+  const __m128d vlo = _mm_set1_pd(lo), vhi = _mm_set1_pd(hi);
+  std::size_t i = 0;
+  for( ; i + 64 <= n; i += 64 ) {
+    std::uint64_t word = 0;
+    for( std::size_t j = 0; j < 64; j += 2 ) {
+      __m128d v = _mm_loadu_pd(values + i + j);
+      __m128d in = _mm_and_pd(_mm_cmpge_pd(v, vlo), _mm_cmple_pd(v, vhi));
+      word |= (std::uint64_t)_mm_movemask_pd(in) << j;
+    }
+    mask[i/64] |= word;
+  }
+  selectIntervalScalar(values, i, n, lo, hi, mask);
+}
+// four values per compare. the ordered compares are false for nan:
+__attribute__((target("avx2")))
+void selectIntervalAvx2(double const * values, std::size_t n, double lo, double hi, std::uint64_t * mask) {
+  const __m256d vlo = _mm256_set1_pd(lo), vhi = _mm256_set1_pd(hi);
+  std::size_t i = 0;
+  for( ; i + 64 <= n; i += 64 ) {
+    std::uint64_t word = 0;
+    for( std::size_t j = 0; j < 64; j += 4 ) {
+      __m256d v = _mm256_loadu_pd(values + i + j);
+      __m256d in = _mm256_and_pd(_mm256_cmp_pd(v, vlo, _CMP_GE_OQ), _mm256_cmp_pd(v, vhi, _CMP_LE_OQ));
+      word |= (std::uint64_t)_mm256_movemask_pd(in) << j;
+    }
+    mask[i/64] |= word;
+  }
+  selectIntervalScalar(values, i, n, lo, hi, mask);
+}
+#endif
+}
+SimdLevel detectSimdLevel() {
+#if defined(SELECTION_KERNELS_X86)
+  static const SimdLevel level = __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 
+    : __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+  return level;
+#else
+  return SimdLevel::SCALAR;
+#endif
+}
+void selectInterval(double const * values, std::size_t n, double lo, double hi,
+    std::uint64_t * mask, SimdLevel level) {
+#if defined(SELECTION_KERNELS_X86)
+  if( level == SimdLevel::AVX2 ) 
+    selectIntervalAvx2(values, n, lo, hi, mask);
+  else if( level == SimdLevel::SSE2 ) 
+    selectIntervalSse2(values, n, lo, hi, mask);
+  else
+    selectIntervalScalar(values, 0, n, lo, hi, mask);
+#else
+  (void)level;
+  selectIntervalScalar(values, 0, n, lo, hi, mask);
+#endif
+}
+}
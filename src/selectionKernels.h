@@ -0,0 +1,30 @@
+/* 
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __SELECTION_KERNELS_H__
+#define __SELECTION_KERNELS_H__
+#include <cstdint>
+#include <cstddef>
+
+namespace rqcd_file_index {
+/*
+ * instruction sets for the selection kernels. the best one supported by the
+ * cpu is detected at runtime, such that the binary does not need to be built
+ * for the machine it runs on.
+ */
+enum class SimdLevel {
+  SCALAR,
+  SSE2,
+  AVX2
+};
+SimdLevel detectSimdLevel();
+/*
+ * sets bit i%64 of mask[i/64] for all values lo <= values[i] <= hi, the other
+ * bits are kept (several intervals can be or'ed into one mask). mask must
+ * hold (n+63)/64 words. nan never matches.
+ */
+void selectInterval(double const * values, std::size_t n, double lo, double hi,
+    std::uint64_t * mask, SimdLevel level = detectSimdLevel());
+}
+#endif
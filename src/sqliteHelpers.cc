@@ -3,9 +3,16 @@
  * Licensed under MIT License. See LICENSE in the root directory.
  */
 #include "sqliteHelpers.h"
+#include "postselection.h"
 #include <sstream>
 #include <set>
 #include <iostream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <limits>
 namespace rqcd_file_index {
 namespace sqlite_helpers {
 static int insertStringCallback(void *idx, int argc, char** argv, char** azColName){
@@ -14,15 +21,6 @@ static int insertStringCallback(void *idx, int argc, char** argv, char** azColNa
   vec->push_back(std::string(argv[0]));
   return 0;
 }
-static int insertIntCallback(void *idx, int argc, char** argv, char** azColName){
-  std::vector<int>* vec = (std::vector<int>*)idx;
-  if( argc != 1 ) { return -1; }
-  std::stringstream sstr(argv[0]);
-  int res;
-  sstr >> res;
-  vec->push_back(res);
-  return 0;
-}
 static int getIntCallback(void *intvar, int argc, char** argv, char** azColName) {
   if( argc != 1) { return -1;}
   std::stringstream sstr(argv[0]);
@@ -70,6 +68,196 @@ static int printCallback(void *NotUsed, int argc, char** argv, char** azColName)
   }
   return 0;
 }
+namespace {
+void exec(sqlite3 *db, std::string const & request) {
+  char *zErrMsg = nullptr;
+  int rc = sqlite3_exec( db, request.c_str(), printCallback, 0, &zErrMsg );
+  if( rc != SQLITE_OK ) {
+    std::stringstream errstr;
+    errstr << "SQL error: " << zErrMsg << "\nfailed request was: " << request;
+    sqlite3_free(zErrMsg);
+    throw std::runtime_error(errstr.str());
+  }
+}
+/*
+ * prepared statement that is reused for many executions with different
+ * bindings, finalized when going out of scope.
+ */
+class Statement {
+  public:
+  Statement(sqlite3 *db_, std::string const & request_) : db(db_), request(request_) {
+    if( sqlite3_prepare_v2(db, request.c_str(), -1, &stmt, nullptr) != SQLITE_OK ) fail();
+  }
+  ~Statement() { sqlite3_finalize(stmt); }
+  Statement(Statement const &) = delete;
+  void bind(int idx, int val) { check(sqlite3_bind_int(stmt, idx, val)); }
+  void bind(int idx, sqlite3_int64 val) { check(sqlite3_bind_int64(stmt, idx, val)); }
+  void bind(int idx, std::string const & val) { 
+    check(sqlite3_bind_text(stmt, idx, val.c_str(), val.size(), SQLITE_TRANSIENT)); }
+  void bind(int idx, Value const & val) {
+    // numbers are stored exactly, bools as integers. arrays are stored as
+    // text, with their numbers in full precision:
+    switch( val.getType() ) {
+      case Type::NUMERIC: check(sqlite3_bind_double(stmt, idx, val.getNumeric())); break;
+      case Type::BOOLEAN: check(sqlite3_bind_int(stmt, idx, val.getBool() ? 1 : 0)); break;
+      case Type::STRING:  bind(idx, val.getString()); break;
+      default: {
+        std::stringstream sstr;
+        sstr << std::setprecision(17) << val;
+        bind(idx, sstr.str());
+      }
+    }
+  }
+  // executes the statement (again), returns true if there is a result row:
+  bool step() {
+    int rc = sqlite3_step(stmt);
+    if( rc == SQLITE_ROW ) return true;
+    if( rc != SQLITE_DONE ) fail();
+    return false;
+  }
+  int columnInt(int col) { return sqlite3_column_int(stmt, col); }
+  sqlite3_int64 columnInt64(int col) { return sqlite3_column_int64(stmt, col); }
+  bool columnIsNull(int col) { return sqlite3_column_type(stmt, col) == SQLITE_NULL; }
+  std::string columnText(int col) { 
+    return std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, col))); }
+  void reset() { sqlite3_reset(stmt); }
+  private:
+  void check(int rc) { if( rc != SQLITE_OK ) fail(); }
+  void fail() {
+    std::stringstream errstr;
+    errstr << "SQL error: " << sqlite3_errmsg(db) << "\nfailed request was: " << request;
+    throw std::runtime_error(errstr.str());
+  }
+  sqlite3 *db;
+  std::string request;
+  sqlite3_stmt *stmt = nullptr;
+};
+bool hasTable(sqlite3 *db, std::string const & name) {
+  Statement stmt(db, "select 1 from sqlite_master where type = 'table' and name = ?;");
+  stmt.bind(1, name);
+  return stmt.step();
+}
+bool hasColumn(sqlite3 *db, std::string const & table, std::string const & column) {
+  Statement stmt(db, "select 1 from pragma_table_info(?) where name = ?;");
+  stmt.bind(1, table);
+  stmt.bind(2, column);
+  return stmt.step();
+}
+// returns the id of the first result row, or -1 if there is none:
+int selectId(Statement & stmt) {
+  int id = stmt.step() ? stmt.columnInt(0) : -1;
+  stmt.reset();
+  return id;
+}
+// the change of the number of locations with an attribute value:
+struct CountChange {
+  int attrid = -1;
+  int delta = 0;
+};
+// the change of the number of locations with an attribute value in a file,
+// by file id and value id:
+typedef std::map<std::pair<int, int>, int> FileCountChanges;
+/*
+ * applies the changes to the value statistics and updates the statistics of
+ * their attributes incrementally. only if a value disappears, the range of
+ * its attribute is recomputed from all values. the number of files with a
+ * value changes when its first location in a file is added or its last one
+ * removed.
+ */
+void updateStatistics(sqlite3 *db, std::map<int, CountChange> const & changes, 
+    FileCountChanges const & filechanges) {
+  if( changes.empty() or not hasTable(db, "valuestats") ) return;
+  Statement selectCount(db, "select count from valuestats where valueid = ?;");
+  Statement insertCount(db, "insert or ignore into valuestats(valueid, count, nfiles) values(?, 0, 0);");
+  Statement setCount(db, "update valuestats set count = ?2 where valueid = ?1;");
+  Statement deleteCount(db, "delete from valuestats where valueid = ?;");
+  Statement selectFileCount(db, "select count from filevaluestats where fileid = ? and valueid = ?;");
+  Statement setFileCount(db, "insert or replace into filevaluestats(fileid, valueid, count) values(?, ?, ?);");
+  Statement deleteFileCount(db, "delete from filevaluestats where fileid = ? and valueid = ?;");
+  Statement addFiles(db, "update valuestats set nfiles = nfiles + ? where valueid = ?;");
+  Statement insertStats(db, "insert or ignore into attrstats(attrid, nlocations, ndistinct) values(?, 0, 0);");
+  Statement addLocations(db, "update attrstats set nlocations = nlocations + ? where attrid = ?;");
+  Statement addValue(db, "update attrstats set ndistinct = ndistinct + 1, "
+      "minvalue = coalesce(min(minvalue, (select value from attrvalues where valueid = ?2)), "
+        "(select value from attrvalues where valueid = ?2)), "
+      "maxvalue = coalesce(max(maxvalue, (select value from attrvalues where valueid = ?2)), "
+        "(select value from attrvalues where valueid = ?2)) where attrid = ?1;");
+  Statement deleteStats(db, "delete from attrstats where attrid = ?;");
+  Statement recomputeStats(db, "insert into attrstats(attrid, nlocations, ndistinct, minvalue, maxvalue) "
+      "select v.attrid, sum(s.count), count(*), min(v.value), max(v.value) from attrvalues v "
+      "join valuestats s on s.valueid = v.valueid where v.attrid = ? and s.count > 0 group by v.attrid;");
+  auto run = [](Statement & stmt) { stmt.step(); stmt.reset(); };
+  std::map<int, int> locations;
+  std::set<int> recompute;
+  for( auto const & change : changes ) locations[change.second.attrid] += change.second.delta;
+  for( auto const & attr : locations ) {
+    insertStats.bind(1, attr.first);
+    run(insertStats);
+    addLocations.bind(1, attr.second);
+    addLocations.bind(2, attr.first);
+    run(addLocations);
+  }
+  for( auto const & change : changes ) {
+    selectCount.bind(1, change.first);
+    const int count = selectCount.step() ? selectCount.columnInt(0) : 0;
+    selectCount.reset();
+    const int newcount = count + change.second.delta;
+    if( newcount > 0 ) {
+      insertCount.bind(1, change.first);
+      run(insertCount);
+      setCount.bind(1, change.first);
+      setCount.bind(2, newcount);
+      run(setCount);
+    } else {
+      deleteCount.bind(1, change.first);
+      run(deleteCount);
+    }
+    if( count <= 0 and newcount > 0 ) {
+      addValue.bind(1, change.second.attrid);
+      addValue.bind(2, change.first);
+      run(addValue);
+    } else if( count > 0 and newcount <= 0 ) {
+      recompute.insert(change.second.attrid);
+    }
+  }
+  for( int attrid : recompute ) {
+    deleteStats.bind(1, attrid);
+    run(deleteStats);
+    recomputeStats.bind(1, attrid);
+    run(recomputeStats);
+  }
+  std::map<int, int> files;
+  for( auto const & change : filechanges ) {
+    selectFileCount.bind(1, change.first.first);
+    selectFileCount.bind(2, change.first.second);
+    const int count = selectFileCount.step() ? selectFileCount.columnInt(0) : 0;
+    selectFileCount.reset();
+    const int newcount = count + change.second;
+    if( newcount > 0 ) {
+      setFileCount.bind(1, change.first.first);
+      setFileCount.bind(2, change.first.second);
+      setFileCount.bind(3, newcount);
+      run(setFileCount);
+    } else {
+      deleteFileCount.bind(1, change.first.first);
+      deleteFileCount.bind(2, change.first.second);
+      run(deleteFileCount);
+    }
+    if( count <= 0 and newcount > 0 ) files[change.first.second]++;
+    else if( count > 0 and newcount <= 0 ) files[change.first.second]--;
+  }
+  for( auto const & file : files ) {
+    addFiles.bind(1, file.second);
+    addFiles.bind(2, file.first);
+    run(addFiles);
+  }
+}
+// the value as stored, reals in full precision:
+std::string valueColumn(std::string const & column) {
+  return "case when typeof(" + column + ") = 'real' then printf('%!.17g', " + column + ") else " 
+    + column + " end";
+}
+}
 static int insertAttributeCallback(void *vec, int argc, char** argv, char** azColName) {
   std::vector<Attribute>* attrvec = (std::vector<Attribute>*)vec;
   if( argc != 3 ) return -1;
@@ -95,12 +283,15 @@ void prepareSqliteFile(sqlite3 *db) {
    * attrvalues:
    * id | attrId | value | locId
    */
+  const bool hadStatistics = hasTable(db, "valuestats") and hasTable(db, "filevaluestats");
   char *zErrMsg = nullptr;
   std::string request(
       "create table if not exists files("
         "fileid integer primary key asc,"
         "fname text unique,"
-        "mtime int);" 
+        "mtime int,"
+        "size int,"
+        "hash int);" 
       "create table if not exists attributes("
         "attrid integer primary key asc,"
         "attrname text unique,"
@@ -116,7 +307,34 @@ void prepareSqliteFile(sqlite3 *db) {
         "value  blob);"
       "create table if not exists locattrjunction("
         "attrvalid integer references attrvalues(valueid),"
-        "locid integer references filelocations(locid));");
+        "locid integer references filelocations(locid));"
+      "create table if not exists progress("
+        "fileid integer references files(fileid),"
+        "mtime int,"
+        "objname text);"
+      // statistics for ordering the conditions of requests:
+      "create table if not exists valuestats("
+        "valueid integer primary key references attrvalues(valueid),"
+        "count int,"
+        "nfiles int);"
+      // the facets, i.e. the number of files with each value:
+      "create table if not exists filevaluestats("
+        "fileid integer references files(fileid),"
+        "valueid integer references attrvalues(valueid),"
+        "count int,"
+        "primary key(fileid, valueid));"
+      "create table if not exists attrstats("
+        "attrid integer primary key references attributes(attrid),"
+        "nlocations int,"
+        "ndistinct int,"
+        "minvalue blob,"
+        "maxvalue blob);"
+      // lookups during insertion:
+      "create index if not exists filelocations_lookup on filelocations(fileid, locname, row);"
+      "create index if not exists attrvalues_lookup on attrvalues(attrid, value);"
+      "create index if not exists locattrjunction_lookup on locattrjunction(locid, attrvalid);"
+      // the locations of rare values, without scanning all junctions:
+      "create index if not exists locattrjunction_byvalue on locattrjunction(attrvalid, locid);");
 
   int rc = sqlite3_exec( db,
       request.c_str(),
@@ -126,83 +344,18 @@ void prepareSqliteFile(sqlite3 *db) {
     errstr << "SQL error: " << zErrMsg << "\nfailed request was: " << request;
     throw std::runtime_error(errstr.str());
   }
-}
-std::string createFilelocInsertionString( 
-    std::tuple<std::string, std::string, int> const & fileloc ) {
-  std::stringstream sstr;
-  sstr << 
-    "insert or ignore into filelocations(locname,row,fileid) select '" << 
-      std::get<1>(fileloc) << //locname
-      "'," << std::get<2>(fileloc) << ",(select fileid from files where fname = '" 
-      << std::get<0>(fileloc) <<  //filename
-    "') where not exists (select 1 from filelocations where locname = '"
-    << std::get<1>(fileloc) << "' and row = " << std::get<2>(fileloc) << 
-    " and fileid = (select fileid from files where fname = '" << std::get<0>(fileloc) 
-    << "'));";
-  return sstr.str();
-}
-std::string createAttributesInsertionString( std::pair<std::string, std::string> const & attr ) {
-  std::stringstream sstr;
-  sstr << 
-    "insert or ignore into attributes(attrname,type) values('" <<
-    attr.first << "', '" << attr.second << "');";
-  return sstr.str();
-}
-std::string createAttributeValuesInsertionString( 
-    std::tuple<std::string, std::string, std::string> const & attrval ) {
-  std::stringstream sstr;
-  sstr << 
-    "insert into attrvalues(attrid, value) select " <<
-    "(select attrid from attributes where attrname = '" << std::get<0>(attrval) <<
-    "' and type = '" <<  std::get<1>(attrval) << "'), ";
-    if( std::get<1>(attrval) == "array" or std::get<1>(attrval) == "string") {
-      sstr << "'" << std::get<2>(attrval) << "'";
-    } else {
-      sstr << std::get<2>(attrval) << "";
-    }
-  sstr << " where not exists ( select 1 from attrvalues where attrid = "
-    "(select attrid from attributes where attrname = '" << std::get<0>(attrval) <<
-    "' and type = '" << std::get<1>(attrval) << "') and value = ";
-    if( std::get<1>(attrval) == "array" or std::get<1>(attrval) == "string") {
-      sstr << "'" << std::get<2>(attrval) << "');";
-    } else {
-      sstr << std::get<2>(attrval) << ");";
-    }
-  return sstr.str();
-}
-std::string createJunctionInsertionString(
-  std::pair<std::tuple<std::string, std::string, int>, std::tuple<std::string, std::string, std::string>> const & junc ) {
-  std::stringstream sstr;
-
-  sstr <<
-    "insert into locattrjunction(attrvalid, locid) select ( "
-    "select valueid from attrvalues where attrid = ( "
-    "select attrid from attributes where attrname = '"
-    << std::get<0>(junc.second) << "' and type = '" << std::get<1>(junc.second) << "') and value = ";
-  if( std::get<1>(junc.second) == "string" or std::get<1>(junc.second) == "array" ) {
-    sstr << "'" << std::get<2>(junc.second) << "'";
-  } else {
-    sstr << std::get<2>(junc.second);
-  }
-  sstr << "), (select locid from filelocations where locname = '" 
-       << std::get<1>(junc.first) << "' and row = " << std::get<2>(junc.first) 
-       << " and fileid = ( select fileid from files where fname = '" 
-       << std::get<0>(junc.first) << "')) where not exists ( select 1 from "
-       "locattrjunction where attrvalid = (select valueid from attrvalues where attrid = ( "
-       "select attrid from attributes where attrname = '"
-       << std::get<0>(junc.second) << "' and type = '" << std::get<1>(junc.second) << "' and value = ";
-  if( std::get<1>(junc.second) == "string" or std::get<1>(junc.second) == "array" ) {
-    sstr << "'" << std::get<2>(junc.second) << "'";
-  } else {
-    sstr << std::get<2>(junc.second);
-  }
-  sstr << ")));";
-  return sstr.str();
+  // indices created before the files had fingerprints:
+  for( auto column : {"size", "hash"} )
+    if( not hasColumn(db, "files", column) )
+      exec(db, std::string("alter table files add column ") + column + " int;");
+  // indices created before there were (file) statistics:
+  if( not hasColumn(db, "valuestats", "nfiles") ) exec(db, "alter table valuestats add column nfiles int;");
+  if( not hadStatistics ) rebuildStatistics(db);
 }
 File getFile(sqlite3 *db, std::string const & file) {
   std::stringstream sstr;
   sstr << "select fname, mtime from files where fname = '"  << file << "';";
-  std::vector<File> f{File("", 0)};
+  std::vector<File> f;
   char *zErrMsg = nullptr;
   int rc = sqlite3_exec( db,
       sstr.str().c_str(), fileCallback, &f, &zErrMsg );
@@ -243,99 +396,162 @@ std::vector<File> listFiles(sqlite3* db) {
   return files;
 }
 void removeFile(sqlite3 *db, std::string const & file) {
-  // removes file from database, i.e. removes all filelocations and
-  // locattrjunctions and files pointing to this file. doesn't remove attributes
-  // and attrvalues because these might potentially be used from other files.
-  std::stringstream sstr;
-  sstr << "begin transaction;"; 
-  // delete locattrjunctions:
-  sstr << "delete from locattrjunction where locid in "
-    "(select locid from filelocations where fileid = "
-       "(select fileid from files where fname = '" << file << "'));";
-  // delete filelocations:
-  sstr << "delete from filelocations where fileid = "
-       "(select fileid from files where fname = '" << file << "');";
-  // delete file itself:
-  sstr << "delete from files where fname = '"  << file << "';";
-  sstr << "commit transaction;";
-  char *zErrMsg = nullptr;
-  int rc = sqlite3_exec( db,
-      sstr.str().c_str(), printCallback, 0, &zErrMsg );
-  if( rc != SQLITE_OK ) {
-    std::stringstream errstr;
-    errstr << "SQL error: " << zErrMsg << "\nfailed request was: " << sstr.str();
-    throw std::runtime_error(errstr.str());
+  removeFiles(db, {file});
+}
+void removeFiles(sqlite3 *db, std::vector<std::string> const & files) {
+  // removes the files from database in one transaction, i.e. removes all
+  // filelocations and locattrjunctions and files pointing to these files.
+  // doesn't remove attributes and attrvalues because these might potentially
+  // be used from other files.
+  if( files.empty() ) return;
+  const bool progress = hasTable(db, "progress");
+  exec(db, "savepoint removefiles;");
+  try {
+    Statement deleteJunctions(db, "delete from locattrjunction where locid in "
+        "(select locid from filelocations where fileid = (select fileid from files where fname = ?));");
+    Statement deleteLocations(db, "delete from filelocations where fileid = "
+        "(select fileid from files where fname = ?);");
+    Statement deleteFile(db, "delete from files where fname = ?;");
+    std::vector<Statement *> statements{&deleteJunctions, &deleteLocations, &deleteFile};
+    // the progress of an interrupted indexing run:
+    std::unique_ptr<Statement> deleteProgress;
+    if( progress ) {
+      deleteProgress.reset(new Statement(db, "delete from progress where fileid = "
+          "(select fileid from files where fname = ?);"));
+      statements.insert(statements.end() - 1, deleteProgress.get());
+    }
+    // the locations per attribute value that are removed, for the statistics:
+    Statement countJunctions(db, "select j.attrvalid, v.attrid, count(*), l.fileid from locattrjunction j "
+        "join attrvalues v on v.valueid = j.attrvalid join filelocations l on l.locid = j.locid "
+        "where l.fileid = (select fileid from files where fname = ?) group by j.attrvalid;");
+    std::map<int, CountChange> changes;
+    FileCountChanges filechanges;
+    for( auto const & file : files ) {
+      countJunctions.bind(1, file);
+      while( countJunctions.step() ) {
+        auto & change = changes[countJunctions.columnInt(0)];
+        change.attrid = countJunctions.columnInt(1);
+        change.delta -= countJunctions.columnInt(2);
+        filechanges[{countJunctions.columnInt(3), countJunctions.columnInt(0)}] -= countJunctions.columnInt(2);
+      }
+      countJunctions.reset();
+      for( Statement * stmt : statements ) {
+        stmt->bind(1, file);
+        stmt->step();
+        stmt->reset();
+      }
+    }
+    updateStatistics(db, changes, filechanges);
+  } catch (...) {
+    sqlite3_exec(db, "rollback to removefiles; release removefiles;", NULL, NULL, NULL);
+    throw;
   }
+  exec(db, "release removefiles;");
+}
+/*
+ * the helpers write in savepoints: within a transaction of the caller, their
+ * changes are only kept if the transaction is committed.
+ */
+void beginTransaction(sqlite3 *db) {
+  exec(db, "begin transaction;");
+}
+void commitTransaction(sqlite3 *db) {
+  exec(db, "commit transaction;");
+}
+void rollbackTransaction(sqlite3 *db) {
+  exec(db, "rollback transaction;");
 }
 void insertDataset(sqlite3 *db, Index const & idx ) {
-  char *zErrMsg = nullptr;
-  std::stringstream sstr;
-  //insert all files:
-  auto filelist = getUniqueFiles(idx);
-  for( auto file : filelist ){
-    /*sstr << "insert or replace into files(fname, mtime) values('" 
-      << file.filename << "', " << file.mtime << ");";
-      */
-    sstr << "insert into files(fname, mtime) select '" << file.filename << "', " << file.mtime << " where not exists (select 1 from files where fname = '" << file.filename << "');";
-  }
-  int rc = sqlite3_exec( db,
-      sstr.str().c_str(), printCallback, 0, &zErrMsg );
-  if( rc != SQLITE_OK ) {
-    std::stringstream errstr;
-    errstr << "SQL error: " << zErrMsg << "\nfailed request was: " << sstr.str();
-    throw std::runtime_error(errstr.str());
-  }
-  sstr.clear(); sstr.str("");
-  
-  //insert attributes and filelocations:
-  // pre-compile a unique list of insertions:
-  {
-    std::set<std::pair<std::string, std::string>> attributes; //attribute name, type
-    std::set<std::tuple<std::string, std::string, std::string>> attrvalues; //attribute name, type, value
-    std::set<std::tuple<std::string, std::string, int>> filelocations; //file, dsetname, row
-    // this seems to be a rather complicated construct, but is just a pair of
-    // the filelocation and the attrvalue:
-    std::set<std::pair<std::tuple<std::string, std::string, int>, std::tuple<std::string, std::string, std::string>>> junctions;
-    std::stringstream valsstr;
+  /*
+   * inserts all datasets in one transaction. each file, location, attribute
+   * and attribute value is only inserted if it doesn't exist yet, the
+   * statements are prepared once and the ids of files and attributes are
+   * cached for the whole index.
+   */
+  if( idx.empty() ) return;
+  exec(db, "savepoint insertdataset;");
+  try {
+    Statement insertFile(db, "insert into files(fname, mtime) select ?1, ?2 "
+        "where not exists (select 1 from files where fname = ?1);");
+    Statement selectFile(db, "select fileid from files where fname = ?;");
+    Statement selectLoc(db, "select locid from filelocations where fileid = ? and locname = ? and row = ?;");
+    Statement insertLoc(db, "insert into filelocations(fileid, locname, row) values(?, ?, ?);");
+    Statement insertAttr(db, "insert or ignore into attributes(attrname, type) values(?, ?);");
+    Statement selectAttr(db, "select attrid from attributes where attrname = ? and type = ?;");
+    Statement selectValue(db, "select valueid from attrvalues where attrid = ? and value = ?;");
+    Statement insertValue(db, "insert into attrvalues(attrid, value) values(?, ?);");
+    Statement insertJunction(db, "insert into locattrjunction(attrvalid, locid) select ?1, ?2 "
+        "where not exists (select 1 from locattrjunction where attrvalid = ?1 and locid = ?2);");
+    std::map<std::string, int> fileids;
+    // attribute ids by name and type. attribute names are unique: if a name
+    // is already used with another type, the id is -1 and the attribute
+    // cannot be stored.
+    std::map<std::pair<std::string, std::string>, int> attrids;
+    // new locations per attribute value (and file), for the statistics:
+    std::map<int, CountChange> changes;
+    FileCountChanges filechanges;
     for( auto const & dset : idx ) {
-      filelocations.insert(std::make_tuple(dset.file.filename, dset.datasetname, dset.location.row));
+      auto fileit = fileids.find(dset.file.filename);
+      if( fileit == fileids.end() ) {
+        insertFile.bind(1, dset.file.filename);
+        insertFile.bind(2, dset.file.mtime);
+        insertFile.step();
+        insertFile.reset();
+        selectFile.bind(1, dset.file.filename);
+        fileit = fileids.insert({dset.file.filename, selectId(selectFile)}).first;
+      }
+      selectLoc.bind(1, fileit->second);
+      selectLoc.bind(2, dset.datasetname);
+      selectLoc.bind(3, dset.location.row);
+      int locid = selectId(selectLoc);
+      if( locid < 0 ) {
+        insertLoc.bind(1, fileit->second);
+        insertLoc.bind(2, dset.datasetname);
+        insertLoc.bind(3, dset.location.row);
+        insertLoc.step();
+        insertLoc.reset();
+        locid = sqlite3_last_insert_rowid(db);
+      }
       for( auto const & attr : dset.attributes ) {
-        valsstr.clear(); valsstr.str("");
-        valsstr << attr.getValue();
-        attributes.insert(std::make_pair(attr.getName(), typeToString(attr.getType())));
-        attrvalues.insert(std::make_tuple(attr.getName(), typeToString(attr.getType()), valsstr.str()));
-        junctions.insert(std::make_pair(
-          std::make_tuple(dset.file.filename, dset.datasetname, dset.location.row),
-          std::make_tuple(attr.getName(), typeToString(attr.getType()), valsstr.str())));
+        auto key = std::make_pair(attr.getName(), typeToString(attr.getType()));
+        auto attrit = attrids.find(key);
+        if( attrit == attrids.end() ) {
+          insertAttr.bind(1, key.first);
+          insertAttr.bind(2, key.second);
+          insertAttr.step();
+          insertAttr.reset();
+          selectAttr.bind(1, key.first);
+          selectAttr.bind(2, key.second);
+          attrit = attrids.insert({key, selectId(selectAttr)}).first;
+        }
+        if( attrit->second < 0 ) continue;
+        selectValue.bind(1, attrit->second);
+        selectValue.bind(2, attr.getValue());
+        int valueid = selectId(selectValue);
+        if( valueid < 0 ) {
+          insertValue.bind(1, attrit->second);
+          insertValue.bind(2, attr.getValue());
+          insertValue.step();
+          insertValue.reset();
+          valueid = sqlite3_last_insert_rowid(db);
+        }
+        insertJunction.bind(1, valueid);
+        insertJunction.bind(2, locid);
+        insertJunction.step();
+        insertJunction.reset();
+        if( sqlite3_changes(db) > 0 ) {
+          changes[valueid].attrid = attrit->second;
+          changes[valueid].delta++;
+          filechanges[{fileit->second, valueid}]++;
+        }
       }
     }
-    sstr << "begin transaction;";
-    for( auto const & fileloc : filelocations ){
-      sstr << createFilelocInsertionString(fileloc);
-    }
-    sstr << "commit transaction; begin transaction;";
-    for( auto const & attr : attributes ){
-      sstr << createAttributesInsertionString(attr);
-    }
-    sstr << "commit transaction; begin transaction;";
-    for( auto const & attr : attrvalues ){
-      sstr << createAttributeValuesInsertionString(attr);
-    }
-    sstr << "commit transaction; begin transaction;";
-  //TODO: fileattrjunction
-    for( auto const & junc : junctions ) {
-      sstr << createJunctionInsertionString(junc);
-    }
-    sstr << "commit transaction;";
-  }
-  
-  rc = sqlite3_exec( db,
-      sstr.str().c_str(), printCallback, 0, &zErrMsg );
-  if( rc != SQLITE_OK ) {
-    std::stringstream errstr;
-    errstr << "SQL error: " << zErrMsg << "\nfailed request was: " << sstr.str();
-    throw std::runtime_error(errstr.str());
+    updateStatistics(db, changes, filechanges);
+  } catch (...) {
+    sqlite3_exec(db, "rollback to insertdataset; release insertdataset;", NULL, NULL, NULL);
+    throw;
   }
+  exec(db, "release insertdataset;");
 }
 // find all with 250 smearing iterations:
 // select locname from filelocations where locid in (select locid from attrvalues where value="250" and attrid=(select attrid from attributes where attrname="smeariter"));
@@ -343,35 +559,272 @@ void insertDataset(sqlite3 *db, Index const & idx ) {
 // find all with 250 smeariter and 3 hpe:
 // select locname from filelocations where locid in (select locid from attrvalues where value="3" and attrid=(select attrid from attributes where attrname="hpe")) and locid in (select locid from attrvalues where value="250" and attrid=(select attrid from attributes where attrname="smeariter"))
 
-std::vector<int> getLocIdsMatchingPreSelection(sqlite3 *db, Request const & req) {
-  std::vector<int> res;
-  std::string query;
-  //for empty requests, return everything:
-  if( req.attrrequests.empty() )
-    query = "select locid from filelocations;";
-  else {
-    //build sql query:
-    std::stringstream sstr;
-    sstr << "select locid from filelocations where locid in ";
-    for( auto i = 0u; i < req.attrrequests.size(); ++i ) {
-      sstr << "(select locid from locattrjunction where "
-        "attrvalid = (select valueid from attrvalues where "
-        << req.attrrequests[i].getSqlValueDescription("value") 
-        << " and attrid = (select attrid from attributes where " 
-        << req.attrrequests[i].getSqlKeyDescription("attrname") << ")))";
-      if( i < req.attrrequests.size() - 1 ) sstr << " and locid in ";
-  }
-  sstr << ";";
-  query = sstr.str();
+namespace {
+// the locations with an attribute matching the request:
+std::string locationsMatching(AttributeRequest const & attrreq) {
+  std::stringstream sstr;
+  sstr << "select locid from locattrjunction where "
+    "attrvalid in (select valueid from attrvalues where "
+    << attrreq.getSqlValueDescription("value") 
+    << " and attrid = (select attrid from attributes where " 
+    << attrreq.getSqlKeyDescription("attrname") << "))";
+  return sstr.str();
+}
+// the locations with the smallest (or largest) value of the attribute among
+// the given locations:
+std::string locationsWithExtremum(AttributeRequest const & attrreq, std::string const & locations) {
+  const std::string attrid = "(select attrid from attributes where " 
+    + attrreq.getSqlKeyDescription("attrname") + ")";
+  std::stringstream sstr;
+  sstr << "select locid from locattrjunction where attrvalid in (select valueid from attrvalues where "
+    "attrid = " << attrid << " and value = (select " << attrreq.getSqlAggregate() << "(value) "
+    "from attrvalues where attrid = " << attrid << " and valueid in "
+    "(select attrvalid from locattrjunction where locid in (" << locations << "))))";
+  return sstr.str();
+}
+/*
+ * the locations that may fulfill the expression, as a compound select of the
+ * operands. returns "" if the expression does not restrict the locations.
+ * exact is set if exactly the fulfilling locations are selected, only then
+ * the selection can be negated.
+ */
+std::string locationsMatching(AttributeExpression const & expr, bool & exact) {
+  std::vector<std::string> parts;
+  exact = true;
+  bool unrestricted = false;
+  for( auto const & attrreq : expr.requests ) {
+    parts.push_back(locationsMatching(attrreq));
+    exact &= attrreq.isSqlExact();
   }
-  char *zErrMsg = nullptr;
-  int rc = sqlite3_exec( db,
-      query.c_str(), insertIntCallback, &res, &zErrMsg );
+  for( auto const & sub : expr.expressions ) {
+    bool subexact = false;
+    const std::string part = locationsMatching(sub, subexact);
+    if( part.empty() ) unrestricted = true;
+    else parts.push_back(part);
+    exact &= subexact;
+  }
+  exact &= not unrestricted;
+  if( expr.op == AttributeExpression::Operator::ANY_OF ) {
+    if( unrestricted ) return "";
+    if( parts.empty() ) return "select locid from filelocations where 0";
+  } else if( parts.empty() ) {
+    exact = false;
+    return "";
+  }
+  std::stringstream sstr;
+  const char * op = expr.op == AttributeExpression::Operator::ANY_OF ? " union " : " intersect ";
+  for( auto i = 0u; i < parts.size(); ++i )
+    sstr << (i ? op : "") << "select locid from (" << parts[i] << ")";
+  if( expr.op != AttributeExpression::Operator::NOT ) return sstr.str();
+  if( not exact ) return "";
+  return "select locid from filelocations except select locid from (" + sstr.str() + ")";
+}
+// the same for one location of filelocations, looked up by the index on
+// (locid, attrvalid) instead of collecting all matching locations first:
+std::string locationHasMatching(AttributeRequest const & attrreq) {
+  std::stringstream sstr;
+  sstr << "exists (select 1 from locattrjunction j cross join attrvalues v on v.valueid = j.attrvalid "
+    "where j.locid = filelocations.locid and v.attrid = (select attrid from attributes where " 
+    << attrreq.getSqlKeyDescription("attrname") << ") and "
+    << attrreq.getSqlValueDescription("v.value") << ")";
+  return sstr.str();
+}
+}
+bool isPreSelectionExact(Request const & req) {
+  // file and dataset conditions and expressions are only evaluated by the
+  // postselection, the extrema must not be taken before them:
+  if( not req.filerequests.empty() or not req.dsetrequests.empty() or not req.expressions.empty() ) 
+    return false;
+  for( auto const & attrreq : req.attrrequests )
+    if( not attrreq.getSqlAggregate() and not attrreq.isSqlExact() ) return false;
+  for( auto const & expr : req.attrexpressions ) {
+    bool exact = false;
+    locationsMatching(expr, exact);
+    if( not exact ) return false;
+  }
+  return true;
+}
+namespace {
+/*
+ * the query of the preselection, restricted to the locations in range (a
+ * condition on locid, or ""). the limit is only passed to the database if
+ * there is no postselection.
+ */
+std::string preSelectionQuery(Request const & req, bool streaming, std::string const & range, 
+    std::size_t limit) {
+  // the conditions on the locations:
+  std::vector<std::string> conditions;
+  if( not range.empty() ) conditions.push_back(range);
+  for( auto const & attrreq : req.attrrequests ) {
+    if( attrreq.getSqlAggregate() ) continue;
+    conditions.push_back(streaming ? locationHasMatching(attrreq) 
+        : "locid in (" + locationsMatching(attrreq) + ")");
+  }
+  for( auto const & expr : req.attrexpressions ) {
+    bool exact = false;
+    const std::string part = locationsMatching(expr, exact);
+    if( not part.empty() ) conditions.push_back("locid in (" + part + ")");
+  }
+  auto query = [&conditions]() {
+    //for empty requests, return everything:
+    std::string res("select locid from filelocations");
+    for( auto i = 0u; i < conditions.size(); ++i )
+      res += (i ? " and " : " where ") + conditions[i];
+    return res;
+  };
+  // the extrema among the locations selected so far, if these are exact.
+  // otherwise the postselection has to find them:
+  const bool exact = isPreSelectionExact(req);
+  for( auto const & attrreq : req.attrrequests ) {
+    if( not attrreq.getSqlAggregate() ) continue;
+    conditions.push_back("locid in (" 
+        + (exact ? locationsWithExtremum(attrreq, query()) : locationsMatching(attrreq)) + ")");
+  }
+  // without postselection, the database can stop after the limit:
+  if( limit > 0 and exact ) return query() + " limit " + std::to_string(limit);
+  return query();
+}
+// runs the query, returns false if the callback stopped it:
+bool forEachLocId(sqlite3 *db, std::string const & query, std::function<bool(int)> const & callback) {
+  sqlite3_stmt *stmt = nullptr;
+  int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
   if( rc != SQLITE_OK ) {
     std::stringstream errstr;
-    errstr << "SQL error: " << zErrMsg << "\nfailed request was: " << query;
+    errstr << "SQL error: " << sqlite3_errmsg(db) << "\nfailed request was: " << query;
+    throw std::runtime_error(errstr.str());
+  }
+  bool stopped = false;
+  try {
+    while( (rc = sqlite3_step(stmt)) == SQLITE_ROW ) {
+      if( not callback(sqlite3_column_int(stmt, 0)) ) {
+        rc = SQLITE_DONE;
+        stopped = true;
+        break;
+      }
+    }
+  } catch (...) {
+    sqlite3_finalize(stmt);
+    throw;
+  }
+  sqlite3_finalize(stmt);
+  if( rc != SQLITE_DONE ) {
+    std::stringstream errstr;
+    errstr << "SQL error: " << sqlite3_errmsg(db) << "\nfailed request was: " << query;
     throw std::runtime_error(errstr.str());
   }
+  return not stopped;
+}
+// locations that are checked one by one for requests with a limit:
+const int probesize = 4096;
+void forEachLocIdMatching(sqlite3 *db, Request const & req, std::size_t limit,
+    std::function<bool(int)> const & callback) {
+  if( limit == 0 or hasExtrema(req.attrrequests) ) {
+    forEachLocId(db, preSelectionQuery(req, false, "", limit), callback);
+    return;
+  }
+  // with a limit, the first probesize locations are checked one by one. this
+  // finds frequent matches in constant time, without collecting all matching
+  // locations. the matches after them (if still needed) are collected:
+  Statement bound(db, "select locid from filelocations order by locid limit 1 offset " 
+      + std::to_string(probesize - 1) + ";");
+  if( not bound.step() ) {
+    forEachLocId(db, preSelectionQuery(req, true, "", limit), callback);
+    return;
+  }
+  const std::string last = std::to_string(bound.columnInt(0));
+  std::size_t found = 0;
+  if( not forEachLocId(db, preSelectionQuery(req, true, "locid <= " + last, limit), 
+        [&](int locid) { found++; return callback(locid); }) )
+    return;
+  if( found >= limit and isPreSelectionExact(req) ) return;
+  forEachLocId(db, preSelectionQuery(req, false, "locid > " + last, 
+        isPreSelectionExact(req) ? limit - found : 0), callback);
+}
+/*
+ * reads a candidate into the same DatasetSpec again and again: the
+ * attributes, and the location and file if needed (e.g. only if the
+ * postselection has conditions on them).
+ */
+class CandidateReader {
+  public:
+  CandidateReader(sqlite3 *db, bool withLocation_) : 
+    withLocation(withLocation_),
+    location(db, "select locname, row, fname, mtime from filelocations inner join files "
+        "on filelocations.fileid = files.fileid where locid = ?;"),
+    attributes(db, "select attrname, " + valueColumn("v.value") + ", type from locattrjunction j "
+        "cross join attrvalues v on v.valueid = j.attrvalid inner join attributes a "
+        "on a.attrid = v.attrid where j.locid = ?;") {}
+  DatasetSpec const & read(int locid) {
+    if( withLocation ) {
+      location.bind(1, locid);
+      if( location.step() ) {
+        dset.datasetname = location.columnText(0);
+        dset.location.row = location.columnInt(1);
+        dset.file = File(location.columnText(2), location.columnInt(3));
+      }
+      location.reset();
+    }
+    dset.attributes.clear();
+    attributes.bind(1, locid);
+    while( attributes.step() )
+      dset.attributes.push_back(attributeFromStrings(attributes.columnText(0), 
+            attributes.columnText(1), attributes.columnText(2)));
+    attributes.reset();
+    return dset;
+  }
+  private:
+  bool withLocation;
+  Statement location, attributes;
+  DatasetSpec dset;
+};
+// the ids of the locations that match the request, not only the candidates
+// of the preselection, up to the limit (0: none). the extrema are only
+// checked for presence if the preselection is not exact:
+void forEachMatchingLocId(sqlite3 *db, Request const & req, std::size_t limit, 
+    std::function<bool(int)> const & callback) {
+  if( isPreSelectionExact(req) ) {
+    forEachLocIdMatching(db, req, limit, callback);
+    return;
+  }
+  PostselectionPlan plan(req);
+  CandidateReader reader(db, not req.dsetrequests.empty() or not req.filerequests.empty());
+  std::size_t n = 0;
+  forEachLocIdMatching(db, req, limit, [&](int locid) {
+    if( not plan.matches(reader.read(locid)) ) return true;
+    return callback(locid) and (limit == 0 or ++n < limit);
+  });
+}
+std::size_t countMatching(sqlite3 *db, Request const & req, std::size_t limit) {
+  std::size_t n = 0;
+  forEachMatchingLocId(db, req, limit, [&n](int) { ++n; return true; });
+  return n;
+}
+// the columns of the facets: name, type, value, locations and files:
+std::vector<Facet> readFacets(Statement & stmt) {
+  std::vector<Facet> res;
+  while( stmt.step() ) {
+    Facet facet;
+    facet.name = stmt.columnText(0);
+    facet.type = stmt.columnText(1);
+    facet.value = stmt.columnText(2);
+    facet.nlocations = stmt.columnInt64(3);
+    facet.nfiles = stmt.columnInt64(4);
+    res.push_back(std::move(facet));
+  }
+  return res;
+}
+}
+std::string getPreSelectionQuery(Request const & req, bool streaming) {
+  return preSelectionQuery(req, streaming, "", req.limit) + ";";
+}
+void forEachLocIdMatchingPreSelection(sqlite3 *db, Request const & req,
+    std::function<bool(int)> const & callback) {
+  forEachLocIdMatching(db, req, req.limit, callback);
+}
+std::vector<int> getLocIdsMatchingPreSelection(sqlite3 *db, Request const & req) {
+  std::vector<int> res;
+  forEachLocIdMatchingPreSelection(db, req, 
+      [&res](int locid) { res.push_back(locid); return true; });
   return res;
 }
 std::vector<std::string> idsToDsetnames(sqlite3 *db,
@@ -442,7 +895,9 @@ DatasetSpec idsToDatasetSpec(sqlite3 *db, int locid) {
   }
   // then get the attributes:
   sstr.clear(); sstr.str("");
-  sstr << "select attrname,value,type from (select * from attributes inner join attrvalues on attributes.attrid = attrvalues.attrid) where valueid in (select attrvalid from locattrjunction where locid = " << locid << ");";
+  // numbers are read back in full precision (sqlite prints 15 digits):
+  sstr << "select attrname," << valueColumn("value") << " as value,"
+          "type from (select * from attributes inner join attrvalues on attributes.attrid = attrvalues.attrid) where valueid in (select attrvalid from locattrjunction where locid = " << locid << ");";
   rc = sqlite3_exec( db, 
       sstr.str().c_str(), insertAttributeCallback, &(res.attributes), &zErrMsg );
   if( rc != SQLITE_OK ) {
@@ -458,5 +913,247 @@ Index idsToIndex(sqlite3 *db, std::vector<int> locids) {
   for( auto locid : locids ) res.push_back(idsToDatasetSpec(db, locid));
   return res;
 }
+Index getMatchingDatasets(sqlite3 *db, Request const & req) {
+  // the extrema need all candidates, unless the database finds them:
+  if( req.limit == 0 or (hasExtrema(req.attrrequests) and not isPreSelectionExact(req)) ) {
+    Index idx = idsToIndex(db, getLocIdsMatchingPreSelection(db, req));
+    filterIndexByPostselectionRulesParallel(idx, req);
+    if( req.limit > 0 and idx.size() > req.limit ) idx.resize(req.limit);
+    return idx;
+  }
+  Index idx;
+  forEachMatchingDataset(db, req, [&idx](DatasetSpec const & dset) { 
+      idx.push_back(dset); return true; });
+  return idx;
+}
+void forEachMatchingDataset(sqlite3 *db, Request const & req, 
+    std::function<bool(DatasetSpec const &)> const & callback) {
+  const bool exact = isPreSelectionExact(req);
+  if( hasExtrema(req.attrrequests) and not exact ) {
+    for( auto const & dset : getMatchingDatasets(db, req) )
+      if( not callback(dset) ) return;
+    return;
+  }
+  PostselectionPlan plan(req);
+  CandidateReader reader(db, true);
+  std::size_t n = 0;
+  forEachLocIdMatching(db, req, req.limit, [&](int locid) {
+    DatasetSpec const & dset = reader.read(locid);
+    if( not exact and not plan.matches(dset) ) return true;
+    return callback(dset) and (req.limit == 0 or ++n < req.limit);
+  });
+}
+std::size_t countMatchingDatasets(sqlite3 *db, Request const & req) {
+  const bool exact = isPreSelectionExact(req);
+  if( exact and req.limit == 0 ) {
+    Statement count(db, "select count(*) from (" + preSelectionQuery(req, false, "", 0) + ");");
+    count.step();
+    return count.columnInt64(0);
+  }
+  // the extrema need all candidates, see getMatchingDatasets:
+  if( not exact and hasExtrema(req.attrrequests) ) return getMatchingDatasets(db, req).size();
+  return countMatching(db, req, req.limit);
+}
+bool existsMatchingDataset(sqlite3 *db, Request const & req) {
+  // the extrema exist if any candidate matches the other conditions:
+  return countMatching(db, req, 1) > 0;
+}
+void startProgress(sqlite3 *db, File const & file) {
+  // the file is added and marked as incomplete by a record without object:
+  exec(db, "savepoint startprogress;");
+  try {
+    Statement insertFile(db, "insert into files(fname, mtime) select ?1, ?2 "
+        "where not exists (select 1 from files where fname = ?1);");
+    insertFile.bind(1, file.filename);
+    insertFile.bind(2, file.mtime);
+    insertFile.step();
+    Statement clear(db, "delete from progress where fileid = (select fileid from files where fname = ?);");
+    clear.bind(1, file.filename);
+    clear.step();
+    Statement insert(db, "insert into progress(fileid, mtime, objname) "
+        "select fileid, ?, null from files where fname = ?;");
+    insert.bind(1, file.mtime);
+    insert.bind(2, file.filename);
+    insert.step();
+  } catch (...) {
+    sqlite3_exec(db, "rollback to startprogress; release startprogress;", NULL, NULL, NULL);
+    throw;
+  }
+  exec(db, "release startprogress;");
+}
+void addProgress(sqlite3 *db, File const & file, std::vector<std::string> const & objects) {
+  if( objects.empty() ) return;
+  exec(db, "savepoint addprogress;");
+  try {
+    Statement insert(db, "insert into progress(fileid, mtime, objname) "
+        "select fileid, ?, ? from files where fname = ?;");
+    for( auto const & obj : objects ) {
+      insert.bind(1, file.mtime);
+      insert.bind(2, obj);
+      insert.bind(3, file.filename);
+      insert.step();
+      insert.reset();
+    }
+  } catch (...) {
+    sqlite3_exec(db, "rollback to addprogress; release addprogress;", NULL, NULL, NULL);
+    throw;
+  }
+  exec(db, "release addprogress;");
+}
+bool getProgress(sqlite3 *db, File const & file, std::set<std::string> & objects) {
+  objects.clear();
+  if( not hasTable(db, "progress") ) return false;
+  Statement stmt(db, "select mtime, objname from progress where fileid = "
+      "(select fileid from files where fname = ?);");
+  stmt.bind(1, file.filename);
+  bool found = false;
+  while( stmt.step() ) {
+    // the progress of another version of the file is useless:
+    if( stmt.columnInt(0) != file.mtime ) {
+      objects.clear();
+      return false;
+    }
+    found = true;
+    if( not stmt.columnIsNull(1) ) objects.insert(stmt.columnText(1));
+  }
+  return found;
+}
+void finishProgress(sqlite3 *db, File const & file) {
+  Statement stmt(db, "delete from progress where fileid = (select fileid from files where fname = ?);");
+  stmt.bind(1, file.filename);
+  stmt.step();
+}
+std::set<std::string> listIncompleteFiles(sqlite3 *db) {
+  std::set<std::string> files;
+  if( not hasTable(db, "progress") ) return files;
+  Statement stmt(db, "select distinct fname from files inner join progress on files.fileid = progress.fileid;");
+  while( stmt.step() ) files.insert(stmt.columnText(0));
+  return files;
+}
+void updateFileInfo(sqlite3 *db, File const & file, FileHelpers::Fingerprint const & fp) {
+  Statement stmt(db, "update files set mtime = ?, size = ?, hash = ? where fname = ?;");
+  stmt.bind(1, file.mtime);
+  stmt.bind(2, (sqlite3_int64)fp.size);
+  stmt.bind(3, (sqlite3_int64)fp.hash);
+  stmt.bind(4, file.filename);
+  stmt.step();
+}
+bool getFingerprint(sqlite3 *db, std::string const & filename, FileHelpers::Fingerprint & fp) {
+  Statement stmt(db, "select size, hash from files where fname = ? and size is not null;");
+  stmt.bind(1, filename);
+  if( not stmt.step() ) return false;
+  fp.size = stmt.columnInt64(0);
+  fp.hash = (std::uint64_t)stmt.columnInt64(1);
+  return true;
+}
+void rebuildStatistics(sqlite3 *db) {
+  exec(db, "savepoint rebuildstatistics;"
+      "delete from filevaluestats;"
+      "insert into filevaluestats(fileid, valueid, count) "
+        "select l.fileid, j.attrvalid, count(*) from locattrjunction j "
+        "join filelocations l on l.locid = j.locid group by l.fileid, j.attrvalid;"
+      "delete from valuestats;"
+      "insert into valuestats(valueid, count, nfiles) "
+        "select valueid, sum(count), count(*) from filevaluestats group by valueid;"
+      "delete from attrstats;"
+      "insert into attrstats(attrid, nlocations, ndistinct, minvalue, maxvalue) "
+        "select v.attrid, sum(s.count), count(*), min(v.value), max(v.value) from attrvalues v "
+        "join valuestats s on s.valueid = v.valueid where s.count > 0 group by v.attrid;"
+      "release rebuildstatistics;");
+}
+std::vector<AttributeStats> getAttributeStats(sqlite3 *db) {
+  std::vector<AttributeStats> res;
+  if( not hasTable(db, "attrstats") ) return res;
+  Statement stmt(db, "select attrname, type, nlocations, ndistinct, " + valueColumn("minvalue") + ", "
+      + valueColumn("maxvalue") + " from attributes a join attrstats s on s.attrid = a.attrid "
+      "order by attrname;");
+  while( stmt.step() ) {
+    AttributeStats stats;
+    stats.name = stmt.columnText(0);
+    stats.type = stmt.columnText(1);
+    stats.nlocations = stmt.columnInt64(2);
+    stats.ndistinct = stmt.columnInt64(3);
+    stats.min = stmt.columnText(4);
+    stats.max = stmt.columnText(5);
+    res.push_back(std::move(stats));
+  }
+  return res;
+}
+std::vector<Facet> getFacets(sqlite3 *db, std::string const & attrname) {
+  if( not hasTable(db, "filevaluestats") ) return std::vector<Facet>();
+  Statement stmt(db, "select a.attrname, a.type, " + valueColumn("v.value") + ", s.count, s.nfiles "
+      "from valuestats s join attrvalues v on v.valueid = s.valueid join attributes a on a.attrid = v.attrid "
+      "where s.count > 0 and (?1 = '' or a.attrname = ?1) order by a.attrname, s.count desc, v.value;");
+  stmt.bind(1, attrname);
+  return readFacets(stmt);
+}
+std::vector<Facet> getFacets(sqlite3 *db, std::string const & attrname, Request const & req) {
+  // the matching locations are collected in a temporary table:
+  exec(db, "create temp table if not exists facetlocations(locid integer primary key);"
+      "delete from temp.facetlocations;");
+  if( isPreSelectionExact(req) ) {
+    exec(db, "insert into temp.facetlocations(locid) " + preSelectionQuery(req, false, "", req.limit) + ";");
+  } else if( hasExtrema(req.attrrequests) ) {
+    // the extrema need all candidates, see getMatchingDatasets:
+    Statement insert(db, "insert or ignore into temp.facetlocations(locid) select locid from filelocations "
+        "where fileid = (select fileid from files where fname = ?) and locname = ? and row = ?;");
+    for( auto const & dset : getMatchingDatasets(db, req) ) {
+      insert.bind(1, dset.file.filename);
+      insert.bind(2, dset.datasetname);
+      insert.bind(3, dset.location.row);
+      insert.step();
+      insert.reset();
+    }
+  } else {
+    Statement insert(db, "insert into temp.facetlocations(locid) values(?);");
+    forEachMatchingLocId(db, req, req.limit, [&insert](int locid) {
+      insert.bind(1, locid);
+      insert.step();
+      insert.reset();
+      return true;
+    });
+  }
+  Statement stmt(db, "select a.attrname, a.type, " + valueColumn("v.value") + ", count(*), "
+      "count(distinct l.fileid) from temp.facetlocations m join filelocations l on l.locid = m.locid "
+      "join locattrjunction j on j.locid = m.locid join attrvalues v on v.valueid = j.attrvalid "
+      "join attributes a on a.attrid = v.attrid where ?1 = '' or a.attrname = ?1 "
+      "group by v.valueid order by a.attrname, count(*) desc, v.value;");
+  stmt.bind(1, attrname);
+  return readFacets(stmt);
+}
+std::vector<std::pair<std::string, long long>> getValueFrequencies(sqlite3 *db, std::string const & attrname) {
+  std::vector<std::pair<std::string, long long>> res;
+  if( not hasTable(db, "valuestats") ) return res;
+  Statement stmt(db, "select " + valueColumn("v.value") + ", s.count from attrvalues v "
+      "join valuestats s on s.valueid = v.valueid where s.count > 0 and "
+      "v.attrid = (select attrid from attributes where attrname = ?) order by s.count desc, v.value;");
+  stmt.bind(1, attrname);
+  while( stmt.step() ) res.push_back({stmt.columnText(0), stmt.columnInt64(1)});
+  return res;
+}
+long long estimateMatches(sqlite3 *db, AttributeRequest const & req) {
+  if( not hasTable(db, "valuestats") ) return -1;
+  // the same conditions as in the preselection:
+  Statement stmt(db, "select coalesce(sum(s.count), 0) from attrvalues "
+      "join valuestats s on s.valueid = attrvalues.valueid where " 
+      + req.getSqlValueDescription("value") + " and attrvalues.attrid in "
+      "(select attrid from attributes where " + req.getSqlKeyDescription("attrname") + ");");
+  stmt.step();
+  return stmt.columnInt64(0);
+}
+void orderBySelectivity(sqlite3 *db, Request & req) {
+  if( req.attrrequests.size() < 2 or not hasTable(db, "valuestats") ) return;
+  std::vector<std::pair<long long, std::size_t>> estimates;
+  // the extrema are relative to all other conditions and stay last:
+  for( auto i = 0u; i < req.attrrequests.size(); ++i )
+    estimates.push_back({req.attrrequests[i].getSqlAggregate() ? std::numeric_limits<long long>::max()
+        : estimateMatches(db, req.attrrequests[i]), i});
+  // ties keep the order of the request:
+  std::sort(estimates.begin(), estimates.end());
+  std::vector<AttributeRequest> ordered;
+  for( auto const & estimate : estimates )
+    ordered.push_back(std::move(req.attrrequests[estimate.second]));
+  req.attrrequests = std::move(ordered);
+}
 } // sqlite_helpers
 } // rqcd_file_index
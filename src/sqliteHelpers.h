@@ -6,22 +6,110 @@
 #define __SQLITEHELPERS_H__
 #include <sqlite3.h>
 #include <string>
+#include <functional>
+#include <set>
 #include "attributes.h"
 #include "indexHdf5.h"
+#include "filehelpers.h"
 
 namespace rqcd_file_index {
 namespace sqlite_helpers {
 void prepareSqliteFile(sqlite3 * db);
 File getFile(sqlite3 *db, std::string const & file);
 void removeFile(sqlite3 *db, std::string const & file);
+void removeFiles(sqlite3 *db, std::vector<std::string> const & files);
 std::vector<File> listFiles(sqlite3* db);
 std::vector<std::pair<std::string, std::string>> listAttributes(sqlite3* db);
 void insertDataset(sqlite3 *db, Index const & idx);
+// the changes of the helpers between begin and commit are kept or dropped
+// together:
+void beginTransaction(sqlite3 *db);
+void commitTransaction(sqlite3 *db);
+void rollbackTransaction(sqlite3 *db);
 DatasetSpec idsToDatasetSpec(sqlite3 *db, int locid);
 std::vector<std::string> idsToDsetnames(sqlite3 *db, std::vector<int> const & locids);
 std::vector<std::string> idsToFilenames(sqlite3 *db, std::vector<int> const & locids);
+// true if the preselection selects exactly the matching datasets, such that
+// the postselection does not remove any of them:
+bool isPreSelectionExact(Request const & req);
+// streaming checks the locations one by one in their order instead of
+// collecting the matching ones first, which finds frequent matches quickly:
+std::string getPreSelectionQuery(Request const & req, bool streaming = false);
 std::vector<int> getLocIdsMatchingPreSelection(sqlite3 *db, Request const & req);
+// streams the matching ids to callback as they are found. the callback returns
+// false to stop the query early. with a limit, the first locations are
+// streamed, the rest collected.
+void forEachLocIdMatchingPreSelection(sqlite3 *db, Request const & req,
+    std::function<bool(int)> const & callback);
 Index idsToIndex(sqlite3 *db, std::vector<int> locids);
+/*
+ * the datasets matching the request, in the order of the preselection. with
+ * a limit, the candidates are hydrated and postselected one by one as they
+ * are found, until enough of them match (the limit is passed to the database
+ * if there is no postselection). without, all candidates are hydrated first
+ * and postselected in parallel.
+ */
+Index getMatchingDatasets(sqlite3 *db, Request const & req);
+// passes the matching datasets to callback one after the other as they are
+// found, each read and postselected on its own. the callback returns false
+// to stop the query early:
+void forEachMatchingDataset(sqlite3 *db, Request const & req, 
+    std::function<bool(DatasetSpec const &)> const & callback);
+/*
+ * the number of datasets matching the request (at most the limit), and if
+ * there is one. the database counts them if the preselection is exact,
+ * otherwise the candidates are postselected one by one as they are found,
+ * without collecting them.
+ */
+std::size_t countMatchingDatasets(sqlite3 *db, Request const & req);
+bool existsMatchingDataset(sqlite3 *db, Request const & req);
 int getFileModificationTime(sqlite3 *db, std::string const & filename);
+/*
+ * progress of indexing a file, such that an interrupted run can be resumed:
+ * the objects directly below the root whose datasets are all in the database.
+ * files with progress records are incomplete.
+ */
+void startProgress(sqlite3 *db, File const & file);
+void addProgress(sqlite3 *db, File const & file, std::vector<std::string> const & objects);
+// false if there is no interrupted run for this version of the file:
+bool getProgress(sqlite3 *db, File const & file, std::set<std::string> & objects);
+void finishProgress(sqlite3 *db, File const & file);
+std::set<std::string> listIncompleteFiles(sqlite3 *db);
+// stores the modification time and fingerprint of an indexed file:
+void updateFileInfo(sqlite3 *db, File const & file, FileHelpers::Fingerprint const & fp);
+// false if no fingerprint is stored for the file:
+bool getFingerprint(sqlite3 *db, std::string const & filename, FileHelpers::Fingerprint & fp);
+/*
+ * statistics of the attributes, kept up to date by insertDataset and
+ * removeFiles: the number of locations with each attribute value, and per
+ * attribute the number of locations, of distinct values and their range.
+ */
+struct AttributeStats {
+  std::string name, type;
+  long long nlocations = 0, ndistinct = 0;
+  std::string min, max;
+};
+void rebuildStatistics(sqlite3 *db);
+std::vector<AttributeStats> getAttributeStats(sqlite3 *db);
+// the values of the attribute with their number of locations, most frequent first:
+std::vector<std::pair<std::string, long long>> getValueFrequencies(sqlite3 *db, std::string const & attrname);
+/*
+ * the facets of the attributes: their values with the number of locations
+ * and of files, by attribute and most frequent first. for the whole index
+ * they are kept up to date with the statistics, for the datasets matching a
+ * request they are counted among the matching locations.
+ */
+struct Facet {
+  std::string name, type, value;
+  long long nlocations = 0, nfiles = 0;
+};
+// the facets of all attributes for an empty attrname:
+std::vector<Facet> getFacets(sqlite3 *db, std::string const & attrname = "");
+std::vector<Facet> getFacets(sqlite3 *db, std::string const & attrname, Request const & req);
+// the number of locations matching the request, -1 without statistics:
+long long estimateMatches(sqlite3 *db, AttributeRequest const & req);
+// sorts the attribute requests such that the most selective come first, for
+// both the preselection and the postselection:
+void orderBySelectivity(sqlite3 *db, Request & req);
 }}
 #endif
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#include "table.h"
+#include <stdexcept>
+
+namespace rqcd_file_index {
+Value TableColumn::valueAt(std::size_t row) const {
+  switch( type ) {
+    case Type::NUMERIC: return Value(numbers[row]);
+    case Type::BOOLEAN: return Value(booleans[row] != 0);
+    case Type::STRING:  return Value(strings[row]);
+    case Type::ARRAY: {
+      std::vector<Value> elems;
+      elems.reserve(width);
+      for( std::size_t i = row*width; i < (row+1)*width; ++i )
+        elems.push_back(Value(numbers[i]));
+      return arrayFromElements(std::move(elems));
+    }
+    default: throw std::runtime_error("TableColumn: unknown column type.");
+  }
+}
+} //rqcd_file_index
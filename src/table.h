@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2016 by Jakob Simeth
+ * Licensed under MIT License. See LICENSE in the root directory.
+ */
+#ifndef __TABLE_H__
+#define __TABLE_H__
+#include <vector>
+#include <string>
+#include <ostream>
+#include "value.h"
+
+namespace rqcd_file_index {
+/*
+ * a column of a table, holding the field of all rows in one typed container:
+ *   numeric:  numbers[row]
+ *   boolean:  booleans[row]
+ *   string:   strings[row]
+ *   array:    numbers[row*width ... (row+1)*width - 1] (one-dimensional
+ *             numeric arrays of fixed width)
+ */
+struct TableColumn {
+  TableColumn(std::string const & colname, Type const & coltype, std::size_t colwidth = 1) :
+    name(colname), type(coltype), width(colwidth) {}
+  std::string name;
+  Type type;
+  std::size_t width;
+  std::vector<double> numbers;
+  std::vector<char> booleans;
+  std::vector<std::string> strings;
+  Value valueAt(std::size_t row) const;
+};
+/*
+ * a table describing the rows of a dataset: the values of row i are the
+ * attributes of the i-th row of the dataset.
+ */
+struct Table {
+  std::size_t nrows = 0;
+  std::vector<TableColumn> columns;
+};
+} //rqcd_file_index
+#endif
@@ -8,6 +8,18 @@
 #include "postselection.h"
 #include "conditions.h"
 #include "indexHdf5.h"
+#include "hdf5ReaderGeneric.h"
+#include "boundedQueue.h"
+#include "conversionKernels.h"
+#include "sqliteHelpers.h"
+#include "pipeline.h"
+#include "parseJson.h"
+#include "indexFormats.h"
+#include <thread>
+#include <set>
+#include <cstdio>
+#include <unistd.h>
+#include <limits>
 int itest = 0;
 #define SIMPLETEST( msg, code, condition ) \
   {\
@@ -134,6 +146,12 @@ int main( int argc, char** argv ) {
 
     std::string dsetspecstring = "{\"attributes\": {\"exampleattr\": {\"c\": 3,\"map\": {\"a\": 1,\"b\": 2}}, \"one\": 1, \"two\": 2}, \"datasetname\": \"exampleDset\", \"file\": {\"filename\": \"/some/path/to/a/file.h5\", \"mtime\": 1400000}, \"location\": {\"row\": -1}}";
     SIMPLETEST( "can write and read back in dsetspec: ", DatasetSpec dset(dsetSpecFromString(dsetspecstring)), dset == dsetspec );
+    std::vector<Value> elems;
+    for( int i = 0; i < 12; i++ ) elems.push_back(Value(i));
+    SIMPLETEST( "array from elements has string keys: ", Value arr(arrayFromElements(elems)),
+        arr.getMap().size() == 12 && arr.getMap().at("11") == 11 && arr.getMap().at("2") == 2);
+    SIMPLETEST( "bool attribute is read back from database representation: ", 
+        Attribute boolattr(attributeFromStrings("flag", "1", "bool")), boolattr.getValue() == Value(true));
     /* could make test out of this: 
      * Index idx = {dsetspec, otherdsetspec};
      * std::cout << idx << std::endl;
@@ -149,43 +167,771 @@ int main( int argc, char** argv ) {
   SIMPLETEST( "attribute is matched by equals-condition", ,equals4.matches(attr, "test"));
   auto areq = AttributeRequest("test", equals4);
   SIMPLETEST( "attributerequest matches attribute", ,areq.matches(attr));
+  SIMPLETEST( "max-condition matches smaller values only?", auto max4 = AttributeConditions::Max(4);,
+      max4.matches(Attribute("test", 3), "test") and not max4.matches(Attribute("test", 5), "test"));
+  {
+    // a table column may repeat the name of an attribute of its group:
+    Index planidx{
+      DatasetSpec({Attribute("hpe", 1), Attribute("kappa", 0.1), Attribute("hpe", 2)}, "/a", File("f.h5", 0), DatasetChunkSpec(0)),
+      DatasetSpec({Attribute("hpe", 1), Attribute("kappa", 0.2), Attribute("hpe", 3)}, "/b", File("f.h5", 0), DatasetChunkSpec(1)),
+      DatasetSpec({Attribute("kappa", 0.1), Attribute("hpe", 2)}, "/c", File("f.h5", 0), DatasetChunkSpec(-1)),
+      DatasetSpec({Attribute("kappa", 0.1)}, "/d", File("f.h5", 0), DatasetChunkSpec(-1))};
+    Request planreq;
+    planreq.attrrequests.push_back(AttributeRequest("hpe", AttributeConditions::Equals(2)));
+    planreq.attrrequests.push_back(AttributeRequest("kappa", AttributeConditions::Min(0.1)));
+    PostselectionPlan plan(planreq);
+    SIMPLETEST( "compiled plan checks all attributes of a name?", ,
+        plan.matches(planidx[0]) and not plan.matches(planidx[1]) and plan.matches(planidx[2]) 
+        and not plan.matches(planidx[3]));
+    filterIndexByPostselectionRules(planidx, planreq);
+    SIMPLETEST( "index is filtered by the compiled plan?", ,
+        planidx.size() == 2 and planidx[0].datasetname == "/a" and planidx[1].datasetname == "/c");
+    Index bigidx;
+    for( int i = 0; i < 10000; ++i )
+      bigidx.push_back(DatasetSpec({Attribute("hpe", i % 3), Attribute("kappa", 0.1)}, 
+            "/" + std::to_string(i), File("f.h5", 0), DatasetChunkSpec(-1)));
+    Index seqidx = bigidx;
+    filterIndexByPostselectionRules(seqidx, planreq);
+    filterIndexByPostselectionRulesParallel(bigidx, planreq, 4);
+    SIMPLETEST( "parallel postselection keeps the same datasets in order?", ,
+        bigidx.size() == 3333 and seqidx.size() == bigidx.size() 
+        and std::equal(seqidx.begin(), seqidx.end(), bigidx.begin(), 
+          [](DatasetSpec const & a, DatasetSpec const & b) { return a.datasetname == b.datasetname; }));
+  }
+  {
+    std::vector<double> vals(203);
+    for( auto i = 0u; i < vals.size(); ++i ) vals[i] = 0.5 * (i % 17);
+    vals[5] = std::numeric_limits<double>::quiet_NaN();
+    bool agree = true;
+    for( auto level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2} ) {
+      if( level > detectSimdLevel() ) break;
+      std::vector<std::uint64_t> mask(4, 0);
+      selectInterval(vals.data(), vals.size(), 1., 2.5, mask.data(), level);
+      for( auto i = 0u; i < 4*64; ++i )
+        agree &= ((mask[i/64] >> (i % 64)) & 1) == (i < vals.size() and vals[i] >= 1. and vals[i] <= 2.5);
+    }
+    SIMPLETEST( "selection kernels agree on intervals?", , agree);
+    // numeric conditions on columns, with missing, non-numeric and repeated
+    // attributes:
+    Index colidx;
+    for( int i = 0; i < 3000; ++i ) {
+      std::vector<Attribute> attrs{Attribute("conf", i)};
+      if( i % 7 != 0 ) attrs.push_back(Attribute("kappa", 0.01 * (i % 13)));
+      if( i % 11 == 0 ) attrs.push_back(Attribute("kappa", "none"));
+      if( i % 101 == 0 ) attrs.push_back(Attribute("conf", 5));
+      colidx.push_back(DatasetSpec(attrs, "/" + std::to_string(i), File("f.h5", 0), DatasetChunkSpec(-1)));
+    }
+    Request colreq;
+    colreq.attrrequests.push_back(AttributeRequest("kappa", AttributeConditions::Range(0.03, 0.08)));
+    colreq.attrrequests.push_back(AttributeRequest("conf", AttributeConditions::Or({5, 17, 100, 101, 2020})));
+    colreq.attrrequests.push_back(AttributeRequest("conf", AttributeConditions::Max(2500)));
+    PostselectionPlan colplan(colreq);
+    Index expected;
+    for( auto const & dset : colidx ) if( colplan.matches(dset) ) expected.push_back(dset);
+    filterIndexByPostselectionRules(colidx, colreq);
+    SIMPLETEST( "numeric conditions on columns select the same datasets?", , 
+        not expected.empty() and colidx.size() == expected.size() 
+        and std::equal(colidx.begin(), colidx.end(), expected.begin(), 
+          [](DatasetSpec const & a, DatasetSpec const & b) { return a.datasetname == b.datasetname; }));
+  }
   
   
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Reductions                                  ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    using rqcd_hdf5_reader_generic::AverageAccumulator;
+    typedef std::complex<double> cplx;
+    AverageAccumulator acc;
+    acc.add({cplx(1., 2.), cplx(3., 4.)});
+    acc.add({cplx(3., 0.), cplx(5., -4.)});
+    SIMPLETEST( "average of two hits is correct?", auto avg = acc.average(), 
+        acc.count() == 2 and avg.size() == 2 and avg[0] == cplx(2., 1.) and avg[1] == cplx(4., 0.) );
+    SHOULDTHROWTEST( "averaging hits of different length throws?", acc.add({cplx(1., 1.)}); );
+    SHOULDTHROWTEST( "average without hits throws?", AverageAccumulator empty; empty.average(); );
+  }
+
+  {
+    using rqcd_hdf5_reader_generic::convertToDouble;
+    // seven values: exercises the vectorized part and the remainder
+    float f[7] = {1.5f, -2.f, 3.f, 4.25f, 5.f, -6.f, 7.f};
+    std::int32_t i32[7] = {1, -2, 3, 4, 5, -6, 7};
+    std::int64_t i64[7] = {1, -2, 3, 4, 5, -6, 10000000000ll};
+    double out[7];
+    SIMPLETEST( "float32 to double conversion is exact?", convertToDouble(f, out, 7), 
+        out[0] == 1.5 and out[3] == 4.25 and out[5] == -6. and out[6] == 7. );
+    SIMPLETEST( "int32 to double conversion is exact?", convertToDouble(i32, out, 7), 
+        out[1] == -2. and out[4] == 5. and out[6] == 7. );
+    SIMPLETEST( "int64 to double conversion is exact?", convertToDouble(i64, out, 7), 
+        out[5] == -6. and out[6] == 1e10 );
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Bounded queue                               ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    BoundedQueue<int> queue(4);
+    std::thread producer([&queue]() { 
+        for( int i = 1; i <= 1000; ++i ) queue.push(std::move(i));
+        queue.close(); });
+    long sum = 0; int elem;
+    while( queue.pop(elem) ) sum += elem;
+    producer.join();
+    SIMPLETEST( "all elements are passed through a small queue?", , sum == 500500 );
+  }
+  {
+    BoundedQueue<int> queue(2);
+    int pushed = 0;
+    std::thread producer([&queue, &pushed]() { 
+        for( int i = 0; i < 1000; ++i ) { if( not queue.push(std::move(i)) ) break; pushed++; } });
+    int elem;
+    queue.pop(elem);
+    queue.close();
+    producer.join();
+    SIMPLETEST( "closing the queue from the consumer side stops the producer?", , pushed < 1000 );
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Split by table                              ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    Table table;
+    table.nrows = 2;
+    table.columns.push_back(TableColumn("hpe", Type::NUMERIC));
+    table.columns.back().numbers = {4, 5};
+    table.columns.push_back(TableColumn("mom", Type::ARRAY, 3));
+    table.columns.back().numbers = {0, 0, 1, 1, 1, 1};
+    table.columns.push_back(TableColumn("smeared", Type::BOOLEAN));
+    table.columns.back().booleans = {0, 1};
+    DatasetSpec dset({Attribute("one", 1)}, "/group/data", File("file.h5", 0), DatasetChunkSpec(-1));
+    Index splitidx = splitDsetSpecWithTable(dset, table);
+    SIMPLETEST("dataset is split into one dataset per row?", , splitidx.size() == 2 
+        && splitidx[1].location.row == 1 && splitidx[1].attributes.size() == 4);
+    std::map<std::string, Value> mom; mom.insert({"0", 1}); mom.insert({"1", 1}); mom.insert({"2", 1});
+    SIMPLETEST("rows hold the values of all columns?", , splitidx[1].attributes[1] == Attribute("hpe", 5)
+        && splitidx[1].attributes[2] == Attribute("mom", Value(mom))
+        && splitidx[1].attributes[3] == Attribute("smeared", true));
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| File access profiles                        ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    using namespace H5DataHelpers;
+    bool roundtrip = true;
+    for( auto const & name : {"default", "metadata", "sieve", "core", "bigcache"} )
+      roundtrip &= (fileAccessProfileToString(fileAccessProfileFromString(name)) == name);
+    SIMPLETEST("profile names are parsed?", , roundtrip);
+    SHOULDTHROWTEST("unknown profile throws?", fileAccessProfileFromString("lustre"); );
+    SIMPLETEST("core profile uses the core driver?", hid_t fapl = createFileAccessPropertyList(FileAccessProfile::CORE),
+        H5Pget_driver(fapl) == H5FD_CORE && H5Pclose(fapl) >= 0);
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Direct reads                                ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    // the same 3x4 doubles contiguous (read with pread) and chunked (H5Dread):
+    const std::string fname("direct_testdata.h5");
+    hid_t file = H5Fcreate(fname.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    hsize_t dims[2] = {3, 4};
+    double data[12];
+    for( int i = 0; i < 12; ++i ) data[i] = 0.5*i;
+    hid_t space = H5Screate_simple(2, dims, NULL);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, 2, dims);
+    for( auto name : {"contiguous", "chunked"} ) {
+      hid_t dset = H5Dcreate2(file, name, H5T_IEEE_F64LE, space, H5P_DEFAULT, 
+          std::string(name) == "chunked" ? dcpl : H5P_DEFAULT, H5P_DEFAULT);
+      H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+      H5Dclose(dset);
+    }
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Fclose(file);
+    rqcd_hdf5_reader_generic::H5ReaderGeneric reader(fname);
+    DatasetSpec all({}, "/contiguous", File(fname), DatasetChunkSpec(-1));
+    DatasetSpec row({}, "/contiguous", File(fname), DatasetChunkSpec(2));
+    auto direct = reader.read(all);
+    auto directrow = reader.read(row);
+    all.datasetname = row.datasetname = "/chunked";
+    SIMPLETEST("contiguous doubles are read directly?", , reader.readsDirectly("/contiguous") 
+        and not reader.readsDirectly("/chunked"));
+    SIMPLETEST("direct reads give the same data?", , direct.size() == 6 
+        and direct[5] == std::complex<double>(5., 5.5) and direct == reader.read(all)
+        and directrow.size() == 2 and directrow[0] == std::complex<double>(4., 4.5) 
+        and directrow == reader.read(row));
+    row.datasetname = "/contiguous";
+    row.location.row = 3;
+    SHOULDTHROWTEST("direct reads of missing rows throw?", reader.read(row));
+    std::remove(fname.c_str());
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Parallel indexing                           ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    // four top-level groups with two datasets each, and one dataset in the root:
+    const std::string fname("parallel_testdata.h5");
+    hid_t file = H5Fcreate(fname.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    hsize_t dims = 2;
+    double data[2] = {1., 0.};
+    hid_t space = H5Screate_simple(1, &dims, NULL);
+    hid_t scalar = H5Screate(H5S_SCALAR);
+    for( int i = 0; i < 4; i++ ) {
+      hid_t group = H5Gcreate2(file, ("g" + std::to_string(i)).c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      hid_t attr_id = H5Acreate2(group, "x", H5T_NATIVE_INT, scalar, H5P_DEFAULT, H5P_DEFAULT);
+      H5Awrite(attr_id, H5T_NATIVE_INT, &i);
+      H5Aclose(attr_id);
+      for( auto name : {"a", "b"} ) {
+        hid_t dset = H5Dcreate2(group, name, H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+        H5Dclose(dset);
+      }
+      H5Gclose(group);
+    }
+    hid_t dset = H5Dcreate2(file, "rootdata", H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    H5Dclose(dset);
+    H5Sclose(scalar);
+    H5Sclose(space);
+    H5Fclose(file);
+
+    TraversalStats counted;
+    Index sequential = indexHdf5File(fname, &counted);
+    // 4 groups with one attribute each and 9 datasets: the info of the 13
+    // objects, opening, iterating and closing each group, and opening,
+    // reading the type and the space, reading and closing each attribute:
+    SIMPLETEST("traversal statistics count the objects?", , counted.objects == 13 and counted.groups == 4
+        and counted.datasets == 9 and counted.tables == 0 and counted.attributes == 4 
+        and counted.metadataOperations == 45 and counted.skipped == 0);
+    Index parallel = indexHdf5FileParallel(fname, 3);
+    bool equal = (sequential.size() == parallel.size());
+    for( std::size_t i = 0; equal and i < sequential.size(); ++i )
+      equal &= (sequential[i] == parallel[i]);
+    SIMPLETEST("parallel indexing gives the same index?", , equal and sequential.size() == 9);
+
+    // written to the database in batches of two datasets:
+    sqlite3 *db;
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    std::size_t nstreamed = indexPipelined(db, fname, nullptr, H5DataHelpers::FileAccessProfile::DEFAULT, TraversalOptions(), false, 1, 2, 1);
+    Index stored = sqlite_helpers::idsToIndex(db, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+    sqlite3_close(db);
+    equal = (nstreamed == sequential.size() and stored.size() == sequential.size());
+    for( std::size_t i = 0; equal and i < sequential.size(); ++i )
+      equal &= (stored[i].datasetname == sequential[i].datasetname
+                and stored[i].attributes.size() == sequential[i].attributes.size());
+    SIMPLETEST("streamed index is stored completely?", , equal);
+
+    // the same from three workers, in the order in which they finish:
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    nstreamed = indexPipelined(db, fname, nullptr, H5DataHelpers::FileAccessProfile::DEFAULT, TraversalOptions(), false, 3, 2, 1);
+    stored = sqlite_helpers::idsToIndex(db, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+    std::set<std::string> storednames, sequentialnames;
+    for( auto const & s : stored ) storednames.insert(s.datasetname);
+    for( auto const & s : sequential ) sequentialnames.insert(s.datasetname);
+    SIMPLETEST("index streamed from workers is stored completely?", , nstreamed == sequential.size() 
+        and storednames == sequentialnames and sqlite_helpers::listIncompleteFiles(db).empty());
+    sqlite3_close(db);
+
+    // an interrupted run that has written g0 and g1:
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    sqlite_helpers::startProgress(db, File(fname));
+    sqlite_helpers::addProgress(db, File(fname), {"g0", "g1"});
+    nstreamed = indexPipelined(db, fname, nullptr, H5DataHelpers::FileAccessProfile::DEFAULT, TraversalOptions(), true);
+    SIMPLETEST("resuming skips the completed groups?", , nstreamed == 5 
+        and sqlite_helpers::listIncompleteFiles(db).empty());
+    sqlite3_close(db);
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    sqlite_helpers::startProgress(db, File(fname));
+    sqlite_helpers::addProgress(db, File(fname), {"g0", "g1"});
+    nstreamed = indexPipelined(db, fname, nullptr, H5DataHelpers::FileAccessProfile::DEFAULT, TraversalOptions(), true, 2);
+    SIMPLETEST("resuming with workers skips the completed groups?", , nstreamed == 5 
+        and sqlite_helpers::listIncompleteFiles(db).empty());
+    sqlite3_close(db);
+
+    // an interrupted run of an older version of the file has written g0:
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    File older(fname);
+    older.mtime -= 1;
+    sqlite_helpers::startProgress(db, older);
+    sqlite_helpers::insertDataset(db, {DatasetSpec({Attribute("x", 7)}, "/g0/stale", older, DatasetChunkSpec(0))});
+    sqlite_helpers::addProgress(db, older, {"g0"});
+    nstreamed = indexPipelined(db, fname, nullptr, H5DataHelpers::FileAccessProfile::DEFAULT, TraversalOptions(), true);
+    SIMPLETEST("a changed file is indexed again without the stale datasets?", , nstreamed == 9
+        and sqlite_helpers::countMatchingDatasets(db, queryToRequest(R"({"attributes": {"x": 7}})")) == 0
+        and sqlite_helpers::countMatchingDatasets(db, queryToRequest(R"({"attributes": {"x": {"min": 0}}})")) == 8
+        and sqlite_helpers::listIncompleteFiles(db).empty());
+
+    // the file is replaced in one transaction, by the writer thread:
+    sqlite_helpers::beginTransaction(db);
+    sqlite_helpers::removeFile(db, fname);
+    nstreamed = indexPipelined(db, fname, nullptr, H5DataHelpers::FileAccessProfile::DEFAULT, TraversalOptions(), false, 1, 2, 1);
+    sqlite_helpers::commitTransaction(db);
+    SIMPLETEST("replacements in a transaction are committed?", , nstreamed == 9
+        and sqlite_helpers::countMatchingDatasets(db, queryToRequest(R"({"attributes": {"x": {"min": 0}}})")) == 8);
+    // a replacement of the file that fails is rolled back:
+    sqlite_helpers::beginTransaction(db);
+    sqlite_helpers::removeFile(db, fname);
+    sqlite_helpers::startProgress(db, File(fname));
+    sqlite_helpers::insertDataset(db, {DatasetSpec({Attribute("x", 7)}, "/g0/partial", File(fname), DatasetChunkSpec(0))});
+    sqlite_helpers::rollbackTransaction(db);
+    SIMPLETEST("rolled back replacements keep the previous index?", , 
+        sqlite_helpers::countMatchingDatasets(db, queryToRequest(R"({"attributes": {"x": 7}})")) == 0
+        and sqlite_helpers::countMatchingDatasets(db, queryToRequest(R"({"attributes": {"x": {"min": 0}}})")) == 8
+        and sqlite_helpers::getAttributeStats(db).size() == 1
+        and sqlite_helpers::listIncompleteFiles(db).empty());
+    sqlite3_close(db);
+
+    // a named datatype is no supported object:
+    const auto fingerprint = FileHelpers::getFingerprint(fname);
+    SIMPLETEST("fingerprint of a file is stable?", , fingerprint.size > 0 
+        and fingerprint == FileHelpers::getFingerprint(fname));
+    file = H5Fopen(fname.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    hid_t dtype = H5Tcopy(H5T_NATIVE_INT);
+    H5Tcommit2(file, "type", dtype, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Tclose(dtype);
+    H5Fclose(file);
+    SIMPLETEST("fingerprint changes with the contents?", , not (fingerprint == FileHelpers::getFingerprint(fname))
+        and FileHelpers::getFingerprint("does_not_exist.h5").size == -1);
+    SHOULDTHROWTEST("unsupported objects fail the traversal?", indexHdf5File(fname));
+    TraversalOptions skipping;
+    skipping.skipUnsupported = true;
+    std::vector<std::string> skipped;
+    skipping.onSkip = [&skipped](std::string const & path, std::string const &) { skipped.push_back(path); };
+    TraversalStats stats;
+    SIMPLETEST("unsupported objects are skipped?", 
+        Index withtype = indexHdf5File(fname, &stats, H5DataHelpers::FileAccessProfile::DEFAULT, skipping),
+        withtype.size() == 9 and stats.skipped == 1 and skipped.size() == 1 and skipped[0] == "/type");
+    std::remove(fname.c_str());
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Directory crawling                          ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    // crawl_testdata/{a.h5, b.txt, sub/c.h5, sub/deeper/d.h5}:
+    const std::vector<std::string> dirs{"crawl_testdata", "crawl_testdata/sub", "crawl_testdata/sub/deeper"};
+    const std::vector<std::string> files{"crawl_testdata/a.h5", "crawl_testdata/b.txt", 
+                                         "crawl_testdata/sub/c.h5", "crawl_testdata/sub/deeper/d.h5"};
+    for( auto const & dir : dirs ) mkdir(dir.c_str(), 0755);
+    for( auto const & name : files ) std::fclose(std::fopen(name.c_str(), "w"));
+    auto found = FileHelpers::crawlDirectory("crawl_testdata/", "*.h5", 3);
+    SIMPLETEST("crawling finds all matching files?", , found.size() == 3 
+        and found[0].filename == "crawl_testdata/a.h5" and found[1].filename == "crawl_testdata/sub/c.h5"
+        and found[2].filename == "crawl_testdata/sub/deeper/d.h5" and found[2].size == 0);
+    std::vector<std::string> tostat(files);
+    tostat.push_back("crawl_testdata/missing.h5");
+    std::vector<std::size_t> order;
+    std::size_t nexisting = 0;
+    FileHelpers::statFiles(tostat, 3, [&](std::size_t i, FileHelpers::FileStat const & stat) {
+        order.push_back(i);
+        if( stat.exists and stat.filename == tostat[i] ) nexisting++; });
+    SIMPLETEST("files are stat'ed and passed on in order?", , order.size() == 5 
+        and std::is_sorted(order.begin(), order.end()) and nexisting == 4);
+    for( auto const & name : files ) std::remove(name.c_str());
+    for( auto it = dirs.rbegin(); it != dirs.rend(); ++it ) rmdir(it->c_str());
+    SHOULDTHROWTEST("crawling a missing directory throws?", FileHelpers::crawlDirectory("crawl_testdata", "*", 1));
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Statistics                                  ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    // every dataset is from the same ensemble, hpe is unique:
+    Index statidx;
+    for( int i = 0; i < 6; ++i )
+      statidx.push_back(DatasetSpec({Attribute("ensemble", "A653"), Attribute("hpe", i)}, 
+            "/d" + std::to_string(i), File(i < 4 ? "a.h5" : "b.h5", 0), DatasetChunkSpec(-1)));
+    sqlite3 *db;
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    sqlite_helpers::insertDataset(db, statidx);
+    auto stats = sqlite_helpers::getAttributeStats(db);
+    SIMPLETEST("statistics are kept while inserting?", , stats.size() == 2 
+        and stats[1].name == "hpe" and stats[1].nlocations == 6 and stats[1].ndistinct == 6
+        and stats[1].min == "0.0" and stats[1].max == "5.0" 
+        and stats[0].nlocations == 6 and stats[0].ndistinct == 1);
+    Request statreq = queryToRequest(R"({"attributes": {"ensemble": "A653", "hpe": {"min": 3}}})");
+    SIMPLETEST("range preselection finds all values?", , 
+        sqlite_helpers::getLocIdsMatchingPreSelection(db, statreq).size() == 3);
+    sqlite_helpers::orderBySelectivity(db, statreq);
+    SIMPLETEST("most selective condition comes first?", , statreq.attrrequests.size() == 2
+        and statreq.attrrequests[0].getName() == "hpe" and statreq.attrrequests[1].getName() == "ensemble" and sqlite_helpers::estimateMatches(db, statreq.attrrequests[0]) == 3);
+    auto facets = sqlite_helpers::getFacets(db);
+    SIMPLETEST("facets count the locations and files?", , facets.size() == 7
+        and facets[0].name == "ensemble" and facets[0].value == "A653" 
+        and facets[0].nlocations == 6 and facets[0].nfiles == 2
+        and facets[1].name == "hpe" and facets[1].nlocations == 1 and facets[1].nfiles == 1);
+    // another part of a.h5, with a value that is new to the file only:
+    sqlite_helpers::insertDataset(db, {DatasetSpec({Attribute("ensemble", "A653"), Attribute("hpe", 5)}, 
+          "/d6", File("a.h5", 0), DatasetChunkSpec(-1))});
+    facets = sqlite_helpers::getFacets(db, "hpe");
+    SIMPLETEST("facets are kept while inserting?", , facets.size() == 6 and facets[0].value == "5.0" 
+        and facets[0].nlocations == 2 and facets[0].nfiles == 2
+        and sqlite_helpers::getFacets(db, "ensemble").front().nfiles == 2);
+    auto restricted = sqlite_helpers::getFacets(db, "", 
+        queryToRequest(R"({"attributes": {"hpe": {"min": 4}}, "dataset": {"matches": "/d[45]"}})"));
+    SIMPLETEST("facets of the matching datasets?", , restricted.size() == 3
+        and restricted[0].name == "ensemble" and restricted[0].nlocations == 2 and restricted[0].nfiles == 1
+        and restricted[2].value == "5.0" and restricted[2].nlocations == 1
+        and sqlite_helpers::getFacets(db, "hpe", queryToRequest(R"({"attributes": {"hpe": {"min": 4}}})")).size() == 2);
+    sqlite_helpers::removeFile(db, "a.h5");
+    facets = sqlite_helpers::getFacets(db);
+    sqlite_helpers::rebuildStatistics(db);
+    auto rebuilt = sqlite_helpers::getFacets(db);
+    SIMPLETEST("facets are kept while removing?", , facets.size() == 3 and facets[0].nlocations == 2
+        and facets[0].nfiles == 1 and rebuilt.size() == facets.size() 
+        and std::equal(facets.begin(), facets.end(), rebuilt.begin(), 
+          [](sqlite_helpers::Facet const & a, sqlite_helpers::Facet const & b) {
+            return a.value == b.value and a.nlocations == b.nlocations and a.nfiles == b.nfiles; }));
+    stats = sqlite_helpers::getAttributeStats(db);
+    SIMPLETEST("statistics are kept while removing?", , stats.size() == 2 
+        and stats[1].nlocations == 2 and stats[1].min == "4.0" and stats[0].nlocations == 2
+        and sqlite_helpers::getValueFrequencies(db, "ensemble").front().second == 2);
+    sqlite3_close(db);
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Request expressions                         ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    // gamma cycles through 0, 1, 2, only the even hpe are smeared:
+    Index expridx;
+    for( int i = 0; i < 6; ++i ) {
+      std::vector<Attribute> attrs{Attribute("gamma", i % 3), Attribute("hpe", i)};
+      if( i % 2 == 0 ) attrs.push_back(Attribute("smearing", "wuppertal"));
+      expridx.push_back(DatasetSpec(attrs, "/d" + std::to_string(i), File("a.h5", 0), DatasetChunkSpec(-1)));
+    }
+    sqlite3 *db;
+    sqlite3_open(":memory:", &db);
+    sqlite_helpers::prepareSqliteFile(db);
+    sqlite_helpers::insertDataset(db, expridx);
+    auto select = [&](std::string const & query) {
+      Request req = queryToRequest(query);
+      const std::size_t npre = sqlite_helpers::getLocIdsMatchingPreSelection(db, req).size();
+      Index res = expridx;
+      filterIndexByPostselectionRules(res, req);
+      std::vector<std::string> names;
+      for( auto const & dset : res ) names.push_back(dset.datasetname);
+      return std::make_pair(npre, names);
+    };
+    Request parsed = queryToRequest(R"({"attributes": {"anyOf": [{"gamma": 0}, {"hpe": {"min": 4}, "smearing": "wuppertal"}], "not": {"gamma": 1}, "smearing": {"present": false}}})");
+    SIMPLETEST("combinators are parsed to expressions?", , parsed.attrrequests.empty()
+        and parsed.attrexpressions.size() == 3 
+        and parsed.attrexpressions[0].op == AttributeExpression::Operator::ANY_OF
+        and parsed.attrexpressions[0].requests.size() == 1 and parsed.attrexpressions[0].expressions.size() == 1
+        and parsed.attrexpressions[1].op == AttributeExpression::Operator::NOT
+        and parsed.attrexpressions[2].op == AttributeExpression::Operator::NOT
+        and parsed.attrexpressions[2].requests.front().getName() == "smearing");
+    auto sel = select(R"({"attributes": {"anyOf": [{"gamma": 0}, {"hpe": {"min": 4}}]}})");
+    SIMPLETEST("anyOf is a union?", , sel.first == 4 
+        and sel.second == std::vector<std::string>({"/d0", "/d3", "/d4", "/d5"}));
+    sel = select(R"({"attributes": {"smearing": {"present": false}}})");
+    SIMPLETEST("absent attributes are selected in the database?", , sel.first == 3 
+        and sel.second == std::vector<std::string>({"/d1", "/d3", "/d5"}));
+    sel = select(R"({"attributes": {"hpe": {"max": 3}, "not": {"anyOf": [{"gamma": 1}, {"smearing": "wuppertal"}]}}})");
+    SIMPLETEST("negated unions are differences?", , sel.first == 1 and sel.second == std::vector<std::string>({"/d3"}));
+    sel = select(R"({"attributes": {"not": {"smearing": {"matches": "wup.*"}}}})");
+    SIMPLETEST("inexact negations are left to the postselection?", , sel.first == 6
+        and sel.second == std::vector<std::string>({"/d1", "/d3", "/d5"}));
+    sel = select(R"({"attributes": {"hpe": {"largest": true}}})");
+    SIMPLETEST("largest value is selected in the database?", , sel.first == 1 
+        and sel.second == std::vector<std::string>({"/d5"}));
+    sel = select(R"({"attributes": {"gamma": 1, "hpe": {"smallest": true}}})");
+    SIMPLETEST("smallest value among the other conditions?", , sel.first == 1 
+        and sel.second == std::vector<std::string>({"/d1"}));
+    sel = select(R"({"attributes": {"gamma": {"smallest": true}}})");
+    SIMPLETEST("all datasets with the smallest value are kept?", , sel.first == 2 
+        and sel.second == std::vector<std::string>({"/d0", "/d3"}));
+    sel = select(R"({"attributes": {"smearing": {"matches": "wup.*"}, "hpe": {"largest": true}}})");
+    SIMPLETEST("inexact conditions leave the extrema to the postselection?", , sel.first == 3 
+        and sel.second == std::vector<std::string>({"/d4"}));
+    SHOULDTHROWTEST("extrema within combinators throw?", 
+        queryToRequest(R"({"attributes": {"not": {"hpe": {"largest": true}}}})"));
+    auto names = [](Index const & idx) {
+      std::vector<std::string> res;
+      for( auto const & dset : idx ) res.push_back(dset.datasetname);
+      return res;
+    };
+    // the expression is only evaluated by the postselection, the largest hpe
+    // is taken among the datasets with gamma 1:
+    const std::string extremal(R"({"attributes": {"hpe": {"largest": true}}, "expression": "gamma == 1"})");
+    sel = select(extremal);
+    SIMPLETEST("expressions leave the extrema to the postselection?", , sel.first == 6 
+        and sel.second == std::vector<std::string>({"/d4"})
+        and names(sqlite_helpers::getMatchingDatasets(db, queryToRequest(extremal))) == std::vector<std::string>({"/d4"})
+        and sqlite_helpers::countMatchingDatasets(db, queryToRequest(extremal)) == 1);
+    Request limited = queryToRequest(R"({"attributes": {"gamma": {"min": 1}, "hpe": {"max": 4}}, "limit": 2})");
+    SIMPLETEST("limits are passed to the database?", , limited.limit == 2 
+        and sqlite_helpers::getPreSelectionQuery(limited).find(" limit 2;") != std::string::npos
+        and sqlite_helpers::getLocIdsMatchingPreSelection(db, limited).size() == 2
+        and names(sqlite_helpers::getMatchingDatasets(db, limited)) == std::vector<std::string>({"/d1", "/d2"}));
+    limited.limit = 100;
+    auto streamed = sqlite_helpers::getLocIdsMatchingPreSelection(db, limited);
+    limited.limit = 0;
+    SIMPLETEST("streaming preselection finds the same locations?", , 
+        sqlite_helpers::getPreSelectionQuery(limited, true).find("exists") != std::string::npos
+        and streamed == sqlite_helpers::getLocIdsMatchingPreSelection(db, limited) 
+        and streamed == std::vector<int>({2, 3, 5}));
+    limited = queryToRequest(R"({"attributes": {"smearing": {"matches": "wup.*"}, "gamma": {"min": 1}}, "limit": 1})");
+    SIMPLETEST("limits with postselection stop after enough matches?", , 
+        sqlite_helpers::getPreSelectionQuery(limited).find("limit") == std::string::npos
+        and names(sqlite_helpers::getMatchingDatasets(db, limited)) == std::vector<std::string>({"/d2"}));
+    auto count = [&db](std::string const & query) {
+      return sqlite_helpers::countMatchingDatasets(db, queryToRequest(query)); };
+    SIMPLETEST("counts in the database and with postselection?", , 
+        count(R"({"attributes": {"gamma": {"min": 1}, "hpe": {"max": 4}}})") == 3
+        and count(R"({"attributes": {"gamma": {"min": 1}, "hpe": {"max": 4}}, "limit": 2})") == 2
+        and count(R"({"attributes": {"not": {"smearing": {"matches": "wup.*"}}}})") == 3
+        and count(R"({"attributes": {"smearing": {"matches": "wup.*"}, "hpe": {"largest": true}}})") == 1
+        and count(R"({"attributes": {"gamma": 7}})") == 0);
+    auto exists = [&db](std::string const & query) {
+      return sqlite_helpers::existsMatchingDataset(db, queryToRequest(query)); };
+    SIMPLETEST("existence of matching datasets?", , 
+        exists(R"({"attributes": {"hpe": {"largest": true}}})")
+        and exists(R"({"attributes": {"smearing": {"matches": "wup.*"}}, "dataset": {"matches": "/d4"}})")
+        and not exists(R"({"attributes": {"smearing": {"matches": "loc.*"}}, "dataset": {"matches": "/d4"}})")
+        and not exists(R"({"attributes": {"gamma": 7}})"));
+    sqlite3_close(db);
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Output formats                              ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    std::map<std::string, Value> mom{{"0", 1}, {"1", "two \"quoted\""}, {"2", true}};
+    // sorted by name, as dsetSpecFromString returns them:
+    Index outidx{DatasetSpec({Attribute("flag", false), Attribute("kappa", 0.1), 
+          Attribute("label", "tab\tand\\ newline\n"), Attribute("mom", Value(mom)), Attribute("third", 1./3)},
+          "/a/b", File("a \"b\".h5", 1480004355), DatasetChunkSpec(3)),
+        DatasetSpec({}, "/empty", File("c.h5", 0), DatasetChunkSpec(-1))};
+    std::stringstream jsonl;
+    auto writer = makeIndexWriter("jsonl", jsonl);
+    writer->write(outidx);
+    writer->flush();
+    std::string line;
+    Index readback;
+    while( std::getline(jsonl, line) ) readback.push_back(dsetSpecFromString(line));
+    SIMPLETEST("json lines are read back exactly?", , readback.size() == 2 
+        and readback[0] == outidx[0] and readback[1] == outidx[1]);
+    std::stringstream binary;
+    BinaryIndexWriter binwriter(binary, 16);
+    binwriter.write(outidx);
+    binwriter.write(outidx.back());
+    binwriter.flush();
+    readback = readBinaryIndex(binary);
+    SIMPLETEST("binary records are read back exactly?", , readback.size() == 3 
+        and readback[0] == outidx[0] and readback[1] == outidx[1] and readback[2] == outidx[1]);
+    std::stringstream truncated(binary.str().substr(0, binary.str().size() - 3));
+    SHOULDTHROWTEST("truncated binary records throw?", readBinaryIndex(truncated));
+    std::stringstream text;
+    printIndex({outidx[1]}, text);
+    SIMPLETEST("text is written as before?", , 
+        text.str() == "dataset \"/empty\" (from file \"c.h5\" and row -1) has the following attributes:\n");
+    SHOULDTHROWTEST("unknown formats throw?", makeIndexWriter("xml", text));
+  }
+
+  std::cout << "=================================================" << std::endl;
+  std::cout << "|| Expressions                                 ||"<< std::endl;
+  std::cout << "=================================================" << std::endl;
+  {
+    DatasetSpec exprdset({Attribute("x", 3), Attribute("y", 3), Attribute("z", 3), Attribute("kind", "table"),
+        Attribute("flag", true), Attribute("mom", arrayFromElements({1, 0, -1}))}, "/d", File("a.h5", 0), 
+        DatasetChunkSpec(-1));
+    SIMPLETEST("arithmetic and comparisons?", , 
+        matchesExpression(exprdset, Expression("attributes.x^2 + y^2 + z^2 == 27 and x/2 < 2 and x % 2 ~= 0")));
+    SIMPLETEST("precedence of the operators?", , 
+        matchesExpression(exprdset, Expression("-2^2 == -4 and 2^3^2 == 512 and 1 + 2 * 3 == 7 and not 1 > 2")));
+    SIMPLETEST("strings, booleans and array elements?", , 
+        matchesExpression(exprdset, Expression("kind == 'table' and flag and mom[0] - mom[2] == 2 and kind != 1")));
+    SIMPLETEST("functions?", , 
+        matchesExpression(exprdset, Expression("min(x, 7, -y) == -3 and sqrt(abs(-16)) == 4 and floor(2.5) == 2")));
+    SIMPLETEST("missing attributes do not match?", , 
+        not matchesExpression(exprdset, Expression("w > 1 or x == 3"))
+        and matchesExpression(exprdset, Expression("not has(w) or w > 1"))
+        and not matchesExpression(exprdset, Expression("mom[5] == 0")));
+    SHOULDTHROWTEST("syntax errors throw?", Expression("x + * 2"));
+    SHOULDTHROWTEST("unknown functions throw?", Expression("cos(x) == 1"));
+    SHOULDTHROWTEST("type errors throw?", matchesExpression(exprdset, Expression("kind + 1 == 2")));
+    SHOULDTHROWTEST("non-boolean results throw?", matchesExpression(exprdset, Expression("x + 1")));
+    // the nodes of the README:
+    Index nodes;
+    for( auto const & xyt : std::vector<std::vector<int>>{{2, 2, 2}, {3, 3, 2}, {3, 3, 5}} )
+      nodes.push_back(DatasetSpec({Attribute("x", xyt[0]), Attribute("y", xyt[1]), Attribute("z", 3),
+            Attribute("t", xyt[2])}, "/d", File("targetnode" + std::to_string(nodes.size() + 1), 0), DatasetChunkSpec(-1)));
+    filterIndexByPostselectionRules(nodes, queryToRequest(R"({"attributes": {"t": 2}, 
+        "file": {"matches": "targetnode[0-9]*"}, "expression": "x^2 + y^2 + z^2 == 27"})"));
+    SIMPLETEST("expressions in requests?", , nodes.size() == 1 and nodes[0].file.filename == "targetnode2");
+  }
+
   std::cout << "=================================================" << std::endl;
   std::cout << "|| Read table                                  ||"<< std::endl;
   std::cout << "=================================================" << std::endl;
   {
-    Index tblidx;
-    try {
-       tblidx = indexHdf5File(testdatadir + "/table_testdata.h5");
-    } catch (std::exception const & exc) {
-      std::cout << "could not index test file \"" << testdatadir + "/table_testdata.h5" << "\": " << exc.what();
-      return -1;
+    /* the group "solve" (smear = 1) holds a table of six rows and the two
+     * datasets it describes, the root one plain dataset:
+     */
+    const std::string fname("table_generated_testdata.h5");
+    struct Row { int hpe; double interpolator; double mom[3]; char tag[8]; std::int8_t flag; };
+    std::vector<Row> rows(6);
+    for( int i = 0; i < 6; ++i ) {
+      rows[i] = Row{ i % 3 + 1, i < 3 ? 7. : 8., {}, {}, (std::int8_t)(i % 2) };
+      for( auto & m : rows[i].mom ) m = i % 2;
+      std::snprintf(rows[i].tag, sizeof(rows[i].tag), "row%d", i);
+    }
+    hsize_t width = 3;
+    hid_t momtype = H5Tarray_create2(H5T_NATIVE_DOUBLE, 1, &width);
+    hid_t tagtype = H5Tcopy(H5T_C_S1);
+    H5Tset_size(tagtype, sizeof(Row::tag));
+    hid_t booltype = H5Tenum_create(H5T_NATIVE_INT8);
+    std::int8_t f = 0, t = 1;
+    H5Tenum_insert(booltype, "FALSE", &f);
+    H5Tenum_insert(booltype, "TRUE", &t);
+    hid_t rowtype = H5Tcreate(H5T_COMPOUND, sizeof(Row));
+    H5Tinsert(rowtype, "hpe", HOFFSET(Row, hpe), H5T_NATIVE_INT);
+    H5Tinsert(rowtype, "interpolator", HOFFSET(Row, interpolator), H5T_NATIVE_DOUBLE);
+    H5Tinsert(rowtype, "mom", HOFFSET(Row, mom), momtype);
+    H5Tinsert(rowtype, "tag", HOFFSET(Row, tag), tagtype);
+    H5Tinsert(rowtype, "flag", HOFFSET(Row, flag), booltype);
+
+    hid_t file = H5Fcreate(fname.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    hid_t scalar = H5Screate(H5S_SCALAR);
+    hsize_t nrows = rows.size();
+    hid_t rowspace = H5Screate_simple(1, &nrows, NULL);
+    hid_t group = H5Gcreate2(file, "solve", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    hid_t attr_id = H5Acreate2(group, "smear", H5T_NATIVE_INT, scalar, H5P_DEFAULT, H5P_DEFAULT);
+    int smear = 1;
+    H5Awrite(attr_id, H5T_NATIVE_INT, &smear);
+    H5Aclose(attr_id);
+    hid_t dset = H5Dcreate2(group, "table", rowtype, rowspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, rowtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows.data());
+    hid_t classtype = H5Tcopy(H5T_C_S1);
+    H5Tset_size(classtype, 5);
+    attr_id = H5Acreate2(dset, "CLASS", classtype, scalar, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr_id, classtype, "TABLE");
+    H5Aclose(attr_id);
+    H5Tclose(classtype);
+    H5Dclose(dset);
+    double data[6] = {0., 1., 2., 3., 4., 5.};
+    for( auto name : {"data", "other"} ) {
+      dset = H5Dcreate2(group, name, H5T_NATIVE_DOUBLE, rowspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+      H5Dclose(dset);
     }
+    H5Gclose(group);
+    dset = H5Dcreate2(file, "plain", H5T_NATIVE_DOUBLE, rowspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    H5Dclose(dset);
+    H5Sclose(rowspace);
+    H5Sclose(scalar);
+    H5Fclose(file);
+    for( auto type : {rowtype, booltype, tagtype, momtype} ) H5Tclose(type);
+
+    TraversalStats counted;
+    Index tblidx = indexHdf5File(fname, &counted);
+    // 2*6: both datasets in "solve" for each row of the table:
+    /* 30 metadata operations: the info of the 5 objects, opening, iterating and
+     * closing the 2 objects with attributes, opening, reading the type and the
+     * space, reading and closing their attribute, and opening the table,
+     * reading its type and space, each of the 5 columns and closing it.
+     */
+    SIMPLETEST("Size of index is correct (the dset with table was split)?", , tblidx.size() == 1 + 2*6
+        and counted.tables == 1 and counted.datasets == 3 and counted.metadataOperations == 30);
+    auto fourth = std::find_if(tblidx.begin(), tblidx.end(), [](DatasetSpec const & d) {
+        return d.datasetname == "/solve/data" and d.location.row == 3; });
+    // the attributes of the group, then the columns of the table:
+    std::map<std::string, Value> ones{{"0", 1}, {"1", 1}, {"2", 1}};
+    std::vector<Attribute> expected{ Attribute("smear", 1), Attribute("hpe", 1), 
+      Attribute("interpolator", 8), Attribute("mom", Value(ones)), 
+      Attribute("tag", Value(std::string("row3"))), Attribute("flag", Value(true)) };
+    SIMPLETEST("Table row was correctly read?", , fourth != tblidx.end() 
+        and fourth->attributes.size() == expected.size()
+        and std::equal(expected.begin(), expected.end(), fourth->attributes.begin(),
+          [](Attribute a, Attribute b) { return a == b; }));
+    Request request;
+    filterIndexByPostselectionRules(tblidx, request);
+    SIMPLETEST("Empty request leaves index size unchanged?", , tblidx.size() == 1 + 2*6);
+    request.dsetrequests.push_back(
+        std::unique_ptr<Hdf5DatasetConditions::NameMatches>(
+          new Hdf5DatasetConditions::NameMatches(".*/solve/data")));
+    filterIndexByPostselectionRules(tblidx, request);
+    SIMPLETEST("filter only table data?", , tblidx.size() == 6);
+    request.attrrequests.push_back(AttributeRequest("interpolator", AttributeConditions::Equals(7)));
+    filterIndexByPostselectionRules(tblidx, request);
+    SIMPLETEST("request returns all interp=7 values?", , tblidx.size() == 3);
+    request.attrrequests.push_back(AttributeRequest("hpe", AttributeConditions::Equals(2)));
+    filterIndexByPostselectionRules(tblidx, request);
+    SIMPLETEST("request returns all interp=7 AND hpe=2 values?", , tblidx.size() == 1);
+    std::map<std::string, Value> map;
+    map.insert({"0", 0}); map.insert({"1", 0}); map.insert({"2", 0});
+    request.attrrequests.push_back(AttributeRequest("mom", AttributeConditions::Equals(map)));
+    filterIndexByPostselectionRules(tblidx, request);
+    SIMPLETEST("request returns no interp=7 AND hpe=2 values at mom=0,0,0?", , tblidx.empty());
+
+    // a table with a nested compound field, which is not supported:
+    file = H5Fopen(fname.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    hid_t innertype = H5Tcreate(H5T_COMPOUND, sizeof(int));
+    H5Tinsert(innertype, "a", 0, H5T_NATIVE_INT);
+    hid_t nestedtype = H5Tcreate(H5T_COMPOUND, sizeof(int));
+    H5Tinsert(nestedtype, "nested", 0, innertype);
+    scalar = H5Screate(H5S_SCALAR);
+    group = H5Gcreate2(file, "broken", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    dset = H5Dcreate2(group, "table", nestedtype, scalar, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    int zero = 0;
+    H5Dwrite(dset, nestedtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, &zero);
+    classtype = H5Tcopy(H5T_C_S1);
+    H5Tset_size(classtype, 5);
+    attr_id = H5Acreate2(dset, "CLASS", classtype, scalar, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr_id, classtype, "TABLE");
+    H5Aclose(attr_id);
+    H5Tclose(classtype);
+    H5Dclose(dset);
+    dset = H5Dcreate2(group, "data", H5T_NATIVE_DOUBLE, scalar, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    H5Dclose(dset);
+    H5Gclose(group);
+    H5Sclose(scalar);
+    H5Tclose(nestedtype);
+    H5Tclose(innertype);
+    H5Fclose(file);
+    SHOULDTHROWTEST("unsupported tables fail the traversal?", indexHdf5File(fname));
+    TraversalOptions skipping;
+    skipping.skipUnsupported = true;
+    std::string reason;
+    skipping.onSkip = [&reason](std::string const & path, std::string const & why) { reason = path + ": " + why; };
+    tblidx = indexHdf5File(fname, &counted, H5DataHelpers::FileAccessProfile::DEFAULT, skipping);
+    SIMPLETEST("unsupported tables are skipped?", , counted.skipped == 1 and tblidx.size() == 1 + 2*6 + 1
+        and reason == "/broken/table: table field \"nested\": type not implemented.");
+    std::remove(fname.c_str());
+  }
+  // the tables of a real measurement, if the test data is given:
+  if( FileHelpers::file_exists(testdatadir + "/table_testdata.h5") ) {
+    Index tblidx = indexHdf5File(testdatadir + "/table_testdata.h5");
     /* 2*8*27: dsets in stochsolve1: 2 smearings, 8 different hpes, 27 momenta.
      * */
-    SIMPLETEST("Size of index is correct (the dset with table was split)?", , tblidx.size() == 2025+2*8*27);
+    SIMPLETEST("Size of index of the test data is correct?", , tblidx.size() == 2025+2*8*27);
     SIMPLETEST("Dataset was correctly recognized?", , tblidx.front().datasetname == "/rqcd/stoch_discon/stochsolve0/solve_0/data");
     Request request;
-    filterIndexByPostselectionRules(tblidx, request);
-    SIMPLETEST("Empty request leaves index size unchanged?", , tblidx.size() == 2025+2*8*27);
     request.dsetrequests.push_back(
         std::unique_ptr<Hdf5DatasetConditions::NameMatches>(
           new Hdf5DatasetConditions::NameMatches(".*/stochsolve0/.*")));
-    std::cout << "size: " << tblidx.size() << std::endl;
     filterIndexByPostselectionRules(tblidx, request);
-    SIMPLETEST("filter only table data?", , tblidx.size() == 2025);
+    SIMPLETEST("filter only table data of the test data?", , tblidx.size() == 2025);
     request.attrrequests.push_back(AttributeRequest("interpolator", AttributeConditions::Equals(7)));
-    filterIndexByPostselectionRules(tblidx, request);
-    SIMPLETEST("request returns all interp=7 values?", , tblidx.size() == 54);
     request.attrrequests.push_back(AttributeRequest("hpe", AttributeConditions::Equals(4)));
-    filterIndexByPostselectionRules(tblidx, request);
-    SIMPLETEST("request returns all interp=7 AND hpe=4 values?", , tblidx.size() == 27);
     std::map<std::string, Value> map;
     map.insert({"0", 1}); map.insert({"1", 1}); map.insert({"2", 1});
     request.attrrequests.push_back(AttributeRequest("mom", AttributeConditions::Equals(map)));
     filterIndexByPostselectionRules(tblidx, request);
-    SIMPLETEST("request returns all interp=7 AND hpe=4 values at mom=1,1,1?", , tblidx.size() == 1);
+    SIMPLETEST("test data has one interp=7 AND hpe=4 value at mom=1,1,1?", , tblidx.size() == 1);
+  } else {
+    std::cout << "no table_testdata.h5 in \"" << testdatadir << "\", its tests are skipped." << std::endl;
   }
   return 0;
 }
@@ -3,6 +3,7 @@
  * Licensed under MIT License. See LICENSE in the root directory.
  */
 #include <sstream>
+#include <algorithm>
 #include "parseJson.h"
 namespace rqcd_file_index {
 std::string typeToString(Type const & type) {
@@ -29,6 +30,19 @@ Type typeFromString(std::string const & typestr) {
   else if( typestr == "array" )             return Type::ARRAY;
   else throw std::runtime_error("typeFromString: unknown type.");
 }
+Value arrayFromElements(std::vector<Value> elems) {
+  // the map is built from the keys in their (lexicographic) order, such that
+  // every insertion is at the end:
+  std::vector<std::pair<std::string, std::size_t>> keys;
+  keys.reserve(elems.size());
+  for( std::size_t i = 0; i < elems.size(); ++i )
+    keys.push_back({std::to_string(i), i});
+  std::sort(keys.begin(), keys.end());
+  std::map<std::string, Value> map;
+  for( auto & key : keys )
+    map.emplace_hint(map.end(), std::move(key.first), std::move(elems[key.second]));
+  return Value(std::move(map));
+}
 bool isArrayString(std::string const & str) {
   return ( str[0] == '{' and str.back() == '}' );
 }
@@ -8,6 +8,8 @@
 #include <stdexcept>
 #include <map>
 #include <vector>
+#include <ostream>
+#include <istream>
 
 namespace rqcd_file_index {
 enum class Type {
@@ -23,6 +25,9 @@ std::string typeToString(Type const & type);
 Type typeFromTypeid(std::type_info const & tinfo);
 Value valueFromString(std::string const & str);
 Type typeFromString(std::string const & typestr);
+// array with the keys "0", "1", ... for the elements, which are moved into it.
+// arrays are maps (also of dense elements), see ArrayModel:
+Value arrayFromElements(std::vector<Value> elems);
 
 class Value {
 public:
@@ -34,7 +39,10 @@ public:
   Value(std::string val) : content(new StringModel(val)), type(Type::STRING) {}
   Value(char const * val) : content(new StringModel(std::string(val))), type(Type::STRING) {}
   Value(std::map<std::string, Value> const & val) : content(new ArrayModel(val)), type(Type::ARRAY) {}
+  Value(std::map<std::string, Value> && val) : content(new ArrayModel(std::move(val))), type(Type::ARRAY) {}
   Value(Value const &rr) : content(rr.content->clone()), type(rr.getType()) {}
+  // the moved-from value must only be assigned to or destroyed:
+  Value(Value &&rr) noexcept : content(rr.content), type(rr.type) { rr.content = nullptr; }
   Value &operator=(Value rr) {
     if( rr.getType() != getType() )
       throw std::runtime_error("Type-changing assignment.");
@@ -66,42 +74,42 @@ public:
   double getNumeric() const { 
     if( getType() != Type::NUMERIC ) 
       throw std::runtime_error("Value must be NUMERIC to get a numeric value.");
-    return dynamic_cast<NumericModel const *>(content)->object;
+    return static_cast<NumericModel const *>(content)->object;
   }
   bool getBool() const { 
     if( getType() != Type::BOOLEAN) 
       throw std::runtime_error("Value must be BOOLEAN to get a bool value.");
-    return dynamic_cast<BooleanModel const *>(content)->object;
+    return static_cast<BooleanModel const *>(content)->object;
   }
-  std::map<std::string, Value> getMap() const {
+  std::map<std::string, Value> const & getMap() const {
     if( getType() != Type::ARRAY)
       throw std::runtime_error("Value must be ARRAY to get a value from it.");
-    return dynamic_cast<ArrayModel const *>(content)->object;
+    return static_cast<ArrayModel const *>(content)->object;
   }
-  std::string getString() const { 
+  std::string const & getString() const { 
     if( getType() != Type::STRING) 
       throw std::runtime_error("Value must be STRING to get a string value.");
-    return dynamic_cast<StringModel const *>(content)->object;
+    return static_cast<StringModel const *>(content)->object;
   }
   double & getNumeric() { 
     if( getType() != Type::NUMERIC ) 
       throw std::runtime_error("Value must be NUMERIC to get a numeric value.");
-    return dynamic_cast<NumericModel *>(content)->object;
+    return static_cast<NumericModel *>(content)->object;
   }
   bool & getBool() { 
     if( getType() != Type::BOOLEAN) 
       throw std::runtime_error("Value must be BOOLEAN to get a bool value.");
-    return dynamic_cast<BooleanModel *>(content)->object;
+    return static_cast<BooleanModel *>(content)->object;
   }
   std::string & getString() { 
     if( getType() != Type::STRING) 
       throw std::runtime_error("Value must be STRING to get a string value.");
-    return dynamic_cast<StringModel *>(content)->object;
+    return static_cast<StringModel *>(content)->object;
   }
   std::map<std::string, Value> & getMap() {
     if( getType() != Type::ARRAY)
       throw std::runtime_error("Value must be ARRAY to get a value from it.");
-    return dynamic_cast<ArrayModel *>(content)->object;
+    return static_cast<ArrayModel *>(content)->object;
   }
   friend std::ostream& operator<<(std::ostream& os, Value const & val) {
     val.content->print(os);
@@ -114,7 +122,6 @@ public:
   }*/
   friend bool operator==(Value const & a, Value const & b) {
     if( a.getType() != b.getType() ) return false;
-    bool equal = true;
     switch( a.getType() ) {
       case Type::NUMERIC:
         return a.getNumeric() == b.getNumeric();
@@ -122,16 +129,15 @@ public:
         return a.getString() == b.getString();
       case Type::BOOLEAN:
         return a.getBool() == b.getBool();
-      case Type::ARRAY:
-        //compare keys:
-        for( auto const & key : a.keys() )
-          equal &= (b.getMap().count(key) == 1);
-        if( not equal ) return false;
-        // has all keys.
-        for( auto const & key : a.keys() )
-          equal &= (a[key] == b[key]);
-        // all keys are equal?
-        return equal;
+      case Type::ARRAY: {
+        // b has all keys of a, with equal values:
+        auto const & bmap = b.getMap();
+        for( auto const & elem : a.getMap() ) {
+          auto it = bmap.find(elem.first);
+          if( it == bmap.end() or not (elem.second == it->second) ) return false;
+        }
+        return true;
+      }
       default:
         throw std::runtime_error("unsupported type for operator==");
     }
@@ -242,7 +248,7 @@ public:
       throw std::runtime_error("key not found.");
     return map.at(key);
   }
-  Value operator[](std::string const & key) const {
+  Value const & operator[](std::string const & key) const {
     if( getType() != Type::ARRAY )
       throw std::runtime_error("type must be ARRAY to use operator[].");
     auto const & map = dynamic_cast<ArrayModel *>(content)->object;
@@ -322,13 +328,24 @@ private:
       auto it = object.cbegin();
       auto end = object.cend();
       --end;
-      for( ; it != end; ++it )
-        os << "\"" << it->first << "\": " << it->second << ",";
-      if( not object.empty() ) 
-        os << "\"" << it->first << "\": " << it->second;
+      for( ; it != end; ++it ) {
+        os << "\"" << it->first << "\": ";
+        printElement(os, it->second);
+        os << ",";
+      }
+      if( not object.empty() ) {
+        os << "\"" << it->first << "\": ";
+        printElement(os, it->second);
+      }
       os << "}";
     }
+    // strings inside arrays are quoted, such that the array is valid json:
+    static void printElement(std::ostream& os, Value const & val) {
+      if( val.getType() == Type::STRING ) os << "\"" << val.getString() << "\"";
+      else os << val;
+    }
     ArrayModel(std::map<std::string, Value> const & val) : Concept(), object(val) {}
+    ArrayModel(std::map<std::string, Value> && val) : Concept(), object(std::move(val)) {}
     std::map<std::string, Value> object;
   };
   Concept *content;